@@ -0,0 +1,178 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// The span algorithms of enum_flags_algorithms.h over 8M `enum_flags` values, versus the loops over the member
+/// operators they replace, single- and multi-threaded. `partition` copies the input before every pass on both sides,
+/// since partitioning in place would leave nothing to do for the next iteration.
+
+#include "../include/enum_flags_algorithms.h"
+#include "instruction_counter.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+constexpr size_t element_count = size_t(1) << 23;
+
+template <typename VALUE_TYPE>
+using flags = enum_flags<int, VALUE_TYPE>;
+
+template <typename VALUE_TYPE>
+static std::vector<flags<VALUE_TYPE>> const& values()
+{
+  static const auto result = [] {
+    std::vector<flags<VALUE_TYPE>> v(element_count);
+    std::mt19937_64 rng{ 42 };
+    for (auto& f : v) f = flags<VALUE_TYPE>::from_bits(static_cast<VALUE_TYPE>(rng() & rng()));
+    return v;
+  }();
+  return result;
+}
+
+template <typename VALUE_TYPE>
+constexpr auto mask = flags<VALUE_TYPE>::from_bits(VALUE_TYPE(0b1001));
+
+static unsigned thread_count() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+template <typename VALUE_TYPE, typename FUNC>
+static void run(benchmark::State& state, FUNC&& func)
+{
+  auto v = values<VALUE_TYPE>();
+  per_op_counters counters{ state, int64_t(v.size()) };
+  for (auto _ : state)
+  {
+    auto result = func(std::span<flags<VALUE_TYPE>>{ v });
+    benchmark::DoNotOptimize(result);
+    benchmark::ClobberMemory();
+  }
+  counters.finish();
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(v.size() * sizeof(VALUE_TYPE)));
+}
+
+template <typename VALUE_TYPE>
+static void reduce_or_loop(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { flags<VALUE_TYPE> result; for (auto f : span) result += f; return result; });
+}
+
+template <typename VALUE_TYPE>
+static void reduce_or_kernel(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { return reduce_or(std::span<flags<VALUE_TYPE> const>{ span }); });
+}
+
+template <typename VALUE_TYPE>
+static void reduce_or_threads(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { return reduce_or(std::span<flags<VALUE_TYPE> const>{ span }, thread_count()); });
+}
+
+/// A lambda, like a `flag_predicate`: a function pointer would be an indirect call per element in the out-of-line kernels
+template <typename VALUE_TYPE>
+constexpr auto has_mask = [](flags<VALUE_TYPE> f) { return (f.bits & mask<VALUE_TYPE>.bits) == mask<VALUE_TYPE>.bits; };
+
+template <typename VALUE_TYPE>
+static void count_if_loop(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { return std::count_if(span.begin(), span.end(), has_mask<VALUE_TYPE>); });
+}
+
+template <typename VALUE_TYPE>
+static void count_if_kernel(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { return count_if(std::span<flags<VALUE_TYPE> const>{ span }, has_mask<VALUE_TYPE>); });
+}
+
+template <typename VALUE_TYPE>
+static void count_if_threads(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { return count_if(std::span<flags<VALUE_TYPE> const>{ span }, has_mask<VALUE_TYPE>, thread_count()); });
+}
+
+/// Toggling instead of setting, so that every pass changes the data
+template <typename VALUE_TYPE>
+static void toggle_loop(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { for (auto& f : span) f.toggle(mask<VALUE_TYPE>); return span.data(); });
+}
+
+template <typename VALUE_TYPE>
+static void toggle_kernel(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { apply_toggle(span, mask<VALUE_TYPE>); return span.data(); });
+}
+
+template <typename VALUE_TYPE>
+static void toggle_threads(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { apply_toggle(span, mask<VALUE_TYPE>, thread_count()); return span.data(); });
+}
+
+template <typename VALUE_TYPE>
+static void partition_std(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) {
+    std::ranges::copy(values<VALUE_TYPE>(), span.begin());
+    return std::partition(span.begin(), span.end(), has_mask<VALUE_TYPE>) - span.begin();
+  });
+}
+
+template <typename VALUE_TYPE>
+static void partition_kernel(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) {
+    std::ranges::copy(values<VALUE_TYPE>(), span.begin());
+    return partition_by(span, mask<VALUE_TYPE>);
+  });
+}
+
+template <typename VALUE_TYPE>
+static void partition_threads(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) {
+    std::ranges::copy(values<VALUE_TYPE>(), span.begin());
+    return partition_by(span, mask<VALUE_TYPE>, thread_count());
+  });
+}
+
+template <typename T> constexpr const char* type_name = "";
+template <> constexpr const char* type_name<uint8_t> = "uint8_t";
+template <> constexpr const char* type_name<uint32_t> = "uint32_t";
+template <> constexpr const char* type_name<uint64_t> = "uint64_t";
+
+template <typename T>
+static void register_for_type()
+{
+  const auto suffix = std::string{ "/" } + type_name<T>;
+  benchmark::RegisterBenchmark(("reduce_or/loop" + suffix).c_str(), reduce_or_loop<T>);
+  benchmark::RegisterBenchmark(("reduce_or/kernel" + suffix).c_str(), reduce_or_kernel<T>);
+  benchmark::RegisterBenchmark(("reduce_or/threads" + suffix).c_str(), reduce_or_threads<T>)->UseRealTime();
+  benchmark::RegisterBenchmark(("count_if/loop" + suffix).c_str(), count_if_loop<T>);
+  benchmark::RegisterBenchmark(("count_if/kernel" + suffix).c_str(), count_if_kernel<T>);
+  benchmark::RegisterBenchmark(("count_if/threads" + suffix).c_str(), count_if_threads<T>)->UseRealTime();
+  benchmark::RegisterBenchmark(("toggle/loop" + suffix).c_str(), toggle_loop<T>);
+  benchmark::RegisterBenchmark(("toggle/kernel" + suffix).c_str(), toggle_kernel<T>);
+  benchmark::RegisterBenchmark(("toggle/threads" + suffix).c_str(), toggle_threads<T>)->UseRealTime();
+  benchmark::RegisterBenchmark(("partition/std" + suffix).c_str(), partition_std<T>);
+  benchmark::RegisterBenchmark(("partition/kernel" + suffix).c_str(), partition_kernel<T>);
+  benchmark::RegisterBenchmark(("partition/threads" + suffix).c_str(), partition_threads<T>)->UseRealTime();
+}
+
+int main(int argc, char** argv)
+{
+  register_for_type<uint8_t>();
+  register_for_type<uint32_t>();
+  register_for_type<uint64_t>();
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
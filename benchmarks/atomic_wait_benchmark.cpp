@@ -0,0 +1,86 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Ping-pong latency between two threads: one round trip per iteration.
+/// Compares atomic_enum_flags event-group waits with a mutex + condition_variable + enum_flags.
+
+#include "../include/atomic_enum_flags.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+enum class PingPong
+{
+  Ping,
+  Pong,
+  Quit,
+};
+
+static void atomic_wait_ping_pong(benchmark::State& state)
+{
+  atomic_enum_flags<PingPong, uint32_t> flags;
+
+  std::thread ponger([&] {
+    for (;;)
+    {
+      const auto got = flags.wait_any({ PingPong::Ping, PingPong::Quit }, true, std::memory_order_acq_rel);
+      if (got.is_set(PingPong::Quit))
+        return;
+      flags.set_and_notify(PingPong::Pong, std::memory_order_release);
+    }
+  });
+
+  for (auto _ : state)
+  {
+    flags.set_and_notify(PingPong::Ping, std::memory_order_release);
+    flags.wait_any(PingPong::Pong, true, std::memory_order_acq_rel);
+  }
+
+  flags.set_and_notify(PingPong::Quit);
+  ponger.join();
+}
+BENCHMARK(atomic_wait_ping_pong)->UseRealTime();
+
+static void condition_variable_ping_pong(benchmark::State& state)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  enum_flags<PingPong, uint32_t> flags;
+
+  std::thread ponger([&] {
+    std::unique_lock lock{ mutex };
+    for (;;)
+    {
+      cv.wait(lock, [&] { return flags.are_any_set(PingPong::Ping, PingPong::Quit); });
+      if (flags.is_set(PingPong::Quit))
+        return;
+      flags.unset(PingPong::Ping);
+      flags.set(PingPong::Pong);
+      cv.notify_all();
+    }
+  });
+
+  for (auto _ : state)
+  {
+    std::unique_lock lock{ mutex };
+    flags.set(PingPong::Ping);
+    cv.notify_all();
+    cv.wait(lock, [&] { return flags.is_set(PingPong::Pong); });
+    flags.unset(PingPong::Pong);
+  }
+
+  {
+    std::lock_guard lock{ mutex };
+    flags.set(PingPong::Quit);
+  }
+  cv.notify_all();
+  ponger.join();
+}
+BENCHMARK(condition_variable_ping_pong)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,83 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Reader scaling for a shared set of 256 flags: 1 to 64 threads each take consistent snapshots, from
+/// `atomic_wide_enum_flags` (seqlock) versus a `wide_enum_flags` behind a `std::shared_mutex`. The `writing` variants
+/// run one more thread that toggles a pair of flags in different words every 10us for the whole run.
+/// Each op is one snapshot of one reader; real time is reported, so per-thread throughput is items_per_second divided
+/// by the thread count.
+
+#include "../include/atomic_wide_enum_flags.h"
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+using flags = wide_enum_flags<int, 256>;
+
+struct seqlock_registry
+{
+  atomic_wide_enum_flags<int, 256> value{ 3, 100, 200 };
+  flags snapshot() const { return value.snapshot(); }
+  void toggle() { value.toggle(0, 255); }
+};
+
+struct shared_mutex_registry
+{
+  mutable std::shared_mutex mutex;
+  flags value{ 3, 100, 200 };
+  flags snapshot() const { std::shared_lock lock{ mutex }; return value; }
+  void toggle() { std::unique_lock lock{ mutex }; value.toggle(0, 255); }
+};
+
+/// Started by the first reader before its loop and stopped after it
+struct background_writer
+{
+  std::atomic<bool> stop = false;
+  std::thread thread;
+
+  template <typename REGISTRY>
+  void start(REGISTRY& registry)
+  {
+    stop = false;
+    thread = std::thread{ [this, &registry] {
+      while (!stop.load(std::memory_order_relaxed))
+      {
+        registry.toggle();
+        std::this_thread::sleep_for(std::chrono::microseconds{ 10 });
+      }
+    } };
+  }
+  void finish()
+  {
+    stop = true;
+    thread.join();
+  }
+};
+
+template <typename REGISTRY, bool WRITING>
+static void snapshots(benchmark::State& state)
+{
+  static REGISTRY registry;
+  static background_writer writer;
+  if (WRITING && state.thread_index() == 0) writer.start(registry);
+  size_t count = 0;
+  for (auto _ : state)
+  {
+    const auto snapshot = registry.snapshot();
+    count += snapshot.bits[1] & 1;
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()));
+  if (WRITING && state.thread_index() == 0) writer.finish();
+}
+BENCHMARK(snapshots<seqlock_registry, false>)->Name("snapshots/seqlock")->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(snapshots<shared_mutex_registry, false>)->Name("snapshots/shared_mutex")->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(snapshots<seqlock_registry, true>)->Name("snapshots/seqlock_writing")->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(snapshots<shared_mutex_registry, true>)->Name("snapshots/shared_mutex_writing")->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,122 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// 8M `enum_flags<int, uint64_t>` values drawn from 200 distinct combinations, stored plainly (`enum_flags_column`
+/// kernels) versus dictionary-encoded (enum_flags_dictionary.h, one-byte IDs): encoding and decoding, counting and
+/// filtering with the same query, and grouping rows by value (hash map of row lists versus counting sort).
+
+#include "../include/enum_flags_dictionary.h"
+#include "instruction_counter.h"
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+using flags = enum_flags<int, uint64_t>;
+
+constexpr size_t element_count = size_t(1) << 23;
+constexpr size_t distinct_count = 200;
+
+static std::vector<flags> const& values()
+{
+  static const auto result = [] {
+    std::mt19937_64 rng{ 42 };
+    std::vector<flags> distinct(distinct_count);
+    for (auto& f : distinct) f = flags::from_bits(rng() & rng());
+    std::vector<flags> v(element_count);
+    for (auto& f : v) f = distinct[rng() % distinct_count];
+    return v;
+  }();
+  return result;
+}
+
+static enum_flags_dictionary_column<int, uint64_t> const& column()
+{
+  static const enum_flags_dictionary_column<int, uint64_t> result{ std::span<flags const>{ values() } };
+  return result;
+}
+
+constexpr auto required = flags{ 3, 17 };
+constexpr auto forbidden = flags{ 40 };
+
+template <typename FUNC>
+static void run(benchmark::State& state, FUNC&& func)
+{
+  per_op_counters counters{ state, int64_t(element_count) };
+  for (auto _ : state)
+  {
+    auto result = func();
+    benchmark::DoNotOptimize(result);
+    benchmark::ClobberMemory();
+  }
+  counters.finish();
+}
+
+static void encode(benchmark::State& state)
+{
+  enum_flags_dictionary<int, uint64_t> dictionary;
+  std::vector<uint8_t> ids(element_count);
+  run(state, [&] { return dictionary.encode(std::span<flags const>{ values() }, std::span{ ids }); });
+  state.counters["bytes_plain"] = double(element_count * sizeof(flags));
+  state.counters["bytes_encoded"] = double(column().storage_bytes());
+}
+BENCHMARK(encode);
+
+static void decode(benchmark::State& state)
+{
+  std::vector<flags> out(element_count);
+  run(state, [&] { column().copy_to(std::span{ out }); return out.data(); });
+}
+BENCHMARK(decode);
+
+static void count_plain(benchmark::State& state)
+{
+  run(state, [] { return count_flags(std::span<flags const>{ values() }, required, forbidden); });
+}
+BENCHMARK(count_plain);
+
+static void count_dictionary(benchmark::State& state)
+{
+  run(state, [] { return column().count([](flags f) { return f.are_all_set(required) && (f.bits & forbidden.bits) == 0; }); });
+}
+BENCHMARK(count_dictionary);
+
+static void filter_plain(benchmark::State& state)
+{
+  std::vector<flag_selection_index> out(element_count);
+  run(state, [&] { return filter_flags(std::span<flags const>{ values() }, required, forbidden, std::span{ out }); });
+}
+BENCHMARK(filter_plain);
+
+static void filter_dictionary(benchmark::State& state)
+{
+  std::vector<flag_selection_index> out(element_count);
+  run(state, [&] {
+    const auto table = column().dictionary().lookup_table([](flags f) { return f.are_all_set(required) && (f.bits & forbidden.bits) == 0; });
+    return filter_matching_ids(column().ids8(), std::span<uint8_t const>{ table }, std::span{ out });
+  });
+}
+BENCHMARK(filter_dictionary);
+
+static void group_hash_map(benchmark::State& state)
+{
+  run(state, [] {
+    std::unordered_map<flags, std::vector<flag_selection_index>> groups;
+    auto const& v = values();
+    for (size_t i = 0; i < v.size(); ++i) groups[v[i]].push_back(flag_selection_index(i));
+    return groups.size();
+  });
+}
+BENCHMARK(group_hash_map);
+
+static void group_counting_sort(benchmark::State& state)
+{
+  run(state, [] { return column().group().group_count(); });
+}
+BENCHMARK(group_counting_sort);
+
+BENCHMARK_MAIN();
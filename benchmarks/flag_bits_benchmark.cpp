@@ -0,0 +1,253 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Every flag operation, for every supported VALUE_TYPE, through every interface:
+/// raw bit operations, the flag_bits.h free functions, enum_flags members, atomic_enum_flags (relaxed and seq_cst)
+/// and std::bitset. Benchmarks are named `<operation>/<interface>/<value type>`.
+
+#include "../include/flag_bits_v.h"
+#include "../include/flag_bits.h"
+#include "../include/enum_flags.h"
+#include "../include/atomic_enum_flags.h"
+#include "instruction_counter.h"
+#include <bitset>
+#include <climits>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+enum class Flag : int {};
+
+constexpr int ops_per_iteration = 256;
+
+template <typename T>
+constexpr int bit_count = int(CHAR_BIT * sizeof(T));
+
+template <typename T>
+static std::vector<Flag> make_flags()
+{
+  std::mt19937 rng{ 42 };
+  std::vector<Flag> result(ops_per_iteration + 1);
+  for (auto& flag : result)
+    flag = Flag(int(rng() % unsigned(bit_count<T>)));
+  return result;
+}
+
+/// Interfaces
+
+template <typename T>
+struct raw
+{
+  static constexpr const char* name = "raw";
+  T bits = 0;
+  static T bit(Flag f) { return T(T(1) << int(f)); }
+  void set(Flag f) { bits |= bit(f); }
+  void unset(Flag f) { bits &= T(~bit(f)); }
+  void toggle(Flag f) { bits ^= bit(f); }
+  void set_to(bool v, Flag f) { if (v) bits |= bit(f); else bits &= T(~bit(f)); }
+  bool is_set(Flag f) const { return (bits & bit(f)) != 0; }
+  bool are_all_set(Flag a, Flag b) const { const T m = T(bit(a) | bit(b)); return (bits & m) == m; }
+  bool are_any_set(Flag a, Flag b) const { return (bits & T(bit(a) | bit(b))) != 0; }
+};
+
+template <typename T>
+struct free_functions
+{
+  static constexpr const char* name = "free_functions";
+  T bits = 0;
+  void set(Flag f) { set_flags(bits, f); }
+  void unset(Flag f) { unset_flags(bits, f); }
+  void toggle(Flag f) { toggle_flags(bits, f); }
+  void set_to(bool v, Flag f) { set_flags_to(bits, v, f); }
+  bool is_set(Flag f) const { return is_flag_set(bits, f); }
+  bool are_all_set(Flag a, Flag b) const { return are_all_flags_set(bits, a, b); }
+  bool are_any_set(Flag a, Flag b) const { return are_any_flags_set(bits, a, b); }
+};
+
+template <typename T>
+struct members
+{
+  static constexpr const char* name = "enum_flags";
+  enum_flags<Flag, T> bits;
+  void set(Flag f) { bits.set(f); }
+  void unset(Flag f) { bits.unset(f); }
+  void toggle(Flag f) { bits.toggle(f); }
+  void set_to(bool v, Flag f) { bits.set_to(v, f); }
+  bool is_set(Flag f) const { return bits.is_set(f); }
+  bool are_all_set(Flag a, Flag b) const { return bits.are_all_set(a, b); }
+  bool are_any_set(Flag a, Flag b) const { return bits.are_any_set(a, b); }
+};
+
+template <typename T, std::memory_order ORDER>
+struct atomic
+{
+  static constexpr const char* name = ORDER == std::memory_order_relaxed ? "atomic_relaxed" : "atomic_seq_cst";
+  atomic_enum_flags<Flag, T> bits;
+  void set(Flag f) { bits.set(f, ORDER); }
+  void unset(Flag f) { bits.unset(f, ORDER); }
+  void toggle(Flag f) { bits.toggle(f, ORDER); }
+  void set_to(bool v, Flag f) { bits.set_to(v, f, ORDER); }
+  bool is_set(Flag f) const { return bits.is_set(f, ORDER); }
+  bool are_all_set(Flag a, Flag b) const { return bits.are_all_set({ a, b }, ORDER); }
+  bool are_any_set(Flag a, Flag b) const { return bits.are_any_set({ a, b }, ORDER); }
+};
+
+template <typename T>
+struct bitset
+{
+  static constexpr const char* name = "std_bitset";
+  std::bitset<bit_count<T>> bits;
+  void set(Flag f) { bits.set(size_t(f)); }
+  void unset(Flag f) { bits.reset(size_t(f)); }
+  void toggle(Flag f) { bits.flip(size_t(f)); }
+  void set_to(bool v, Flag f) { bits.set(size_t(f), v); }
+  bool is_set(Flag f) const { return bits.test(size_t(f)); }
+  bool are_all_set(Flag a, Flag b) const { return bits.test(size_t(a)) && bits.test(size_t(b)); }
+  bool are_any_set(Flag a, Flag b) const { return bits.test(size_t(a)) || bits.test(size_t(b)); }
+};
+
+/// Operations
+
+struct op_set { static constexpr const char* name = "set"; template <typename I> static void run(I& i, Flag a, Flag) { i.set(a); } };
+struct op_unset { static constexpr const char* name = "unset"; template <typename I> static void run(I& i, Flag a, Flag) { i.unset(a); } };
+struct op_toggle { static constexpr const char* name = "toggle"; template <typename I> static void run(I& i, Flag a, Flag) { i.toggle(a); } };
+struct op_set_to { static constexpr const char* name = "set_to"; template <typename I> static void run(I& i, Flag a, Flag b) { i.set_to(int(b) & 1, a); } };
+struct op_is_set { static constexpr const char* name = "is_set"; template <typename I> static bool run(I& i, Flag a, Flag) { return i.is_set(a); } };
+struct op_are_all_set { static constexpr const char* name = "are_all_set"; template <typename I> static bool run(I& i, Flag a, Flag b) { return i.are_all_set(a, b); } };
+struct op_are_any_set { static constexpr const char* name = "are_any_set"; template <typename I> static bool run(I& i, Flag a, Flag b) { return i.are_any_set(a, b); } };
+
+template <typename OP, typename IMPL, typename T>
+static void flag_operation(benchmark::State& state)
+{
+  const auto flags = make_flags<T>();
+  IMPL impl;
+  impl.set(flags[0]);
+  int hits = 0;
+
+  per_op_counters counters{ state, ops_per_iteration };
+  for (auto _ : state)
+  {
+    for (int i = 0; i < ops_per_iteration; ++i)
+    {
+      if constexpr (std::is_void_v<decltype(OP::run(impl, flags[i], flags[i + 1]))>)
+        OP::run(impl, flags[i], flags[i + 1]);
+      else
+        hits += OP::run(impl, flags[i], flags[i + 1]);
+    }
+    benchmark::DoNotOptimize(impl);
+    benchmark::DoNotOptimize(hits);
+  }
+  counters.finish();
+}
+
+/// flag_bits (runtime mask construction) vs the equivalent shifts
+
+template <typename T>
+static void flag_bits_mask(benchmark::State& state)
+{
+  const auto flags = make_flags<T>();
+  T acc = 0;
+  per_op_counters counters{ state, ops_per_iteration };
+  for (auto _ : state)
+  {
+    for (int i = 0; i < ops_per_iteration; ++i)
+      acc ^= flag_bits<T>(flags[i], flags[i + 1]);
+    benchmark::DoNotOptimize(acc);
+  }
+  counters.finish();
+}
+
+template <typename T>
+static void raw_mask(benchmark::State& state)
+{
+  const auto flags = make_flags<T>();
+  T acc = 0;
+  per_op_counters counters{ state, ops_per_iteration };
+  for (auto _ : state)
+  {
+    for (int i = 0; i < ops_per_iteration; ++i)
+      acc ^= T((T(1) << int(flags[i])) | (T(1) << int(flags[i + 1])));
+    benchmark::DoNotOptimize(acc);
+  }
+  counters.finish();
+}
+
+/// flag_bits_v (compile-time mask) vs a literal constant; these should be identical
+
+template <typename T>
+static void flag_bits_v_mask(benchmark::State& state)
+{
+  T bits = 0;
+  per_op_counters counters{ state, ops_per_iteration };
+  for (auto _ : state)
+  {
+    for (int i = 0; i < ops_per_iteration; ++i)
+    {
+      bits ^= flag_bits_v<T, Flag{ 1 }, Flag{ 5 }>;
+      benchmark::DoNotOptimize(bits);
+    }
+  }
+  counters.finish();
+}
+
+template <typename T>
+static void literal_mask(benchmark::State& state)
+{
+  T bits = 0;
+  per_op_counters counters{ state, ops_per_iteration };
+  for (auto _ : state)
+  {
+    for (int i = 0; i < ops_per_iteration; ++i)
+    {
+      bits ^= T(0x22);
+      benchmark::DoNotOptimize(bits);
+    }
+  }
+  counters.finish();
+}
+
+template <typename T> constexpr const char* type_name = "";
+template <> constexpr const char* type_name<uint8_t> = "uint8_t";
+template <> constexpr const char* type_name<uint16_t> = "uint16_t";
+template <> constexpr const char* type_name<uint32_t> = "uint32_t";
+template <> constexpr const char* type_name<uint64_t> = "uint64_t";
+
+template <typename T>
+static void register_for_type()
+{
+  const auto suffix = std::string{ "/" } + type_name<T>;
+
+  benchmark::RegisterBenchmark(("flag_bits/flag_bits" + suffix).c_str(), flag_bits_mask<T>);
+  benchmark::RegisterBenchmark(("flag_bits/raw" + suffix).c_str(), raw_mask<T>);
+  benchmark::RegisterBenchmark(("flag_bits_v/flag_bits_v" + suffix).c_str(), flag_bits_v_mask<T>);
+  benchmark::RegisterBenchmark(("flag_bits_v/raw" + suffix).c_str(), literal_mask<T>);
+
+  [&]<typename... OPS>() {
+    ([&]<typename OP>() {
+      [&]<typename... IMPLS>() {
+        (benchmark::RegisterBenchmark((std::string{ OP::name } + "/" + IMPLS::name + suffix).c_str(), flag_operation<OP, IMPLS, T>), ...);
+      }.template operator()<raw<T>, free_functions<T>, members<T>, atomic<T, std::memory_order_relaxed>, atomic<T, std::memory_order_seq_cst>, bitset<T>>();
+    }.template operator()<OPS>(), ...);
+  }.template operator()<op_set, op_unset, op_toggle, op_set_to, op_is_set, op_are_all_set, op_are_any_set>();
+}
+
+int main(int argc, char** argv)
+{
+  register_for_type<uint8_t>();
+  register_for_type<uint16_t>();
+  register_for_type<uint32_t>();
+  register_for_type<uint64_t>();
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,79 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Memory footprint and scan speed of flag-heavy structures with the default `enum_flags` value type (unsigned long long)
+/// versus `enum_flags_for`, which picks the smallest fitting type from `enum_flags_traits`.
+/// Arrays are large enough not to fit in cache, so scans are bound by memory bandwidth.
+
+#include "../include/enum_flags.h"
+#include "instruction_counter.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+enum class EntityFlag { Visible, Dirty, Static, Selected, Hidden };
+template <> struct ghassanpl::enum_flags_traits<EntityFlag> { static constexpr EntityFlag last = EntityFlag::Hidden; };
+
+template <typename FLAGS>
+struct entity
+{
+  std::uint32_t id;
+  FLAGS flags;
+};
+
+constexpr size_t entity_count = size_t(1) << 23;
+
+template <typename ELEMENT, typename GET_FLAGS>
+static void scan(benchmark::State& state, GET_FLAGS&& get_flags)
+{
+  std::vector<ELEMENT> elements(entity_count);
+  std::mt19937 rng{ 42 };
+  for (auto& element : elements)
+  {
+    auto& flags = get_flags(element);
+    flags = std::remove_reference_t<decltype(flags)>::from_bits(rng() & 0x1F);
+  }
+
+  per_op_counters counters{ state, int64_t(elements.size()) };
+  for (auto _ : state)
+  {
+    size_t count = 0;
+    for (auto const& element : elements)
+      count += get_flags(element).are_all_set(EntityFlag::Visible, EntityFlag::Dirty);
+    benchmark::DoNotOptimize(count);
+  }
+  counters.finish();
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(elements.size() * sizeof(ELEMENT)));
+  state.counters["bytes_per_element"] = double(sizeof(ELEMENT));
+  state.counters["total_MiB"] = double(elements.size() * sizeof(ELEMENT)) / (1024.0 * 1024.0);
+}
+
+static void flags_array_default(benchmark::State& state)
+{
+  scan<enum_flags<EntityFlag>>(state, [](auto& f) -> auto& { return f; });
+}
+BENCHMARK(flags_array_default);
+
+static void flags_array_smallest(benchmark::State& state)
+{
+  scan<enum_flags_for<EntityFlag>>(state, [](auto& f) -> auto& { return f; });
+}
+BENCHMARK(flags_array_smallest);
+
+static void entity_array_default(benchmark::State& state)
+{
+  scan<entity<enum_flags<EntityFlag>>>(state, [](auto& e) -> auto& { return e.flags; });
+}
+BENCHMARK(entity_array_default);
+
+static void entity_array_smallest(benchmark::State& state)
+{
+  scan<entity<enum_flags_for<EntityFlag>>>(state, [](auto& e) -> auto& { return e.flags; });
+}
+BENCHMARK(entity_array_smallest);
+
+BENCHMARK_MAIN();
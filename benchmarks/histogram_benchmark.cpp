@@ -0,0 +1,112 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Per-flag population counts over 8M `enum_flags` values: the naive `for_each` over every element incrementing one
+/// counter per set bit, versus the carry-save (Harley-Seal) kernels in enum_flags_histogram.h, single- and multi-threaded.
+
+#include "../include/enum_flags_histogram.h"
+#include "instruction_counter.h"
+#include <random>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+constexpr size_t element_count = size_t(1) << 23;
+
+template <typename VALUE_TYPE>
+static std::vector<enum_flags<int, VALUE_TYPE>> const& values()
+{
+  static const auto result = [] {
+    std::vector<enum_flags<int, VALUE_TYPE>> v(element_count);
+    std::mt19937_64 rng{ 42 };
+    for (auto& f : v) f = enum_flags<int, VALUE_TYPE>::from_bits(static_cast<VALUE_TYPE>(rng()));
+    return v;
+  }();
+  return result;
+}
+
+template <typename VALUE_TYPE, typename FUNC>
+static void run(benchmark::State& state, FUNC&& func)
+{
+  auto const& v = values<VALUE_TYPE>();
+  per_op_counters counters{ state, int64_t(v.size()) };
+  for (auto _ : state)
+  {
+    auto result = func(std::span<enum_flags<int, VALUE_TYPE> const>{ v });
+    benchmark::DoNotOptimize(result);
+  }
+  counters.finish();
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(v.size() * sizeof(VALUE_TYPE)));
+}
+
+template <typename VALUE_TYPE>
+static void histogram_for_each(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) {
+    std::array<uint64_t, CHAR_BIT * sizeof(VALUE_TYPE)> counts{};
+    for (auto f : span) f.for_each([&](int flag) { ++counts[flag]; });
+    return counts;
+  });
+}
+
+template <typename VALUE_TYPE>
+static void histogram_scalar(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) {
+    detail::bit_counts<VALUE_TYPE> counts{};
+    detail::count_each_flag_scalar(detail::column_bits(span), span.size(), counts);
+    return counts;
+  });
+}
+
+template <typename VALUE_TYPE>
+static void histogram_avx2(benchmark::State& state)
+{
+  if (!detail::get_cpu_features().avx2) { state.SkipWithError("AVX2 not supported"); return; }
+  run<VALUE_TYPE>(state, [](auto span) {
+    detail::bit_counts<VALUE_TYPE> counts{};
+    detail::count_each_flag_avx2(detail::column_bits(span), span.size(), counts);
+    return counts;
+  });
+}
+
+template <typename VALUE_TYPE>
+static void histogram_threads(benchmark::State& state)
+{
+  run<VALUE_TYPE>(state, [](auto span) { return count_each_flag(span, std::max(1u, std::thread::hardware_concurrency())); });
+}
+
+template <typename T> constexpr const char* type_name = "";
+template <> constexpr const char* type_name<uint8_t> = "uint8_t";
+template <> constexpr const char* type_name<uint16_t> = "uint16_t";
+template <> constexpr const char* type_name<uint32_t> = "uint32_t";
+template <> constexpr const char* type_name<uint64_t> = "uint64_t";
+
+template <typename T>
+static void register_for_type()
+{
+  const auto suffix = std::string{ "/" } + type_name<T>;
+  benchmark::RegisterBenchmark(("histogram/for_each" + suffix).c_str(), histogram_for_each<T>);
+  benchmark::RegisterBenchmark(("histogram/scalar" + suffix).c_str(), histogram_scalar<T>);
+  benchmark::RegisterBenchmark(("histogram/avx2" + suffix).c_str(), histogram_avx2<T>);
+  benchmark::RegisterBenchmark(("histogram/threads" + suffix).c_str(), histogram_threads<T>)->UseRealTime();
+}
+
+int main(int argc, char** argv)
+{
+  register_for_type<uint8_t>();
+  register_for_type<uint16_t>();
+  register_for_type<uint32_t>();
+  register_for_type<uint64_t>();
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
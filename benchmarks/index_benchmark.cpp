@@ -0,0 +1,76 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// "All entities with A and B but not C" over 16M entities: scanning every `enum_flags` value with `count_flags`,
+/// versus `enum_flags_index`, whose cost follows the density of the result. Flags get rarer with their
+/// index, so the benchmark argument (the index of flag A; B is A + 1, C is A + 2) controls selectivity.
+
+#include "../include/enum_flags_index.h"
+#include "../include/enum_flags_column.h"
+#include "instruction_counter.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+using flags = enum_flags<int, std::uint16_t>;
+
+constexpr size_t entity_count = size_t(1) << 24;
+
+/// Flag i is set with probability 2^-(i + 1)
+static std::vector<flags> const& entities()
+{
+  static const auto result = [] {
+    std::vector<flags> values(entity_count);
+    std::mt19937_64 rng{ 42 };
+    for (auto& f : values)
+      for (int i = 0; i < 16; ++i)
+        f.set_to((rng() & ((1ull << (i + 1)) - 1)) == 0, i);
+    return values;
+  }();
+  return result;
+}
+
+static enum_flags_index<int, std::uint16_t> const& index()
+{
+  static const enum_flags_index<int, std::uint16_t> result{ std::span<flags const>{ entities() } };
+  return result;
+}
+
+static void query_scan(benchmark::State& state)
+{
+  const auto flag = int(state.range(0));
+  auto const& values = entities();
+  per_op_counters counters{ state, 1 };
+  size_t found = 0;
+  for (auto _ : state)
+  {
+    found = count_flags(std::span<flags const>{ values }, flags{ flag, flag + 1 }, flags{ flag + 2 });
+    benchmark::DoNotOptimize(found);
+  }
+  counters.finish();
+  state.counters["matches"] = double(found);
+}
+BENCHMARK(query_scan)->Arg(0)->Arg(2)->Arg(4)->Arg(6)->Arg(8)->Arg(10);
+
+static void query_index(benchmark::State& state)
+{
+  const auto flag = int(state.range(0));
+  auto const& idx = index();
+  per_op_counters counters{ state, 1 };
+  size_t found = 0;
+  for (auto _ : state)
+  {
+    found = idx.count(flags{ flag, flag + 1 }, {}, flags{ flag + 2 });
+    benchmark::DoNotOptimize(found);
+  }
+  counters.finish();
+  state.counters["matches"] = double(found);
+  state.counters["index_MiB"] = double(idx.memory_usage()) / (1024.0 * 1024.0);
+}
+BENCHMARK(query_index)->Arg(0)->Arg(2)->Arg(4)->Arg(6)->Arg(8)->Arg(10);
+
+BENCHMARK_MAIN();
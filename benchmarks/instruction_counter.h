@@ -0,0 +1,106 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+/// Counts retired user-mode instructions of the calling thread with perf_event_open (Linux only).
+/// Where hardware counters are unavailable (other OSes, VMs without a virtual PMU, perf_event_paranoid > 2),
+/// `available()` is false and benchmarks simply don't report an instruction count.
+
+#include <cstdint>
+#include <benchmark/benchmark.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+struct instruction_counter
+{
+  instruction_counter()
+  {
+#if defined(__linux__)
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~instruction_counter()
+  {
+#if defined(__linux__)
+    if (fd >= 0) close(fd);
+#endif
+  }
+
+  instruction_counter(instruction_counter const&) = delete;
+  instruction_counter& operator=(instruction_counter const&) = delete;
+
+  bool available() const noexcept { return fd >= 0; }
+
+  void start() noexcept
+  {
+#if defined(__linux__)
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  std::uint64_t stop() noexcept
+  {
+    std::uint64_t count = 0;
+#if defined(__linux__)
+    if (fd < 0) return 0;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+      count = 0;
+#endif
+    return count;
+  }
+
+private:
+
+  int fd = -1;
+};
+
+/// Adds `time_per_op` (in seconds) and (when counters are available) `instructions_per_op` to a benchmark that performs
+/// `ops_per_iteration` operations per state iteration. Wrap the `for (auto _ : state)` loop:
+///
+///   per_op_counters counters{ state, 256 };
+///   for (auto _ : state) { ... }
+///   counters.finish();
+struct per_op_counters
+{
+  per_op_counters(benchmark::State& state, std::int64_t ops_per_iteration)
+    : state(state), ops_per_iteration(ops_per_iteration)
+  {
+    counter.start();
+  }
+
+  void finish()
+  {
+    const auto instructions = counter.stop();
+    const auto ops = double(state.iterations()) * double(ops_per_iteration);
+    state.SetItemsProcessed(std::int64_t(ops));
+    state.counters["time_per_op"] = benchmark::Counter(double(ops_per_iteration), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    if (counter.available() && ops > 0)
+      state.counters["instructions_per_op"] = double(instructions) / ops;
+  }
+
+private:
+
+  benchmark::State& state;
+  std::int64_t ops_per_iteration;
+  instruction_counter counter;
+};
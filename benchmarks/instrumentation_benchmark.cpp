@@ -0,0 +1,54 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// The cost of flag_instrumentation.h: the same mix of `is_set`, `set`, `unset` and `toggle` on random flags of an
+/// enum without instrumentation, with per-flag counters, and with counters per call site (inside one
+/// `flag_instrumentation_site`). Each op counts one flag operation.
+
+#include "../include/flag_instrumentation.h"
+#include "instruction_counter.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+enum class plain_flag : uint8_t {};
+enum class counted_flag : uint8_t {};
+enum class site_counted_flag : uint8_t {};
+
+template <> struct ghassanpl::enum_flags_traits<counted_flag> { using instrumentation = flag_counting_instrumentation; };
+template <> struct ghassanpl::enum_flags_traits<site_counted_flag> { using instrumentation = flag_site_counting_instrumentation; };
+
+constexpr size_t op_count = 4096;
+
+template <typename ENUM>
+static void operations(benchmark::State& state)
+{
+  std::mt19937_64 rng{ 19 };
+  std::vector<ENUM> flags(op_count);
+  for (auto& flag : flags) flag = ENUM(rng() % 32);
+  flag_instrumentation_site site;
+  enum_flags<ENUM, uint32_t> value;
+  uint32_t hits = 0;
+  per_op_counters counters{ state, int64_t(op_count) };
+  for (auto _ : state)
+  {
+    for (size_t i = 0; i < op_count; i += 4)
+    {
+      hits += value.is_set(flags[i]);
+      value.set(flags[i + 1]);
+      value.unset(flags[i + 2]);
+      value.toggle(flags[i + 3]);
+    }
+    benchmark::DoNotOptimize(hits);
+  }
+  counters.finish();
+}
+BENCHMARK(operations<plain_flag>)->Name("operations/plain");
+BENCHMARK(operations<counted_flag>)->Name("operations/counted");
+BENCHMARK(operations<site_counted_flag>)->Name("operations/site_counted");
+
+BENCHMARK_MAIN();
@@ -0,0 +1,103 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Strategies for visiting the set bits of an enum_flags, over sparse, medium and dense masks:
+/// - range: `for (auto flag : flags)` (clear-lowest-bit + countr_zero, what the library uses)
+/// - for_each: `enum_flags::for_each`
+/// - isolate_lowest: the previous for_each loop (`t = bitset & -bitset; countr_zero(t); bitset ^= t`)
+/// - naive: test every bit position
+/// - reverse: `rbegin()`/`rend()` (clear-highest-bit + bit_width)
+
+#include "../include/enum_flags.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+enum class Bit : int {};
+using flags = enum_flags<Bit, uint64_t>;
+
+static std::vector<flags> make_masks(int bits_per_mask)
+{
+  std::mt19937_64 rng{ 42 };
+  std::vector<flags> result(4096);
+  for (auto& mask : result)
+  {
+    while (std::popcount(mask.bits) < bits_per_mask)
+      mask.set(Bit(rng() % 64));
+  }
+  return result;
+}
+
+template <typename VISIT>
+static void run(benchmark::State& state, VISIT&& visit)
+{
+  const auto masks = make_masks(int(state.range(0)));
+  for (auto _ : state)
+  {
+    int sum = 0;
+    for (auto mask : masks)
+      visit(mask, sum);
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(masks.size()));
+}
+
+static void iterate_range(benchmark::State& state)
+{
+  run(state, [](flags mask, int& sum) {
+    for (auto flag : mask)
+      sum += int(flag);
+  });
+}
+
+static void iterate_for_each(benchmark::State& state)
+{
+  run(state, [](flags mask, int& sum) {
+    mask.for_each([&](Bit flag) { sum += int(flag); });
+  });
+}
+
+static void iterate_isolate_lowest(benchmark::State& state)
+{
+  run(state, [](flags mask, int& sum) {
+    auto bitset = mask.bits;
+    while (bitset)
+    {
+      const auto t = bitset & (0 - bitset);
+      sum += std::countr_zero(t);
+      bitset ^= t;
+    }
+  });
+}
+
+static void iterate_naive(benchmark::State& state)
+{
+  run(state, [](flags mask, int& sum) {
+    for (int i = 0; i < 64; ++i)
+      if (mask.is_set(i))
+        sum += i;
+  });
+}
+
+static void iterate_reverse(benchmark::State& state)
+{
+  run(state, [](flags mask, int& sum) {
+    for (auto it = mask.rbegin(); it != mask.rend(); ++it)
+      sum += int(*it);
+  });
+}
+
+/// Bits set per mask: sparse, medium, dense
+#define DENSITIES ->Arg(2)->Arg(16)->Arg(60)
+
+BENCHMARK(iterate_range) DENSITIES;
+BENCHMARK(iterate_for_each) DENSITIES;
+BENCHMARK(iterate_isolate_lowest) DENSITIES;
+BENCHMARK(iterate_naive) DENSITIES;
+BENCHMARK(iterate_reverse) DENSITIES;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,107 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Translating 1M flag sets into an OS-style layout: the usual chain of `if (in.is_set(X)) out.set(Y)`, versus
+/// `flag_mapping`, one value at a time and in batch. The "legacy" mapping keeps the order of flags spread over 32 bits
+/// (pext/pdep); the "internal" one reorders 10 flags held in 2 bytes (byte tables).
+
+#include "../include/flag_mapping.h"
+#include "instruction_counter.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+enum class Access { Read, Write, Exec, Create, Truncate, Append, Sync, Direct, Temporary, NoFollow };
+enum class Legacy { Read = 0, Write = 3, Exec = 7, Create = 10, Truncate = 13, Append = 17, Sync = 21, Direct = 24, Temporary = 28, NoFollow = 31 };
+enum class Os { R = 0, W = 1, X = 2, Creat = 6, Trunc = 9, Append = 10, Direct = 14, NoFollow = 17, Sync = 20, Tmp = 22 };
+
+using in_flags = enum_flags<Access, std::uint32_t>;
+using legacy_flags = enum_flags<Legacy, std::uint32_t>;
+using out_flags = enum_flags<Os, std::uint32_t>;
+
+using legacy = flag_mapping<Legacy, Os, flag_pair{ Legacy::Read, Os::R }, flag_pair{ Legacy::Write, Os::W }, flag_pair{ Legacy::Exec, Os::X },
+  flag_pair{ Legacy::Create, Os::Creat }, flag_pair{ Legacy::Truncate, Os::Trunc }, flag_pair{ Legacy::Append, Os::Append },
+  flag_pair{ Legacy::Sync, Os::Direct }, flag_pair{ Legacy::Direct, Os::NoFollow }, flag_pair{ Legacy::Temporary, Os::Sync }, flag_pair{ Legacy::NoFollow, Os::Tmp }>;
+using internal = flag_mapping<Access, Os, flag_pair{ Access::Read, Os::R }, flag_pair{ Access::Write, Os::W }, flag_pair{ Access::Exec, Os::X },
+  flag_pair{ Access::Create, Os::Creat }, flag_pair{ Access::Truncate, Os::Trunc }, flag_pair{ Access::Append, Os::Append },
+  flag_pair{ Access::Sync, Os::Sync }, flag_pair{ Access::Direct, Os::Direct }, flag_pair{ Access::Temporary, Os::Tmp }, flag_pair{ Access::NoFollow, Os::NoFollow }>;
+static_assert(legacy::strategy == flag_mapping_strategy::pext_pdep);
+static_assert(internal::strategy == flag_mapping_strategy::byte_table);
+
+constexpr size_t value_count = size_t(1) << 20;
+
+template <typename FLAGS>
+static std::vector<FLAGS> const& values()
+{
+  static const auto result = [] {
+    std::vector<FLAGS> v(value_count);
+    std::mt19937_64 rng{ 42 };
+    for (auto& f : v) f = FLAGS::from_bits(std::uint32_t(rng()));
+    return v;
+  }();
+  return result;
+}
+
+static out_flags legacy_branches(legacy_flags in)
+{
+  out_flags out;
+  if (in.is_set(Legacy::Read)) out.set(Os::R);
+  if (in.is_set(Legacy::Write)) out.set(Os::W);
+  if (in.is_set(Legacy::Exec)) out.set(Os::X);
+  if (in.is_set(Legacy::Create)) out.set(Os::Creat);
+  if (in.is_set(Legacy::Truncate)) out.set(Os::Trunc);
+  if (in.is_set(Legacy::Append)) out.set(Os::Append);
+  if (in.is_set(Legacy::Sync)) out.set(Os::Direct);
+  if (in.is_set(Legacy::Direct)) out.set(Os::NoFollow);
+  if (in.is_set(Legacy::Temporary)) out.set(Os::Sync);
+  if (in.is_set(Legacy::NoFollow)) out.set(Os::Tmp);
+  return out;
+}
+
+static out_flags internal_branches(in_flags in)
+{
+  out_flags out;
+  if (in.is_set(Access::Read)) out.set(Os::R);
+  if (in.is_set(Access::Write)) out.set(Os::W);
+  if (in.is_set(Access::Exec)) out.set(Os::X);
+  if (in.is_set(Access::Create)) out.set(Os::Creat);
+  if (in.is_set(Access::Truncate)) out.set(Os::Trunc);
+  if (in.is_set(Access::Append)) out.set(Os::Append);
+  if (in.is_set(Access::Sync)) out.set(Os::Sync);
+  if (in.is_set(Access::Direct)) out.set(Os::Direct);
+  if (in.is_set(Access::Temporary)) out.set(Os::Tmp);
+  if (in.is_set(Access::NoFollow)) out.set(Os::NoFollow);
+  return out;
+}
+
+template <typename FLAGS, typename FUNC>
+static void run(benchmark::State& state, FUNC&& func)
+{
+  auto const& in = values<FLAGS>();
+  std::vector<out_flags> out(in.size());
+  per_op_counters counters{ state, int64_t(in.size()) };
+  for (auto _ : state)
+  {
+    func(std::span<FLAGS const>{ in }, std::span<out_flags>{ out });
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  counters.finish();
+}
+
+static void legacy_if_chain(benchmark::State& state) { run<legacy_flags>(state, [](auto in, auto out) { for (size_t i = 0; i < in.size(); ++i) out[i] = legacy_branches(in[i]); }); }
+static void legacy_mapping(benchmark::State& state) { run<legacy_flags>(state, [](auto in, auto out) { for (size_t i = 0; i < in.size(); ++i) out[i] = legacy::map<std::uint32_t>(in[i]); }); }
+static void legacy_mapping_batch(benchmark::State& state) { run<legacy_flags>(state, [](auto in, auto out) { legacy::map(in, out); }); }
+static void internal_if_chain(benchmark::State& state) { run<in_flags>(state, [](auto in, auto out) { for (size_t i = 0; i < in.size(); ++i) out[i] = internal_branches(in[i]); }); }
+static void internal_mapping(benchmark::State& state) { run<in_flags>(state, [](auto in, auto out) { for (size_t i = 0; i < in.size(); ++i) out[i] = internal::map<std::uint32_t>(in[i]); }); }
+BENCHMARK(legacy_if_chain);
+BENCHMARK(legacy_mapping);
+BENCHMARK(legacy_mapping_batch);
+BENCHMARK(internal_if_chain);
+BENCHMARK(internal_mapping);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,98 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// `f.are_all_set(A, B) && !f.are_any_set(C, D) && (f.is_set(E) || f.is_set(F))` written with member calls,
+/// versus the same query as a fused `flag_predicate`, over random flag sets.
+
+#include "../include/flag_predicates.h"
+#include "instruction_counter.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+using namespace ghassanpl::flag_predicates;
+
+enum class Flag : int { A, B, C, D, E, F };
+using flags = enum_flags<Flag, uint64_t>;
+
+constexpr auto query = all_of<Flag::A, Flag::B> & none_of<Flag::C, Flag::D> & any_of<Flag::E, Flag::F>;
+
+static std::vector<flags> make_values()
+{
+  std::mt19937_64 rng{ 42 };
+  std::vector<flags> result(1 << 16);
+  for (auto& f : result)
+    f = flags::from_bits(rng() & 0x3F);
+  return result;
+}
+
+static bool member_query(flags f)
+{
+  return f.are_all_set(Flag::A, Flag::B) && !f.are_any_set(Flag::C, Flag::D) && (f.is_set(Flag::E) || f.is_set(Flag::F));
+}
+
+static void count_member_calls(benchmark::State& state)
+{
+  const auto values = make_values();
+  per_op_counters counters{ state, int64_t(values.size()) };
+  for (auto _ : state)
+  {
+    size_t count = 0;
+    for (auto f : values)
+      count += member_query(f);
+    benchmark::DoNotOptimize(count);
+  }
+  counters.finish();
+}
+BENCHMARK(count_member_calls);
+
+static void count_predicate(benchmark::State& state)
+{
+  const auto values = make_values();
+  per_op_counters counters{ state, int64_t(values.size()) };
+  for (auto _ : state)
+  {
+    auto count = query.count(std::span<flags const>{ values });
+    benchmark::DoNotOptimize(count);
+  }
+  counters.finish();
+}
+BENCHMARK(count_predicate);
+
+static void filter_member_calls(benchmark::State& state)
+{
+  const auto values = make_values();
+  std::vector<uint32_t> out(values.size());
+  per_op_counters counters{ state, int64_t(values.size()) };
+  for (auto _ : state)
+  {
+    size_t found = 0;
+    for (size_t i = 0; i < values.size(); ++i)
+      if (member_query(values[i]))
+        out[found++] = uint32_t(i);
+    benchmark::DoNotOptimize(found);
+    benchmark::DoNotOptimize(out.data());
+  }
+  counters.finish();
+}
+BENCHMARK(filter_member_calls);
+
+static void filter_predicate(benchmark::State& state)
+{
+  const auto values = make_values();
+  std::vector<uint32_t> out(values.size());
+  per_op_counters counters{ state, int64_t(values.size()) };
+  for (auto _ : state)
+  {
+    auto found = query.filter(std::span<flags const>{ values }, std::span{ out });
+    benchmark::DoNotOptimize(found);
+    benchmark::DoNotOptimize(out.data());
+  }
+  counters.finish();
+}
+BENCHMARK(filter_predicate);
+
+BENCHMARK_MAIN();
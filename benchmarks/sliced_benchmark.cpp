@@ -0,0 +1,140 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Two-flag queries over 16M 64-bit `enum_flags` values: `enum_flags_column` reads all 8 bytes of every value, while
+/// `enum_flags_sliced_column` reads only the two involved bitmaps (2 bits per value). Also measures the conversions
+/// between the layouts, with the 64x64 transpose versus element-by-element `assign`/`get`.
+
+#include "../include/enum_flags_sliced_column.h"
+#include "instruction_counter.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+using flags = enum_flags<int, std::uint64_t>;
+using sliced = enum_flags_sliced_column<int, std::uint64_t>;
+
+constexpr size_t element_count = size_t(1) << 24;
+static const flags required{ 1, 3 };
+
+static std::vector<flags> const& values()
+{
+  static const auto result = [] {
+    std::vector<flags> v(element_count);
+    std::mt19937_64 rng{ 42 };
+    for (auto& f : v) f = flags::from_bits(rng());
+    return v;
+  }();
+  return result;
+}
+
+static sliced const& sliced_values()
+{
+  static const sliced result{ std::span<flags const>{ values() } };
+  return result;
+}
+
+static void count_column(benchmark::State& state)
+{
+  auto const& v = values();
+  per_op_counters counters{ state, int64_t(v.size()) };
+  for (auto _ : state)
+    benchmark::DoNotOptimize(count_flags(std::span<flags const>{ v }, required, flags{}));
+  counters.finish();
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(v.size() * sizeof(flags)));
+}
+BENCHMARK(count_column);
+
+static void count_sliced(benchmark::State& state)
+{
+  auto const& s = sliced_values();
+  per_op_counters counters{ state, int64_t(s.size()) };
+  for (auto _ : state)
+    benchmark::DoNotOptimize(s.count(required));
+  counters.finish();
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(s.size() / 8 * 2));
+}
+BENCHMARK(count_sliced);
+
+static void filter_column(benchmark::State& state)
+{
+  auto const& v = values();
+  std::vector<flag_selection_index> out(v.size());
+  per_op_counters counters{ state, int64_t(v.size()) };
+  for (auto _ : state)
+    benchmark::DoNotOptimize(filter_flags(std::span<flags const>{ v }, required, flags{}, out));
+  counters.finish();
+}
+BENCHMARK(filter_column);
+
+static void filter_sliced(benchmark::State& state)
+{
+  auto const& s = sliced_values();
+  std::vector<flag_selection_index> out(s.size());
+  per_op_counters counters{ state, int64_t(s.size()) };
+  for (auto _ : state)
+    benchmark::DoNotOptimize(s.filter(required, {}, out));
+  counters.finish();
+}
+BENCHMARK(filter_sliced);
+
+static void to_sliced_transpose(benchmark::State& state)
+{
+  auto const& v = values();
+  per_op_counters counters{ state, int64_t(v.size()) };
+  for (auto _ : state)
+  {
+    sliced s{ std::span<flags const>{ v } };
+    benchmark::DoNotOptimize(s.plane(0).data());
+  }
+  counters.finish();
+}
+BENCHMARK(to_sliced_transpose);
+
+static void to_sliced_assign(benchmark::State& state)
+{
+  auto const& v = values();
+  per_op_counters counters{ state, int64_t(v.size()) };
+  for (auto _ : state)
+  {
+    sliced s{ v.size() };
+    for (size_t i = 0; i < v.size(); ++i) s.assign(i, v[i]);
+    benchmark::DoNotOptimize(s.plane(0).data());
+  }
+  counters.finish();
+}
+BENCHMARK(to_sliced_assign);
+
+static void from_sliced_transpose(benchmark::State& state)
+{
+  auto const& s = sliced_values();
+  std::vector<flags> out(s.size());
+  per_op_counters counters{ state, int64_t(s.size()) };
+  for (auto _ : state)
+  {
+    s.copy_to(out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  counters.finish();
+}
+BENCHMARK(from_sliced_transpose);
+
+static void from_sliced_get(benchmark::State& state)
+{
+  auto const& s = sliced_values();
+  std::vector<flags> out(s.size());
+  per_op_counters counters{ state, int64_t(s.size()) };
+  for (auto _ : state)
+  {
+    for (size_t i = 0; i < s.size(); ++i) out[i] = s.get(i);
+    benchmark::DoNotOptimize(out.data());
+  }
+  counters.finish();
+}
+BENCHMARK(from_sliced_get);
+
+BENCHMARK_MAIN();
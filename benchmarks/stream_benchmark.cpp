@@ -0,0 +1,146 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// A replay of 1024 frames of 4096 `enum_flags<int, uint64_t>` (32 MB raw) in which 16 values change per frame,
+/// stored as raw 8-byte values versus enum_flags_stream.h. Loading reads the raw file with `std::ifstream` one frame at
+/// a time, versus decoding every frame from a mapped stream file; both fold every frame into a checksum. The files
+/// are written to the temporary directory, so they are in the page cache when read.
+
+#include "../include/enum_flags_stream.h"
+#include "instruction_counter.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+using flags = enum_flags<int, uint64_t>;
+
+constexpr size_t entity_count = 4096;
+constexpr size_t frame_count = 1024;
+constexpr size_t changes_per_frame = 16;
+
+struct replay_files
+{
+  std::filesystem::path raw = std::filesystem::temp_directory_path() / "enum_flags_stream_benchmark.raw";
+  std::filesystem::path stream = std::filesystem::temp_directory_path() / "enum_flags_stream_benchmark.efs";
+
+  replay_files()
+  {
+    std::mt19937_64 rng{ 42 };
+    std::vector<flags> frame(entity_count);
+    for (auto& f : frame) f = flags::from_bits(rng() & rng());
+    std::ofstream raw_file{ raw, std::ios::binary };
+    std::ofstream stream_file{ stream, std::ios::binary };
+    enum_flags_stream_writer<int, uint64_t> writer{ stream_file, entity_count };
+    for (size_t f = 0; f < frame_count; ++f)
+    {
+      for (size_t c = 0; c < changes_per_frame; ++c) frame[rng() % entity_count].toggle(int(rng() % 64));
+      raw_file.write(reinterpret_cast<char const*>(frame.data()), std::streamsize(frame.size() * sizeof(flags)));
+      writer.write_frame(std::span<flags const>{ frame });
+    }
+  }
+  ~replay_files()
+  {
+    std::filesystem::remove(raw);
+    std::filesystem::remove(stream);
+  }
+};
+
+static replay_files const& files()
+{
+  static const replay_files result;
+  return result;
+}
+
+static uint64_t checksum(uint64_t sum, std::span<flags const> frame) { return sum * 31 + frame[sum % entity_count].bits; }
+
+static void report_sizes(benchmark::State& state)
+{
+  state.counters["file_bytes_raw"] = double(std::filesystem::file_size(files().raw));
+  state.counters["file_bytes_stream"] = double(std::filesystem::file_size(files().stream));
+}
+
+static void load_raw(benchmark::State& state)
+{
+  files();
+  per_op_counters counters{ state, int64_t(frame_count) };
+  std::vector<flags> frame(entity_count);
+  for (auto _ : state)
+  {
+    std::ifstream file{ files().raw, std::ios::binary };
+    uint64_t sum = 0;
+    for (size_t f = 0; f < frame_count; ++f)
+    {
+      file.read(reinterpret_cast<char*>(frame.data()), std::streamsize(frame.size() * sizeof(flags)));
+      sum = checksum(sum, frame);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  counters.finish();
+  report_sizes(state);
+}
+BENCHMARK(load_raw);
+
+static void load_stream(benchmark::State& state)
+{
+  files();
+  per_op_counters counters{ state, int64_t(frame_count) };
+  for (auto _ : state)
+  {
+    const auto mapped = enum_flags_mapped_file::open(files().stream);
+    const auto reader = enum_flags_stream_reader<int, uint64_t>::open(mapped->bytes());
+    uint64_t sum = 0;
+    reader->for_each_frame([&](size_t, std::span<flags const> frame) { sum = checksum(sum, frame); });
+    benchmark::DoNotOptimize(sum);
+  }
+  counters.finish();
+  report_sizes(state);
+}
+BENCHMARK(load_stream);
+
+/// Seeking to a random frame decodes its block up to it
+static void seek_stream(benchmark::State& state)
+{
+  const auto mapped = enum_flags_mapped_file::open(files().stream);
+  const auto reader = enum_flags_stream_reader<int, uint64_t>::open(mapped->bytes());
+  std::vector<flags> frame(entity_count);
+  std::mt19937_64 rng{ 7 };
+  per_op_counters counters{ state, 1 };
+  for (auto _ : state)
+  {
+    reader->read_frame(rng() % frame_count, std::span{ frame });
+    benchmark::DoNotOptimize(frame.data());
+  }
+  counters.finish();
+}
+BENCHMARK(seek_stream);
+
+static void write_stream(benchmark::State& state)
+{
+  std::mt19937_64 rng{ 42 };
+  std::vector<std::vector<flags>> frames(64, std::vector<flags>(entity_count));
+  for (size_t f = 1; f < frames.size(); ++f)
+  {
+    frames[f] = frames[f - 1];
+    for (size_t c = 0; c < changes_per_frame; ++c) frames[f][rng() % entity_count].toggle(int(rng() % 64));
+  }
+  per_op_counters counters{ state, int64_t(frames.size()) };
+  for (auto _ : state)
+  {
+    std::ostringstream out{ std::ios::binary };
+    enum_flags_stream_writer<int, uint64_t> writer{ out, entity_count };
+    for (auto const& frame : frames) writer.write_frame(std::span<flags const>{ frame });
+    writer.finish();
+    benchmark::DoNotOptimize(out.tellp());
+  }
+  counters.finish();
+}
+BENCHMARK(write_stream);
+
+BENCHMARK_MAIN();
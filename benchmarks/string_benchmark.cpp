@@ -0,0 +1,142 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// Text conversion of flag sets: `to_chars`/`from_chars` from enum_flags_string.h, versus the usual
+/// hand-written switch table with `for_each` and `std::string` concatenation.
+
+#include "../include/enum_flags_string.h"
+#include "instruction_counter.h"
+#include <random>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+enum class Access { Read, Write, Exec, Delete, Append, ChangeOwner, ChangePermissions, Synchronize };
+template <> struct ghassanpl::enum_flags_traits<Access> { static constexpr Access last = Access::Synchronize; };
+using flags = enum_flags_for<Access>;
+
+static std::vector<flags> make_values()
+{
+  std::mt19937 rng{ 42 };
+  std::vector<flags> result(1 << 12);
+  for (auto& f : result)
+    f = flags::from_bits(uint8_t(rng()));
+  return result;
+}
+
+static std::string_view switch_name(Access flag)
+{
+  switch (flag)
+  {
+  case Access::Read: return "Read";
+  case Access::Write: return "Write";
+  case Access::Exec: return "Exec";
+  case Access::Delete: return "Delete";
+  case Access::Append: return "Append";
+  case Access::ChangeOwner: return "ChangeOwner";
+  case Access::ChangePermissions: return "ChangePermissions";
+  case Access::Synchronize: return "Synchronize";
+  }
+  return {};
+}
+
+static flags switch_parse(std::string_view text)
+{
+  flags result;
+  while (!text.empty())
+  {
+    const auto separator = text.find('|');
+    const auto name = text.substr(0, separator);
+    for (int i = 0; i <= int(Access::Synchronize); ++i)
+      if (switch_name(Access(i)) == name)
+        result.set(Access(i));
+    text.remove_prefix(separator == std::string_view::npos ? text.size() : separator + 1);
+  }
+  return result;
+}
+
+static void format_string_concatenation(benchmark::State& state)
+{
+  const auto values = make_values();
+  per_op_counters counters{ state, int64_t(values.size()) };
+  for (auto _ : state)
+  {
+    for (auto f : values)
+    {
+      std::string text;
+      f.for_each([&](Access flag) {
+        if (!text.empty()) text += '|';
+        text += switch_name(flag);
+      });
+      benchmark::DoNotOptimize(text.data());
+    }
+  }
+  counters.finish();
+}
+BENCHMARK(format_string_concatenation);
+
+static void format_to_chars(benchmark::State& state)
+{
+  const auto values = make_values();
+  char buffer[max_flags_chars<flags>];
+  per_op_counters counters{ state, int64_t(values.size()) };
+  for (auto _ : state)
+  {
+    for (auto f : values)
+    {
+      auto result = to_chars(std::begin(buffer), std::end(buffer), f);
+      benchmark::DoNotOptimize(result.ptr);
+      benchmark::ClobberMemory();
+    }
+  }
+  counters.finish();
+}
+BENCHMARK(format_to_chars);
+
+static std::vector<std::string> make_texts()
+{
+  std::vector<std::string> result;
+  for (auto f : make_values())
+    result.push_back(to_string(f));
+  return result;
+}
+
+static void parse_switch_table(benchmark::State& state)
+{
+  const auto texts = make_texts();
+  per_op_counters counters{ state, int64_t(texts.size()) };
+  for (auto _ : state)
+  {
+    for (auto const& text : texts)
+    {
+      auto f = switch_parse(text);
+      benchmark::DoNotOptimize(f);
+    }
+  }
+  counters.finish();
+}
+BENCHMARK(parse_switch_table);
+
+static void parse_from_chars(benchmark::State& state)
+{
+  const auto texts = make_texts();
+  per_op_counters counters{ state, int64_t(texts.size()) };
+  for (auto _ : state)
+  {
+    for (auto const& text : texts)
+    {
+      flags f;
+      auto result = from_chars(text.data(), text.data() + text.size(), f);
+      benchmark::DoNotOptimize(result.ptr);
+      benchmark::DoNotOptimize(f);
+    }
+  }
+  counters.finish();
+}
+BENCHMARK(parse_from_chars);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,123 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// The subset ranges of enum_flags_subsets.h versus the hand-written loops over raw bits they replace:
+/// `(s - mask) & mask` for sub-masks, Gosper's hack for combinations, and `(s - 1) & free` for supersets.
+/// Both sides fold every value into a checksum, which is reported so the two can be compared.
+
+#include "../include/enum_flags_subsets.h"
+#include "instruction_counter.h"
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+using flags = enum_flags<int, std::uint32_t>;
+
+/// 20 flags spread over 32 bits: 1M sub-masks
+constexpr std::uint32_t scattered_mask = 0xD6B5A39Fu;
+/// 24 adjacent flags, of which 12 at a time: 2.7M combinations
+constexpr std::uint32_t adjacent_mask = 0x00FFFFFFu;
+constexpr std::size_t combination_size = 12;
+
+static std::uint64_t mix(std::uint64_t checksum, std::uint32_t bits) { return checksum * 31 + bits; }
+
+template <typename FUNC>
+static void run(benchmark::State& state, int64_t count, FUNC&& func)
+{
+  per_op_counters counters{ state, count };
+  std::uint64_t checksum = 0;
+  for (auto _ : state)
+  {
+    checksum = func();
+    benchmark::DoNotOptimize(checksum);
+  }
+  counters.finish();
+  state.counters["checksum"] = double(checksum % 1000000);
+}
+
+static void subsets_loop(benchmark::State& state)
+{
+  run(state, int64_t(1) << std::popcount(scattered_mask), [] {
+    std::uint64_t checksum = 0;
+    for (std::uint32_t s = 0;; s = (s - scattered_mask) & scattered_mask)
+    {
+      checksum = mix(checksum, s);
+      if (s == scattered_mask) break;
+    }
+    return checksum;
+  });
+}
+BENCHMARK(subsets_loop);
+
+static void subsets_range(benchmark::State& state)
+{
+  run(state, int64_t(1) << std::popcount(scattered_mask), [] {
+    std::uint64_t checksum = 0;
+    for (auto f : subsets(flags::from_bits(scattered_mask)))
+      checksum = mix(checksum, f.bits);
+    return checksum;
+  });
+}
+BENCHMARK(subsets_range);
+
+constexpr int64_t combination_count = 2704156;
+
+static void combinations_gosper(benchmark::State& state)
+{
+  run(state, combination_count, [] {
+    std::uint64_t checksum = 0;
+    for (std::uint32_t s = (1u << combination_size) - 1; s <= adjacent_mask;)
+    {
+      checksum = mix(checksum, s);
+      const auto lowest = s & (0 - s);
+      const auto next = s + lowest;
+      s = next | (((next ^ s) >> 2) >> std::countr_zero(lowest));
+    }
+    return checksum;
+  });
+}
+BENCHMARK(combinations_gosper);
+
+static void combinations_range(benchmark::State& state)
+{
+  run(state, combination_count, [] {
+    std::uint64_t checksum = 0;
+    for (auto f : subsets_of_size(flags::from_bits(adjacent_mask), combination_size))
+      checksum = mix(checksum, f.bits);
+    return checksum;
+  });
+}
+BENCHMARK(combinations_range);
+
+/// Supersets of 4 of the scattered flags: 64K values
+constexpr std::uint32_t superset_base = scattered_mask & 0x0F0F0000u;
+
+static void supersets_loop(benchmark::State& state)
+{
+  constexpr auto free = scattered_mask & ~superset_base;
+  run(state, int64_t(1) << std::popcount(free), [] {
+    std::uint64_t checksum = 0;
+    for (std::uint32_t s = 0;; s = (s - free) & free)
+    {
+      checksum = mix(checksum, s | superset_base);
+      if (s == free) break;
+    }
+    return checksum;
+  });
+}
+BENCHMARK(supersets_loop);
+
+static void supersets_range(benchmark::State& state)
+{
+  run(state, int64_t(1) << std::popcount(scattered_mask & ~superset_base), [] {
+    std::uint64_t checksum = 0;
+    for (auto f : supersets_within(flags::from_bits(superset_base), flags::from_bits(scattered_mask)))
+      checksum = mix(checksum, f.bits);
+    return checksum;
+  });
+}
+BENCHMARK(supersets_range);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,112 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+
+/// One frame of an incremental system over 1M entities: a fraction of them (the argument, in parts per 10000) get a
+/// flag toggled, then every changed entity is visited with its added and removed flags. "full_diff" keeps a copy of
+/// last frame's values and compares every entity; "tracked" uses `tracked_enum_flags_column`.
+/// Both fold the changes into a checksum, and report the number of changed entities of the last frame (the same on
+/// both sides, as toggling the same flags again changes the same entities back).
+
+#include "../include/tracked_enum_flags.h"
+#include "instruction_counter.h"
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+using namespace ghassanpl;
+
+using flags = enum_flags<int, uint32_t>;
+
+constexpr size_t entity_count = size_t(1) << 20;
+
+/// The same mutations for both sides: (entity, flag) pairs
+static std::vector<std::pair<uint32_t, int>> mutations(int64_t per_10000)
+{
+  std::mt19937_64 rng{ uint64_t(per_10000) };
+  std::vector<std::pair<uint32_t, int>> result(size_t(int64_t(entity_count) * per_10000 / 10000));
+  for (auto& m : result) m = { uint32_t(rng() % entity_count), int(rng() % 32) };
+  return result;
+}
+
+static uint64_t mix(uint64_t checksum, size_t index, flags added, flags removed) { return checksum * 31 + index + added.bits * 7 + removed.bits; }
+
+static void full_diff(benchmark::State& state)
+{
+  const auto changes = mutations(state.range(0));
+  std::vector<flags> current(entity_count), previous(entity_count);
+  uint64_t checksum = 0;
+  size_t changed = 0;
+  per_op_counters counters{ state, int64_t(entity_count) };
+  for (auto _ : state)
+  {
+    changed = 0;
+    for (auto [index, flag] : changes) current[index].toggle(flag);
+    for (size_t i = 0; i < entity_count; ++i)
+    {
+      if (current[i] != previous[i])
+      {
+        checksum = mix(checksum, i, flags::from_bits(current[i].bits & ~previous[i].bits), flags::from_bits(previous[i].bits & ~current[i].bits));
+        ++changed;
+      }
+    }
+    previous = current;
+    benchmark::DoNotOptimize(checksum);
+  }
+  counters.finish();
+  state.counters["changed"] = double(changed);
+}
+BENCHMARK(full_diff)->Arg(1)->Arg(10)->Arg(100)->Arg(1000)->Arg(5000);
+
+static void tracked(benchmark::State& state)
+{
+  const auto changes = mutations(state.range(0));
+  tracked_enum_flags_column<int, uint32_t> column(entity_count);
+  column.flush();
+  uint64_t checksum = 0;
+  size_t changed = 0;
+  per_op_counters counters{ state, int64_t(entity_count) };
+  for (auto _ : state)
+  {
+    for (auto [index, flag] : changes) column.toggle(index, flags{ flag });
+    changed = 0;
+    column.for_each_change([&](auto const& change) { checksum = mix(checksum, change.index, change.added, change.removed); ++changed; });
+    column.flush();
+    benchmark::DoNotOptimize(checksum);
+  }
+  counters.finish();
+  state.counters["changed"] = double(changed);
+}
+BENCHMARK(tracked)->Arg(1)->Arg(10)->Arg(100)->Arg(1000)->Arg(5000);
+
+/// The mutations alone, to show what the dirty bit adds to each of them
+static void mutate_plain(benchmark::State& state)
+{
+  const auto changes = mutations(state.range(0));
+  std::vector<flags> current(entity_count);
+  per_op_counters counters{ state, int64_t(changes.size()) };
+  for (auto _ : state)
+  {
+    for (auto [index, flag] : changes) current[index].toggle(flag);
+    benchmark::DoNotOptimize(current.data());
+  }
+  counters.finish();
+}
+BENCHMARK(mutate_plain)->Arg(1000);
+
+static void mutate_tracked(benchmark::State& state)
+{
+  const auto changes = mutations(state.range(0));
+  tracked_enum_flags_column<int, uint32_t> column(entity_count);
+  per_op_counters counters{ state, int64_t(changes.size()) };
+  for (auto _ : state)
+  {
+    for (auto [index, flag] : changes) column.toggle(index, flags{ flag });
+    benchmark::DoNotOptimize(&column);
+  }
+  counters.finish();
+}
+BENCHMARK(mutate_tracked)->Arg(1000);
+
+BENCHMARK_MAIN();
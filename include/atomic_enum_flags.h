@@ -2,13 +2,306 @@
 
 #include "enum_flags.h"
 #include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <thread>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
 
 namespace ghassanpl
 {
-	template <detail::integral_or_enum ENUM, detail::valid_integral VALUE_TYPE = unsigned long long>
-	struct atomic_enum_flags : enum_flags<ENUM, std::atomic<VALUE_TYPE>>
+	namespace detail
 	{
-		using base_type = enum_flags<ENUM, std::atomic<VALUE_TYPE>>;
-		using base_type::base_type;
+		/// The failure order `std::atomic::compare_exchange_*` would derive from a single order
+		constexpr std::memory_order cas_failure_order(std::memory_order order) noexcept
+		{
+			switch (order)
+			{
+			case std::memory_order_acq_rel: return std::memory_order_acquire;
+			case std::memory_order_release: return std::memory_order_relaxed;
+			default: return order;
+			}
+		}
+
+		/// Hint to the CPU that we're in a spin-wait loop
+		inline void cpu_relax() noexcept
+		{
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+			_mm_pause();
+#elif defined(_MSC_VER) && !defined(__clang__) && defined(_M_ARM64)
+			__yield();
+#elif defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+			asm volatile("yield");
+#endif
+		}
+
+		/// Spinning only makes sense if the thread we're waiting for can run at the same time
+		inline int wait_spin_iterations(int max_iterations) noexcept
+		{
+			static const bool can_spin = std::thread::hardware_concurrency() > 1;
+			return can_spin ? max_iterations : 0;
+		}
+	}
+
+	/// A set of flags that can be safely modified from multiple threads.
+	/// Every operation maps to a single atomic instruction (or a CAS loop for conditional transitions),
+	/// and takes an explicit `std::memory_order` that defaults to `seq_cst`, like `std::atomic`.
+	/// Non-atomic operations (e.g. `for_each`) work on a snapshot returned by `load()`.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct atomic_enum_flags
+	{
+		using value_type = VALUE_TYPE;
+		using enum_type = ENUM;
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using self_type = atomic_enum_flags;
+		static constexpr bool enum_type_is_enum = std::is_enum_v<ENUM>;
+		static constexpr bool is_always_lock_free = std::atomic<value_type>::is_always_lock_free;
+
+		std::atomic<value_type> bits = 0;
+
+		constexpr atomic_enum_flags() noexcept = default;
+		atomic_enum_flags(const atomic_enum_flags&) = delete;
+		atomic_enum_flags& operator=(const atomic_enum_flags&) = delete;
+
+		constexpr atomic_enum_flags(flags_type initial) noexcept : bits(initial.bits) {}
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr atomic_enum_flags(ARGS... args) noexcept : bits(flag_bits<VALUE_TYPE>(args...)) {}
+
+		/// Snapshots
+
+		[[nodiscard]]
+		flags_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept { return flags_type::from_bits(bits.load(order)); }
+		void store(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { bits.store(flags.bits, order); }
+		flags_type exchange(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { return flags_type::from_bits(bits.exchange(flags.bits, order)); }
+
+		operator flags_type() const noexcept { return load(); }
+
+		bool compare_exchange_weak(flags_type& expected, flags_type desired, std::memory_order success, std::memory_order failure) noexcept
+		{
+			return bits.compare_exchange_weak(expected.bits, desired.bits, success, failure);
+		}
+		bool compare_exchange_weak(flags_type& expected, flags_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+		{
+			return bits.compare_exchange_weak(expected.bits, desired.bits, order);
+		}
+		bool compare_exchange_strong(flags_type& expected, flags_type desired, std::memory_order success, std::memory_order failure) noexcept
+		{
+			return bits.compare_exchange_strong(expected.bits, desired.bits, success, failure);
+		}
+		bool compare_exchange_strong(flags_type& expected, flags_type desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+		{
+			return bits.compare_exchange_strong(expected.bits, desired.bits, order);
+		}
+
+		/// Read-modify-write operations; these return the flags as they were before the operation
+
+		flags_type fetch_set(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { return flags_type::from_bits(bits.fetch_or(flags.bits, order)); }
+		flags_type fetch_unset(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { return flags_type::from_bits(bits.fetch_and(~flags.bits, order)); }
+		flags_type fetch_toggle(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { return flags_type::from_bits(bits.fetch_xor(flags.bits, order)); }
+		flags_type fetch_set_to(bool val, flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept
+		{
+			return val ? fetch_set(flags, order) : fetch_unset(flags, order);
+		}
+
+		/// Sets `flag` and returns whether it was already set (i.e. `false` if this call is the one that set it)
+		bool test_and_set(flags_type flag, std::memory_order order = std::memory_order_seq_cst) noexcept { return fetch_set(flag, order).are_all_set(flag); }
+		/// Unsets `flag` and returns whether it was set (i.e. `true` if this call is the one that unset it)
+		bool test_and_unset(flags_type flag, std::memory_order order = std::memory_order_seq_cst) noexcept { return fetch_unset(flag, order).are_all_set(flag); }
+
+		self_type& set(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { bits.fetch_or(flags.bits, order); return *this; }
+		self_type& unset(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { bits.fetch_and(~flags.bits, order); return *this; }
+		self_type& toggle(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { bits.fetch_xor(flags.bits, order); return *this; }
+		self_type& set_to(bool val, flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept { fetch_set_to(val, flags, order); return *this; }
+
+		self_type& operator+=(flags_type flags) noexcept { return set(flags); }
+		self_type& operator-=(flags_type flags) noexcept { return unset(flags); }
+
+		/// Conditional transitions
+
+		/// Atomically replaces the flags with `func(current)`, retrying if another thread got in between. Returns the previous flags.
+		template <typename FUNC>
+		flags_type update(FUNC&& func, std::memory_order order = std::memory_order_seq_cst)
+		{
+			auto current = load(detail::cas_failure_order(order));
+			while (!compare_exchange_weak(current, func(current), order, detail::cas_failure_order(order))) {}
+			return current;
+		}
+
+		/// Atomically sets `to_set` and unsets `to_unset`, but only if all of `required` and none of `forbidden` are currently set.
+		/// Returns whether the transition happened. If it didn't, `observed` (if given) receives the flags that blocked it.
+		bool transition(flags_type required, flags_type forbidden, flags_type to_set, flags_type to_unset = {},
+			std::memory_order order = std::memory_order_seq_cst, flags_type* observed = nullptr) noexcept
+		{
+			const auto failure = detail::cas_failure_order(order);
+			auto current = load(failure);
+			do
+			{
+				if (!current.are_all_set(required) || (current.bits & forbidden.bits) != 0)
+				{
+					if (observed) *observed = current;
+					return false;
+				}
+			} while (!compare_exchange_weak(current, flags_type::from_bits((current.bits | to_set.bits) & ~to_unset.bits), order, failure));
+			return true;
+		}
+
+		/// Queries
+
+		[[nodiscard]]
+		bool is_set(flags_type flag, std::memory_order order = std::memory_order_seq_cst) const noexcept { return (bits.load(order) & flag.bits) != 0; }
+		[[nodiscard]]
+		bool are_any_set(flags_type flags, std::memory_order order = std::memory_order_seq_cst) const noexcept { return load(order).are_any_set(flags); }
+		[[nodiscard]]
+		bool are_all_set(flags_type flags, std::memory_order order = std::memory_order_seq_cst) const noexcept { return load(order).are_all_set(flags); }
+
+		template <typename FUNC>
+		auto for_each(FUNC&& callback, std::memory_order order = std::memory_order_seq_cst) const
+		{
+			return load(order).for_each(std::forward<FUNC>(callback));
+		}
+
+		/// Event group operations
+		/// The waits spin for `wait_spin_iterations` (on multi-core machines) before parking the thread with `std::atomic::wait` (a futex on Linux).
+		/// Waiters are only woken by the `*_and_notify` functions or an explicit `notify_all`/`notify_one`.
+
+		static constexpr int wait_spin_iterations = 128;
+
+		/// Sets `flags` and wakes up all waiting threads if that changed anything. Returns the previous flags.
+		flags_type set_and_notify(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept
+		{
+			const auto previous = fetch_set(flags, order);
+			if (!previous.are_all_set(flags))
+				bits.notify_all();
+			return previous;
+		}
+
+		/// Unsets `flags` and wakes up all waiting threads if that changed anything. Returns the previous flags.
+		flags_type unset_and_notify(flags_type flags, std::memory_order order = std::memory_order_seq_cst) noexcept
+		{
+			const auto previous = fetch_unset(flags, order);
+			if ((previous.bits & flags.bits) != 0)
+				bits.notify_all();
+			return previous;
+		}
+
+		void notify_all() noexcept { bits.notify_all(); }
+		void notify_one() noexcept { bits.notify_one(); }
+
+		/// Blocks until any of `mask` is set. If `clear_on_exit` is true, the bits of `mask` are atomically unset
+		/// when the wait is satisfied. Returns the flags as they were when the wait was satisfied (before clearing).
+		flags_type wait_any(flags_type mask, bool clear_on_exit = false, std::memory_order order = std::memory_order_seq_cst) noexcept
+		{
+			return wait_for_condition([mask](flags_type current) { return (current.bits & mask.bits) != 0; }, mask, clear_on_exit, order);
+		}
+
+		/// Blocks until all of `mask` are set. See `wait_any`.
+		flags_type wait_all(flags_type mask, bool clear_on_exit = false, std::memory_order order = std::memory_order_seq_cst) noexcept
+		{
+			return wait_for_condition([mask](flags_type current) { return current.are_all_set(mask); }, mask, clear_on_exit, order);
+		}
+
+		/// Timed variants of the waits return `std::nullopt` on timeout.
+		/// `std::atomic::wait` can't time out, so once spinning is done these back off with exponentially growing sleeps
+		/// (up to `max_timed_wait_sleep`) instead of parking. Prefer the untimed waits on latency-critical paths.
+
+		static constexpr std::chrono::microseconds max_timed_wait_sleep{ 1000 };
+
+		template <typename CLOCK, typename DURATION>
+		std::optional<flags_type> wait_any_until(flags_type mask, std::chrono::time_point<CLOCK, DURATION> const& deadline, bool clear_on_exit = false, std::memory_order order = std::memory_order_seq_cst)
+		{
+			return wait_for_condition_until([mask](flags_type current) { return (current.bits & mask.bits) != 0; }, mask, deadline, clear_on_exit, order);
+		}
+
+		template <typename CLOCK, typename DURATION>
+		std::optional<flags_type> wait_all_until(flags_type mask, std::chrono::time_point<CLOCK, DURATION> const& deadline, bool clear_on_exit = false, std::memory_order order = std::memory_order_seq_cst)
+		{
+			return wait_for_condition_until([mask](flags_type current) { return current.are_all_set(mask); }, mask, deadline, clear_on_exit, order);
+		}
+
+		template <typename REP, typename PERIOD>
+		std::optional<flags_type> wait_any_for(flags_type mask, std::chrono::duration<REP, PERIOD> const& timeout, bool clear_on_exit = false, std::memory_order order = std::memory_order_seq_cst)
+		{
+			return wait_any_until(mask, std::chrono::steady_clock::now() + timeout, clear_on_exit, order);
+		}
+
+		template <typename REP, typename PERIOD>
+		std::optional<flags_type> wait_all_for(flags_type mask, std::chrono::duration<REP, PERIOD> const& timeout, bool clear_on_exit = false, std::memory_order order = std::memory_order_seq_cst)
+		{
+			return wait_all_until(mask, std::chrono::steady_clock::now() + timeout, clear_on_exit, order);
+		}
+
+	private:
+
+		/// If `current` satisfies the wait, tries to clear `mask` (when asked to). Returns false if another thread
+		/// changed the flags in between, in which case `current` is reloaded and the condition must be rechecked.
+		bool try_consume(flags_type& current, flags_type mask, bool clear_on_exit, std::memory_order order) noexcept
+		{
+			if (!clear_on_exit)
+				return true;
+			return compare_exchange_weak(current, flags_type::from_bits(current.bits & ~mask.bits), order, detail::cas_failure_order(order));
+		}
+
+		template <typename PRED>
+		flags_type wait_for_condition(PRED&& satisfied, flags_type mask, bool clear_on_exit, std::memory_order order) noexcept
+		{
+			const auto load_order = detail::cas_failure_order(order);
+			const auto spin_iterations = detail::wait_spin_iterations(wait_spin_iterations);
+			auto current = load(load_order);
+			for (;;)
+			{
+				for (int i = 0; i < spin_iterations && !satisfied(current); ++i)
+				{
+					detail::cpu_relax();
+					current = load(load_order);
+				}
+
+				if (satisfied(current))
+				{
+					if (try_consume(current, mask, clear_on_exit, order))
+						return current;
+					continue;
+				}
+
+				bits.wait(current.bits, load_order);
+				current = load(load_order);
+			}
+		}
+
+		template <typename PRED, typename CLOCK, typename DURATION>
+		std::optional<flags_type> wait_for_condition_until(PRED&& satisfied, flags_type mask, std::chrono::time_point<CLOCK, DURATION> const& deadline, bool clear_on_exit, std::memory_order order)
+		{
+			const auto load_order = detail::cas_failure_order(order);
+			auto current = load(load_order);
+			const auto spin_iterations = detail::wait_spin_iterations(wait_spin_iterations);
+			auto sleep_time = std::chrono::microseconds{ 1 };
+			for (int attempt = 0;; ++attempt)
+			{
+				if (satisfied(current))
+				{
+					if (try_consume(current, mask, clear_on_exit, order))
+						return current;
+					continue;
+				}
+
+				const auto now = CLOCK::now();
+				if (now >= deadline)
+					return std::nullopt;
+
+				if (attempt < spin_iterations)
+					detail::cpu_relax();
+				else
+				{
+					const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now);
+					std::this_thread::sleep_for(std::min(sleep_time, remaining + std::chrono::microseconds{ 1 }));
+					sleep_time = std::min(sleep_time * 2, max_timed_wait_sleep);
+				}
+				current = load(load_order);
+			}
+		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,209 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "wide_enum_flags.h"
+#include "atomic_enum_flags.h"
+#include <array>
+#include <atomic>
+#include <optional>
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		/// Not `std::hardware_destructive_interference_size`, which GCC warns about using in headers, as its value
+		/// depends on the compiler flags
+		inline constexpr std::size_t cache_line_size = 64;
+	}
+
+	/// A `wide_enum_flags` that can be modified and read from multiple threads without a lock.
+	///
+	/// Writes are atomic read-modify-writes of only the words they touch (a single flag is one `fetch_or`,
+	/// `fetch_and` or `fetch_xor`), bracketed by two atomic adds on a sequence counter: its low half counts the writes
+	/// in progress and its high half the finished ones. `snapshot()` is a seqlock read: it copies the words between
+	/// two reads of the counter, and retries if a write was in progress or finished in between, so it never returns
+	/// a mix of two writes. Readers never write shared memory, so any number of them can read at once without
+	/// contending with each other. Queries of a single flag read just its word.
+	///
+	/// The counter and the words are each on their own cache lines, so writes to the counter don't evict the words
+	/// from readers' caches, and nothing else shares either line.
+	template <detail::integral_or_enum ENUM, std::size_t BIT_COUNT>
+	requires (BIT_COUNT > 0)
+	struct atomic_wide_enum_flags
+	{
+		using flags_type = wide_enum_flags<ENUM, BIT_COUNT>;
+		using word_type = typename flags_type::word_type;
+		using enum_type = ENUM;
+		using self_type = atomic_wide_enum_flags;
+		static constexpr std::size_t word_bits = flags_type::word_bits;
+		static constexpr std::size_t word_count = flags_type::word_count;
+		static constexpr bool is_always_lock_free = std::atomic<word_type>::is_always_lock_free && std::atomic<std::uint64_t>::is_always_lock_free;
+
+		constexpr atomic_wide_enum_flags() noexcept = default;
+		atomic_wide_enum_flags(const atomic_wide_enum_flags&) = delete;
+		atomic_wide_enum_flags& operator=(const atomic_wide_enum_flags&) = delete;
+
+		atomic_wide_enum_flags(flags_type const& initial) noexcept
+		{
+			for (std::size_t i = 0; i < word_count; ++i)
+				words[i].store(initial.bits[i], std::memory_order_relaxed);
+		}
+
+		template <detail::integral_or_enum... ARGS>
+		atomic_wide_enum_flags(ARGS... args) noexcept : atomic_wide_enum_flags(flags_type{ args... }) {}
+
+		/// Snapshots
+
+		/// A single attempt at a consistent read; empty if a write was in progress or finished during it
+		[[nodiscard]]
+		std::optional<flags_type> try_snapshot() const noexcept
+		{
+			const auto before = sequence.load(std::memory_order_acquire);
+			if (writes_in_progress(before))
+				return std::nullopt;
+			flags_type result;
+			for (std::size_t i = 0; i < word_count; ++i)
+				result.bits[i] = words[i].load(std::memory_order_relaxed);
+			/// Orders the word loads before the second counter load, so if any of them saw a write, the counter shows it
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence.load(std::memory_order_relaxed) != before)
+				return std::nullopt;
+			return result;
+		}
+
+		/// The flags as they were at some point between the call and the return, retrying while writes get in the way
+		[[nodiscard]]
+		flags_type snapshot() const noexcept
+		{
+			for (;;)
+			{
+				if (auto result = try_snapshot())
+					return *result;
+				detail::cpu_relax();
+			}
+		}
+
+		[[nodiscard]]
+		flags_type load() const noexcept { return snapshot(); }
+		operator flags_type() const noexcept { return snapshot(); }
+
+		/// Replaces all words, as one write
+		void store(flags_type const& flags) noexcept
+		{
+			begin_write();
+			for (std::size_t i = 0; i < word_count; ++i)
+				words[i].store(flags.bits[i], std::memory_order_relaxed);
+			end_write();
+		}
+
+		/// The number of writes finished so far (modulo 2^32); equal values around a read mean no write happened in between
+		[[nodiscard]]
+		std::uint32_t version() const noexcept { return static_cast<std::uint32_t>(sequence.load(std::memory_order_acquire) >> 32); }
+
+		/// Single-flag writes: one atomic operation on the flag's word
+
+		/// Sets `flag` and returns whether it was already set (i.e. `false` if this call is the one that set it)
+		template <detail::integral_or_enum T>
+		bool test_and_set(T flag) noexcept { return write_word(word_index(flag), [&](auto& word) { return word.fetch_or(word_bit(flag), std::memory_order_relaxed); }) & word_bit(flag); }
+		/// Unsets `flag` and returns whether it was set (i.e. `true` if this call is the one that unset it)
+		template <detail::integral_or_enum T>
+		bool test_and_unset(T flag) noexcept { return write_word(word_index(flag), [&](auto& word) { return word.fetch_and(~word_bit(flag), std::memory_order_relaxed); }) & word_bit(flag); }
+		/// Toggles `flag` and returns whether it was set before
+		template <detail::integral_or_enum T>
+		bool test_and_toggle(T flag) noexcept { return write_word(word_index(flag), [&](auto& word) { return word.fetch_xor(word_bit(flag), std::memory_order_relaxed); }) & word_bit(flag); }
+
+		/// The variadic mutators apply all of their flags as one write
+
+		template <detail::integral_or_enum... ARGS>
+		self_type& set(ARGS... args) noexcept { begin_write(); (words[word_index(args)].fetch_or(word_bit(args), std::memory_order_relaxed), ...); end_write(); return *this; }
+		template <detail::integral_or_enum... ARGS>
+		self_type& unset(ARGS... args) noexcept { begin_write(); (words[word_index(args)].fetch_and(~word_bit(args), std::memory_order_relaxed), ...); end_write(); return *this; }
+		template <detail::integral_or_enum... ARGS>
+		self_type& toggle(ARGS... args) noexcept { begin_write(); (words[word_index(args)].fetch_xor(word_bit(args), std::memory_order_relaxed), ...); end_write(); return *this; }
+		template <detail::integral_or_enum... ARGS>
+		self_type& set_to(bool val, ARGS... args) noexcept { return val ? set(args...) : unset(args...); }
+
+		/// Whole-set writes only touch the words in which `flags` has bits
+
+		self_type& set(flags_type const& flags) noexcept { return write_words(flags, [](auto& word, word_type bits) { word.fetch_or(bits, std::memory_order_relaxed); }); }
+		self_type& unset(flags_type const& flags) noexcept { return write_words(flags, [](auto& word, word_type bits) { word.fetch_and(~bits, std::memory_order_relaxed); }); }
+		self_type& toggle(flags_type const& flags) noexcept { return write_words(flags, [](auto& word, word_type bits) { word.fetch_xor(bits, std::memory_order_relaxed); }); }
+		self_type& set_to(bool val, flags_type const& flags) noexcept { return val ? set(flags) : unset(flags); }
+
+		template <detail::integral_or_enum T>
+		self_type& operator+=(T flag) noexcept { return set(flag); }
+		template <detail::integral_or_enum T>
+		self_type& operator-=(T flag) noexcept { return unset(flag); }
+		self_type& operator+=(flags_type const& flags) noexcept { return set(flags); }
+		self_type& operator-=(flags_type const& flags) noexcept { return unset(flags); }
+
+		/// Queries
+
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		bool is_set(T flag) const noexcept { return (words[word_index(flag)].load(std::memory_order_acquire) & word_bit(flag)) != 0; }
+
+		template <detail::integral_or_enum... ARGS>
+		[[nodiscard]]
+		bool are_any_set(ARGS... args) const noexcept { return snapshot().are_any_set(args...); }
+		template <detail::integral_or_enum... ARGS>
+		[[nodiscard]]
+		bool are_all_set(ARGS... args) const noexcept { return snapshot().are_all_set(args...); }
+		[[nodiscard]]
+		bool are_any_set(flags_type const& flags) const noexcept { return snapshot().are_any_set(flags); }
+		[[nodiscard]]
+		bool are_all_set(flags_type const& flags) const noexcept { return snapshot().are_all_set(flags); }
+
+		template <typename FUNC>
+		auto for_each(FUNC&& callback) const
+		{
+			return snapshot().for_each(std::forward<FUNC>(callback));
+		}
+
+	private:
+
+		/// Low half: writes in progress; high half: writes finished
+		static constexpr std::uint64_t write_started = 1;
+		static constexpr std::uint64_t write_finished = (std::uint64_t{ 1 } << 32) - 1;
+
+		static constexpr bool writes_in_progress(std::uint64_t sequence_value) noexcept { return static_cast<std::uint32_t>(sequence_value) != 0; }
+
+		alignas(detail::cache_line_size) std::atomic<std::uint64_t> sequence{ 0 };
+		alignas(detail::cache_line_size) std::array<std::atomic<word_type>, word_count> words{};
+
+		void begin_write() noexcept
+		{
+			sequence.fetch_add(write_started, std::memory_order_relaxed);
+			/// Orders the counter increment before the word writes, for readers that see any of them
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+		void end_write() noexcept { sequence.fetch_add(write_finished, std::memory_order_release); }
+
+		template <typename FUNC>
+		word_type write_word(std::size_t index, FUNC&& op) noexcept
+		{
+			begin_write();
+			const auto previous = op(words[index]);
+			end_write();
+			return previous;
+		}
+
+		template <typename FUNC>
+		self_type& write_words(flags_type const& flags, FUNC&& op) noexcept
+		{
+			begin_write();
+			for (std::size_t i = 0; i < word_count; ++i)
+				if (flags.bits[i]) op(words[i], flags.bits[i]);
+			end_write();
+			return *this;
+		}
+
+		template <detail::integral_or_enum T>
+		static constexpr std::size_t word_index(T flag) noexcept { return static_cast<std::size_t>(detail::to_underlying_type(flag)) / word_bits; }
+		template <detail::integral_or_enum T>
+		static constexpr word_type word_bit(T flag) noexcept { return word_type{ 1 } << (static_cast<std::size_t>(detail::to_underlying_type(flag)) % word_bits); }
+	};
+}
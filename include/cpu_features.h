@@ -0,0 +1,75 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+/// Runtime CPU feature detection used by the bulk kernels to pick an implementation.
+/// Kernels that need a specific ISA are compiled with `GHASSANPL_TARGET(...)` so the rest of the program
+/// doesn't need to be built with e.g. `-mavx2`.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GHASSANPL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GHASSANPL_TARGET(...) __attribute__((target(__VA_ARGS__)))
+#else
+/// MSVC doesn't need target attributes to emit intrinsics for other ISAs
+#define GHASSANPL_TARGET(...)
+#endif
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		struct cpu_features
+		{
+			bool avx2 = false;
+			bool bmi2 = false;
+			bool avx512f = false;
+			bool avx512bw = false;
+		};
+
+		inline cpu_features query_cpu_features() noexcept
+		{
+			cpu_features result;
+#if defined(GHASSANPL_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+			int regs[4]{};
+			__cpuid(regs, 0);
+			if (regs[0] < 7) return result;
+			__cpuid(regs, 1);
+			const bool osxsave = (regs[2] & (1 << 27)) != 0;
+			if (!osxsave) return result;
+			const auto xcr0 = _xgetbv(0);
+			const bool os_avx = (xcr0 & 0x6) == 0x6;
+			const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+			__cpuidex(regs, 7, 0);
+			result.bmi2 = (regs[1] & (1 << 8)) != 0;
+			result.avx2 = os_avx && (regs[1] & (1 << 5)) != 0;
+			result.avx512f = os_avx512 && (regs[1] & (1 << 16)) != 0;
+			result.avx512bw = os_avx512 && (regs[1] & (1 << 30)) != 0;
+#else
+			__builtin_cpu_init();
+			result.avx2 = __builtin_cpu_supports("avx2");
+			result.bmi2 = __builtin_cpu_supports("bmi2");
+			result.avx512f = __builtin_cpu_supports("avx512f");
+			result.avx512bw = __builtin_cpu_supports("avx512bw");
+#endif
+#endif
+			return result;
+		}
+
+		/// Detected once, on first use
+		inline cpu_features const& get_cpu_features() noexcept
+		{
+			static const cpu_features features = query_cpu_features();
+			return features;
+		}
+	}
+}
@@ -6,6 +6,10 @@
 
 #include "flag_bits.h"
 #include <bit>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <ranges>
 
 namespace ghassanpl
 {
@@ -38,8 +42,15 @@ namespace ghassanpl
 			return ret;
 		}
 
+		/// If `ENUM` declares its last enumerator (see `enum_flags_traits`), only the bits up to and including it are set
 		[[nodiscard]]
-		constexpr static self_type all() noexcept { return self_type::from_bits(~VALUE_TYPE{ 0 }); }
+		constexpr static self_type all() noexcept
+		{
+			if constexpr (detail::has_declared_last_flag<ENUM>)
+				return self_type::all(enum_flags_traits<ENUM>::last);
+			else
+				return self_type::from_bits(~VALUE_TYPE{ 0 });
+		}
 
 		template <detail::integral_or_enum T>
 		[[nodiscard]]
@@ -50,7 +61,11 @@ namespace ghassanpl
 
 		template <detail::integral_or_enum T>
 		[[nodiscard]]
-		constexpr bool is_set(T flag) const noexcept { return (bits & flag_bits<VALUE_TYPE>(flag)) != 0; }
+		constexpr bool is_set(T flag) const noexcept
+		{
+			detail::record_flags(flag_operation_kind::test, flag);
+			return (bits & flag_bits<VALUE_TYPE>(flag)) != 0;
+		}
 
 		template <detail::integral_or_enum... ARGS>
 		[[nodiscard]]
@@ -61,7 +76,11 @@ namespace ghassanpl
 
 		/// are_any_set({}) is true, which is correct or not, depending on whether you want it to be correct or not :P
 		[[nodiscard]]
-		constexpr bool are_any_set(self_type other) const noexcept { return other.bits == 0 /* empty set */ || (bits & other.bits) != 0; }
+		constexpr bool are_any_set(self_type other) const noexcept
+		{
+			detail::record_flag_mask<ENUM>(flag_operation_kind::test, other.bits);
+			return other.bits == 0 /* empty set */ || (bits & other.bits) != 0;
+		}
 
 		template <detail::integral_or_enum... ARGS>
 		[[nodiscard]]
@@ -71,33 +90,39 @@ namespace ghassanpl
 		}
 
 		[[nodiscard]]
-		constexpr bool are_all_set(self_type other) const noexcept { return (bits & other.bits) == other.bits; }
+		constexpr bool are_all_set(self_type other) const noexcept
+		{
+			detail::record_flag_mask<ENUM>(flag_operation_kind::test, other.bits);
+			return (bits & other.bits) == other.bits;
+		}
 		
 		constexpr explicit operator bool() const noexcept { return bits != 0; }
 		[[nodiscard]]
 		constexpr enum_type to_enum_type() const noexcept { return (enum_type)bits; }
 
 		template <detail::integral_or_enum... ARGS>
-		constexpr self_type& set(ARGS... args) noexcept { bits |= flag_bits<VALUE_TYPE>(args...); return *this; }
-		constexpr self_type& set(self_type other) noexcept { bits |= other.bits; return *this; }
+		constexpr self_type& set(ARGS... args) noexcept { detail::record_flags(flag_operation_kind::set, args...); bits |= flag_bits<VALUE_TYPE>(args...); return *this; }
+		constexpr self_type& set(self_type other) noexcept { detail::record_flag_mask<ENUM>(flag_operation_kind::set, other.bits); bits |= other.bits; return *this; }
 
 		template <detail::integral_or_enum... ARGS>
-		constexpr self_type& unset(ARGS... args) noexcept { bits &= ~ flag_bits<VALUE_TYPE>(args...); return *this; }
-		constexpr self_type& unset(self_type other) noexcept { bits &= ~other.bits; return *this; }
+		constexpr self_type& unset(ARGS... args) noexcept { detail::record_flags(flag_operation_kind::unset, args...); bits &= ~ flag_bits<VALUE_TYPE>(args...); return *this; }
+		constexpr self_type& unset(self_type other) noexcept { detail::record_flag_mask<ENUM>(flag_operation_kind::unset, other.bits); bits &= ~other.bits; return *this; }
 
 		template <detail::integral_or_enum... ARGS>
-		constexpr self_type& toggle(ARGS... args) noexcept { bits ^= flag_bits<VALUE_TYPE>(args...); return *this; }
-		constexpr self_type& toggle(self_type other) noexcept { bits ^= other.bits; return *this; }
+		constexpr self_type& toggle(ARGS... args) noexcept { detail::record_flags(flag_operation_kind::toggle, args...); bits ^= flag_bits<VALUE_TYPE>(args...); return *this; }
+		constexpr self_type& toggle(self_type other) noexcept { detail::record_flag_mask<ENUM>(flag_operation_kind::toggle, other.bits); bits ^= other.bits; return *this; }
 
 		template <detail::integral_or_enum... ARGS>
 		constexpr self_type& set_to(bool val, ARGS... args) noexcept
 		{
+			detail::record_flags(val ? flag_operation_kind::set : flag_operation_kind::unset, args...);
 			if (val) bits |= flag_bits<VALUE_TYPE>(args...); else bits &= ~flag_bits<VALUE_TYPE>(args...);
 			return *this;
 		}
 
 		constexpr self_type& set_to(bool val, self_type other) noexcept
 		{
+			detail::record_flag_mask<ENUM>(val ? flag_operation_kind::set : flag_operation_kind::unset, other.bits);
 			if (val) bits |= other.bits; else bits &= ~other.bits;
 			return *this;
 		}
@@ -110,42 +135,144 @@ namespace ghassanpl
 		constexpr self_type operator-(T flag) const noexcept { return self_type::from_bits(bits & ~ flag_bits<VALUE_TYPE>(flag)); }
 
 		template <detail::integral_or_enum T>
-		constexpr self_type& operator+=(T flag) noexcept { bits |= flag_bits<VALUE_TYPE>(flag); return *this; }
+		constexpr self_type& operator+=(T flag) noexcept { detail::record_flags(flag_operation_kind::set, flag); bits |= flag_bits<VALUE_TYPE>(flag); return *this; }
 		template <detail::integral_or_enum T>
-		constexpr self_type& operator-=(T flag) noexcept { bits &= ~ flag_bits<VALUE_TYPE>(flag); return *this; }
+		constexpr self_type& operator-=(T flag) noexcept { detail::record_flags(flag_operation_kind::unset, flag); bits &= ~ flag_bits<VALUE_TYPE>(flag); return *this; }
 
-		constexpr self_type& operator+=(self_type flag) noexcept { bits |= flag.bits; return *this; }
-		constexpr self_type& operator-=(self_type flag) noexcept { bits &= ~flag.bits; return *this; }
+		constexpr self_type& operator+=(self_type flag) noexcept { detail::record_flag_mask<ENUM>(flag_operation_kind::set, flag.bits); bits |= flag.bits; return *this; }
+		constexpr self_type& operator-=(self_type flag) noexcept { detail::record_flag_mask<ENUM>(flag_operation_kind::unset, flag.bits); bits &= ~flag.bits; return *this; }
 
 		constexpr bool operator==(self_type other) const noexcept { return bits == other.bits; }
 		constexpr bool operator!=(self_type other) const noexcept { return bits != other.bits; }
 
-		/// TODO: begin() and end(), so we can iterate over the set bits
-		/// TODO: See if this would be faster with a simple loop
+		/// Iterates over the set flags, from lowest to highest (or highest to lowest if `REVERSE`)
+		/// Incrementing clears the lowest (highest) remaining bit, dereferencing is a `countr_zero` (`bit_width`),
+		/// and decrementing restores the highest (lowest) already visited bit.
+		template <bool REVERSE>
+		struct bit_iterator
+		{
+			using bitset_type = std::make_unsigned_t<typename self_type::value_type>;
+			using iterator_concept = std::bidirectional_iterator_tag;
+			using iterator_category = std::bidirectional_iterator_tag;
+			using value_type = enum_type;
+			using difference_type = std::ptrdiff_t;
+			using reference = enum_type;
+			using pointer = void;
 
+			constexpr bit_iterator() noexcept = default;
+			constexpr bit_iterator(bitset_type all, bitset_type remaining) noexcept : all_bits(all), remaining_bits(remaining) {}
+
+			[[nodiscard]]
+			constexpr enum_type operator*() const noexcept
+			{
+				if constexpr (REVERSE)
+					return (enum_type)(std::bit_width(remaining_bits) - 1);
+				else
+					return (enum_type)std::countr_zero(remaining_bits);
+			}
+
+			constexpr bit_iterator& operator++() noexcept
+			{
+				if constexpr (REVERSE)
+					remaining_bits ^= highest(remaining_bits);
+				else
+					remaining_bits = static_cast<bitset_type>(remaining_bits & (remaining_bits - 1));
+				return *this;
+			}
+			constexpr bit_iterator operator++(int) noexcept { auto copy = *this; ++*this; return copy; }
+
+			constexpr bit_iterator& operator--() noexcept
+			{
+				const auto visited = static_cast<bitset_type>(all_bits & ~remaining_bits);
+				if constexpr (REVERSE)
+					remaining_bits |= lowest(visited);
+				else
+					remaining_bits |= highest(visited);
+				return *this;
+			}
+			constexpr bit_iterator operator--(int) noexcept { auto copy = *this; --*this; return copy; }
+
+			/// Only iterators into the same set of flags can be compared
+			constexpr bool operator==(bit_iterator const& other) const noexcept { return remaining_bits == other.remaining_bits; }
+
+		private:
+
+			static constexpr bitset_type lowest(bitset_type bitset) noexcept { return static_cast<bitset_type>(bitset & (0u - bitset)); }
+			static constexpr bitset_type highest(bitset_type bitset) noexcept { return static_cast<bitset_type>(bitset_type{ 1 } << (std::bit_width(bitset) - 1)); }
+
+			bitset_type all_bits = 0;
+			bitset_type remaining_bits = 0;
+		};
+
+		using iterator = bit_iterator<false>;
+		using const_iterator = iterator;
+		using reverse_iterator = bit_iterator<true>;
+		using const_reverse_iterator = reverse_iterator;
+
+		[[nodiscard]]
+		constexpr iterator begin() const noexcept { return iterator{ static_cast<typename iterator::bitset_type>(bits), static_cast<typename iterator::bitset_type>(bits) }; }
+		[[nodiscard]]
+		constexpr iterator end() const noexcept { return iterator{ static_cast<typename iterator::bitset_type>(bits), 0 }; }
+		[[nodiscard]]
+		constexpr reverse_iterator rbegin() const noexcept { return reverse_iterator{ static_cast<typename iterator::bitset_type>(bits), static_cast<typename iterator::bitset_type>(bits) }; }
+		[[nodiscard]]
+		constexpr reverse_iterator rend() const noexcept { return reverse_iterator{ static_cast<typename iterator::bitset_type>(bits), 0 }; }
+
+		/// The callback can return a value convertible to bool, in which case iteration stops at (and returns) the first truthy result.
+		/// Uses the same clear-lowest-bit loop as `iterator`; see benchmarks/iteration_benchmark.cpp for the alternatives.
 		template <typename FUNC>
 		constexpr auto for_each(FUNC&& callback) const
 		{
-			//using return_type = decltype(callback(enum_type{}));
 			using return_type = std::invoke_result_t<FUNC, enum_type>;
 			using bitset_type = std::make_unsigned_t<value_type>;
 			auto bitset = static_cast<bitset_type>(bits);
 			while (bitset)
 			{
-#pragma warning(suppress: 4146)
-				const auto t = static_cast<bitset_type>(bitset & -bitset);
-				const auto r = std::countr_zero(t);
+				const auto r = std::countr_zero(bitset);
 				if constexpr (std::is_convertible_v<return_type, bool>)
 				{
 					if (auto ret = callback((enum_type)r)) return ret;
 				}
 				else
 					callback((enum_type)r);
-				bitset ^= t;
+				bitset = static_cast<bitset_type>(bitset & (bitset - 1));
 			}
 			if constexpr (std::is_convertible_v<return_type, bool>)
 				return return_type{};
 		}
 	};
 
-}
\ No newline at end of file
+	/// `enum_flags` with the smallest value type that holds all the flags of `ENUM` (which must specialize `enum_flags_traits`)
+	template <detail::integral_or_enum ENUM>
+	requires detail::has_declared_last_flag<ENUM>
+	using enum_flags_for = enum_flags<ENUM, flag_value_type_for<ENUM>>;
+
+	namespace detail
+	{
+		/// Two rounds of multiply and fold, so that every input bit reaches the low bits of the result (which is what
+		/// power-of-two and prime-modulo tables use). One round leaves single-flag values clustered.
+		constexpr std::size_t hash_flag_bits(std::uint64_t bits) noexcept
+		{
+			bits *= 0x9E3779B97F4A7C15ull;
+			bits ^= bits >> 32;
+			bits *= 0x9E3779B97F4A7C15ull;
+			return static_cast<std::size_t>(bits ^ (bits >> 32));
+		}
+	}
+
+}
+
+/// Iterators don't refer to the flags object, so they can outlive it
+template <ghassanpl::detail::integral_or_enum ENUM, ghassanpl::detail::valid_integral VALUE_TYPE>
+inline constexpr bool std::ranges::enable_borrowed_range<ghassanpl::enum_flags<ENUM, VALUE_TYPE>> = true;
+
+/// Only for the builtin value types, whose bits fit in 64
+template <ghassanpl::detail::integral_or_enum ENUM, ghassanpl::detail::bit_integral VALUE_TYPE>
+struct std::hash<ghassanpl::enum_flags<ENUM, VALUE_TYPE>>
+{
+	[[nodiscard]]
+	constexpr std::size_t operator()(ghassanpl::enum_flags<ENUM, VALUE_TYPE> const& flags) const noexcept
+	{
+		return ghassanpl::detail::hash_flag_bits(static_cast<std::uint64_t>(static_cast<std::make_unsigned_t<VALUE_TYPE>>(flags.bits)));
+	}
+};
@@ -0,0 +1,325 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags_column.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/// Bulk algorithms over spans of `enum_flags`: reductions, counting, in-place updates and partitioning.
+/// Every algorithm has an overload taking a thread count, which splits large spans into contiguous chunks run on
+/// their own threads (the calling thread takes the first chunk), like `count_each_flag`.
+
+namespace ghassanpl
+{
+	/// Elements per thread below which the parallel overloads don't bother splitting the work
+	inline constexpr std::size_t flag_algorithms_min_chunk = std::size_t{ 1 } << 18;
+
+	namespace detail
+	{
+		/// Splits [0, count) into up to `thread_count` chunks of at least `min_chunk` elements, and calls
+		/// `func(chunk_index, first, size)` for each of them, the first one on the calling thread.
+		/// Returns the number of chunks.
+		template <typename FUNC>
+		std::size_t for_each_chunk(std::size_t count, unsigned thread_count, std::size_t min_chunk, FUNC&& func)
+		{
+			const auto chunks = std::max<std::size_t>(1, std::min<std::size_t>(thread_count, count / std::max<std::size_t>(min_chunk, 1)));
+			const auto chunk_size = (count + chunks - 1) / chunks;
+			std::vector<std::thread> threads;
+			threads.reserve(chunks - 1);
+			for (std::size_t c = 1; c < chunks; ++c)
+			{
+				const auto first = std::min(c * chunk_size, count);
+				threads.emplace_back([&func, c, first, size = std::min(chunk_size, count - first)] { func(c, first, size); });
+			}
+			func(std::size_t{ 0 }, std::size_t{ 0 }, std::min(chunk_size, count));
+			for (auto& thread : threads) thread.join();
+			return chunks;
+		}
+
+		enum class flag_update { set, unset, toggle };
+
+		/// Four accumulators, so the loop isn't bound by the latency of a single dependency chain
+		template <bool OR, typename U>
+		U reduce_scalar(U const* data, std::size_t count) noexcept
+		{
+			constexpr U identity = OR ? U{ 0 } : static_cast<U>(~U{ 0 });
+			U acc[4] = { identity, identity, identity, identity };
+			std::size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+				for (std::size_t k = 0; k < 4; ++k)
+					acc[k] = OR ? static_cast<U>(acc[k] | data[i + k]) : static_cast<U>(acc[k] & data[i + k]);
+			for (; i < count; ++i)
+				acc[0] = OR ? static_cast<U>(acc[0] | data[i]) : static_cast<U>(acc[0] & data[i]);
+			return OR ? static_cast<U>(acc[0] | acc[1] | acc[2] | acc[3]) : static_cast<U>(acc[0] & acc[1] & acc[2] & acc[3]);
+		}
+
+		template <flag_update OP, typename U>
+		void update_scalar(U* data, std::size_t count, U mask) noexcept
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if constexpr (OP == flag_update::set) data[i] = static_cast<U>(data[i] | mask);
+				else if constexpr (OP == flag_update::unset) data[i] = static_cast<U>(data[i] & ~mask);
+				else data[i] = static_cast<U>(data[i] ^ mask);
+			}
+		}
+
+		template <typename FLAGS, typename PREDICATE>
+		std::size_t count_if_scalar(FLAGS const* data, std::size_t count, PREDICATE& predicate)
+		{
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < count; ++i)
+				found += static_cast<bool>(predicate(data[i]));
+			return found;
+		}
+
+		/// Branchless: every element is swapped into the output position, but the position only advances on a match
+		template <typename U>
+		std::size_t partition_scalar(U* data, std::size_t count, U mask) noexcept
+		{
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const U v = data[i];
+				data[i] = data[found];
+				data[found] = v;
+				found += (v & mask) == mask;
+			}
+			return found;
+		}
+
+#if defined(GHASSANPL_X86)
+		template <bool OR, typename U>
+		GHASSANPL_TARGET("avx2") U reduce_avx2(U const* data, std::size_t count) noexcept
+		{
+			constexpr std::size_t per_vector = 32 / sizeof(U);
+			const auto identity = OR ? _mm256_setzero_si256() : _mm256_set1_epi32(-1);
+			__m256i acc[4] = { identity, identity, identity, identity };
+			std::size_t i = 0;
+			for (; i + 4 * per_vector <= count; i += 4 * per_vector)
+			{
+				for (std::size_t k = 0; k < 4; ++k)
+				{
+					const auto x = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i + k * per_vector));
+					acc[k] = OR ? _mm256_or_si256(acc[k], x) : _mm256_and_si256(acc[k], x);
+				}
+			}
+			const auto v = OR ? _mm256_or_si256(_mm256_or_si256(acc[0], acc[1]), _mm256_or_si256(acc[2], acc[3]))
+				: _mm256_and_si256(_mm256_and_si256(acc[0], acc[1]), _mm256_and_si256(acc[2], acc[3]));
+			alignas(32) U lanes[per_vector];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+			const auto tail = reduce_scalar<OR>(data + i, count - i);
+			return OR ? static_cast<U>(reduce_scalar<OR>(lanes, per_vector) | tail) : static_cast<U>(reduce_scalar<OR>(lanes, per_vector) & tail);
+		}
+
+		template <flag_update OP, typename U>
+		GHASSANPL_TARGET("avx2") void update_avx2(U* data, std::size_t count, U mask) noexcept
+		{
+			constexpr std::size_t per_vector = 32 / sizeof(U);
+			const auto vmask = avx2_broadcast(mask);
+			std::size_t i = 0;
+			for (; i + per_vector <= count; i += per_vector)
+			{
+				const auto p = reinterpret_cast<__m256i*>(data + i);
+				const auto x = _mm256_loadu_si256(p);
+				if constexpr (OP == flag_update::set) _mm256_storeu_si256(p, _mm256_or_si256(x, vmask));
+				else if constexpr (OP == flag_update::unset) _mm256_storeu_si256(p, _mm256_andnot_si256(vmask, x));
+				else _mm256_storeu_si256(p, _mm256_xor_si256(x, vmask));
+			}
+			update_scalar<OP>(data + i, count - i, mask);
+		}
+
+		/// The predicate can be anything, so there are no intrinsics here; but the loop is compiled for AVX2 too, and
+		/// vectorizes when the predicate inlines to branchless bit tests (as `flag_predicate`s do)
+		template <typename FLAGS, typename PREDICATE>
+		GHASSANPL_TARGET("avx2") std::size_t count_if_avx2(FLAGS const* data, std::size_t count, PREDICATE& predicate)
+		{
+			return count_if_scalar(data, count, predicate);
+		}
+#endif
+
+		template <bool OR, typename U>
+		U reduce(U const* data, std::size_t count) noexcept
+		{
+#if defined(GHASSANPL_X86)
+			if (get_cpu_features().avx2) return reduce_avx2<OR>(data, count);
+#endif
+			return reduce_scalar<OR>(data, count);
+		}
+
+		template <flag_update OP, typename U>
+		void update(U* data, std::size_t count, U mask) noexcept
+		{
+#if defined(GHASSANPL_X86)
+			if (get_cpu_features().avx2) return update_avx2<OP>(data, count, mask);
+#endif
+			update_scalar<OP>(data, count, mask);
+		}
+
+		template <typename FLAGS, typename PREDICATE>
+		std::size_t count_if(FLAGS const* data, std::size_t count, PREDICATE& predicate)
+		{
+#if defined(GHASSANPL_X86)
+			if (get_cpu_features().avx2) return count_if_avx2(data, count, predicate);
+#endif
+			return count_if_scalar(data, count, predicate);
+		}
+
+		template <typename FLAGS>
+		auto mutable_column_bits(std::span<FLAGS> flags) noexcept
+		{
+			static_assert(sizeof(FLAGS) == sizeof(typename FLAGS::value_type) && std::is_standard_layout_v<FLAGS>);
+			return reinterpret_cast<std::make_unsigned_t<typename FLAGS::value_type>*>(flags.data());
+		}
+
+		template <bool OR, typename FLAGS>
+		FLAGS reduce_flags(std::span<FLAGS const> flags, unsigned thread_count)
+		{
+			using U = std::make_unsigned_t<typename FLAGS::value_type>;
+			const auto data = column_bits(flags);
+			std::vector<U> partial(std::max(thread_count, 1u));
+			const auto chunks = for_each_chunk(flags.size(), thread_count, flag_algorithms_min_chunk, [&](std::size_t c, std::size_t first, std::size_t size) {
+				partial[c] = reduce<OR>(data + first, size);
+			});
+			return FLAGS::from_bits(static_cast<typename FLAGS::value_type>(reduce_scalar<OR>(partial.data(), chunks)));
+		}
+
+		template <flag_update OP, typename FLAGS>
+		void update_flags(std::span<FLAGS> flags, FLAGS mask, unsigned thread_count)
+		{
+			using U = std::make_unsigned_t<typename FLAGS::value_type>;
+			const auto data = mutable_column_bits(flags);
+			for_each_chunk(flags.size(), thread_count, flag_algorithms_min_chunk, [&](std::size_t, std::size_t first, std::size_t size) {
+				update<OP>(data + first, size, static_cast<U>(mask.bits));
+			});
+		}
+
+		/// Half-open ranges of positions, and the number of positions before each one
+		struct position_ranges
+		{
+			std::vector<std::size_t> first, last, before;
+			void add(std::size_t from, std::size_t to) { if (from < to) { before.push_back(size()); first.push_back(from); last.push_back(to); } }
+			std::size_t size() const noexcept { return before.empty() ? 0 : before.back() + (last.back() - first.back()); }
+		};
+	}
+
+	/// Returns the union of the flags of all elements
+	template <detail::column_flags FLAGS>
+	[[nodiscard]]
+	FLAGS reduce_or(std::span<FLAGS const> flags) noexcept
+	{
+		return FLAGS::from_bits(static_cast<typename FLAGS::value_type>(detail::reduce<true>(detail::column_bits(flags), flags.size())));
+	}
+
+	template <detail::column_flags FLAGS>
+	[[nodiscard]]
+	FLAGS reduce_or(std::span<FLAGS const> flags, unsigned thread_count) { return detail::reduce_flags<true>(flags, thread_count); }
+
+	/// Returns the flags set in every element (all flags for an empty span)
+	template <detail::column_flags FLAGS>
+	[[nodiscard]]
+	FLAGS reduce_and(std::span<FLAGS const> flags) noexcept
+	{
+		return FLAGS::from_bits(static_cast<typename FLAGS::value_type>(detail::reduce<false>(detail::column_bits(flags), flags.size())));
+	}
+
+	template <detail::column_flags FLAGS>
+	[[nodiscard]]
+	FLAGS reduce_and(std::span<FLAGS const> flags, unsigned thread_count) { return detail::reduce_flags<false>(flags, thread_count); }
+
+	/// Returns the number of elements for which `predicate` (e.g. a `flag_predicate`) returns true
+	template <detail::column_flags FLAGS, std::predicate<FLAGS> PREDICATE>
+	[[nodiscard]]
+	std::size_t count_if(std::span<FLAGS const> flags, PREDICATE predicate)
+	{
+		return detail::count_if(flags.data(), flags.size(), predicate);
+	}
+
+	/// The predicate is called concurrently from several threads
+	template <detail::column_flags FLAGS, std::predicate<FLAGS> PREDICATE>
+	[[nodiscard]]
+	std::size_t count_if(std::span<FLAGS const> flags, PREDICATE predicate, unsigned thread_count)
+	{
+		std::vector<std::size_t> partial(std::max(thread_count, 1u));
+		const auto chunks = detail::for_each_chunk(flags.size(), thread_count, flag_algorithms_min_chunk, [&](std::size_t c, std::size_t first, std::size_t size) {
+			partial[c] = detail::count_if(flags.data() + first, size, predicate);
+		});
+		std::size_t found = 0;
+		for (std::size_t c = 0; c < chunks; ++c) found += partial[c];
+		return found;
+	}
+
+	/// Sets `mask` in every element
+	template <detail::column_flags FLAGS>
+	void apply_set(std::span<FLAGS> flags, std::type_identity_t<FLAGS> mask, unsigned thread_count = 1) { detail::update_flags<detail::flag_update::set>(flags, mask, thread_count); }
+
+	/// Clears `mask` in every element
+	template <detail::column_flags FLAGS>
+	void apply_unset(std::span<FLAGS> flags, std::type_identity_t<FLAGS> mask, unsigned thread_count = 1) { detail::update_flags<detail::flag_update::unset>(flags, mask, thread_count); }
+
+	/// Toggles `mask` in every element
+	template <detail::column_flags FLAGS>
+	void apply_toggle(std::span<FLAGS> flags, std::type_identity_t<FLAGS> mask, unsigned thread_count = 1) { detail::update_flags<detail::flag_update::toggle>(flags, mask, thread_count); }
+
+	/// Reorders `flags` so that the elements that have all of `mask` set come first, and returns their number.
+	/// Like `std::partition`, the order within the two groups isn't kept.
+	template <detail::column_flags FLAGS>
+	std::size_t partition_by(std::span<FLAGS> flags, std::type_identity_t<FLAGS> mask) noexcept
+	{
+		using U = std::make_unsigned_t<typename FLAGS::value_type>;
+		return detail::partition_scalar(detail::mutable_column_bits(flags), flags.size(), static_cast<U>(mask.bits));
+	}
+
+	/// Every chunk is partitioned on its own thread. That leaves some non-matching elements in front of the partition
+	/// point and as many matching ones after it; the threads then swap equal shares of those into place.
+	template <detail::column_flags FLAGS>
+	std::size_t partition_by(std::span<FLAGS> flags, std::type_identity_t<FLAGS> mask, unsigned thread_count)
+	{
+		using U = std::make_unsigned_t<typename FLAGS::value_type>;
+		const auto data = detail::mutable_column_bits(flags);
+		const auto bits = static_cast<U>(mask.bits);
+
+		const auto workers = std::max(thread_count, 1u);
+		std::vector<std::size_t> firsts(workers), sizes(workers), found(workers);
+		const auto chunks = detail::for_each_chunk(flags.size(), thread_count, flag_algorithms_min_chunk, [&](std::size_t c, std::size_t first, std::size_t size) {
+			firsts[c] = first;
+			sizes[c] = size;
+			found[c] = detail::partition_scalar(data + first, size, bits);
+		});
+		if (chunks == 1) return found[0];
+
+		std::size_t total = 0;
+		for (std::size_t c = 0; c < chunks; ++c) total += found[c];
+
+		/// Non-matching elements before `total`, and matching elements after it
+		detail::position_ranges misplaced_left, misplaced_right;
+		for (std::size_t c = 0; c < chunks; ++c)
+		{
+			const auto split = firsts[c] + found[c], end = firsts[c] + sizes[c];
+			misplaced_left.add(split, std::min(end, total));
+			misplaced_right.add(std::max(firsts[c], total), split);
+		}
+
+		const auto misplaced = misplaced_left.size();
+		if (misplaced == 0) return total;
+		detail::for_each_chunk(misplaced, thread_count, flag_algorithms_min_chunk, [&](std::size_t, std::size_t first, std::size_t size) {
+			auto locate = [first](detail::position_ranges const& ranges) {
+				const auto r = static_cast<std::size_t>(std::upper_bound(ranges.before.begin(), ranges.before.end(), first) - ranges.before.begin()) - 1;
+				return std::pair{ r, ranges.first[r] + (first - ranges.before[r]) };
+			};
+			auto [left_range, left] = locate(misplaced_left);
+			auto [right_range, right] = locate(misplaced_right);
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				if (left == misplaced_left.last[left_range]) left = misplaced_left.first[++left_range];
+				if (right == misplaced_right.last[right_range]) right = misplaced_right.first[++right_range];
+				std::swap(data[left++], data[right++]);
+			}
+		});
+		return total;
+	}
+}
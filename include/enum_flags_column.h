@@ -0,0 +1,301 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include "cpu_features.h"
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+namespace ghassanpl
+{
+	/// Index type of selection vectors produced by the bulk kernels
+	using flag_selection_index = std::uint32_t;
+
+	namespace detail
+	{
+		template <typename FLAGS>
+		concept column_flags = requires { typename FLAGS::value_type; typename FLAGS::enum_type; }
+			&& std::is_same_v<FLAGS, enum_flags<typename FLAGS::enum_type, typename FLAGS::value_type>>
+			&& bit_integral<typename FLAGS::value_type>;
+
+		template <typename FLAGS>
+		auto column_bits(std::span<FLAGS const> flags) noexcept
+		{
+			static_assert(sizeof(FLAGS) == sizeof(typename FLAGS::value_type) && std::is_standard_layout_v<FLAGS>);
+			return reinterpret_cast<std::make_unsigned_t<typename FLAGS::value_type> const*>(flags.data());
+		}
+
+		/// One bit per element in a `movemask_epi8` result
+		template <typename U>
+		constexpr std::uint32_t element_lead_bytes = sizeof(U) == 1 ? 0xFFFFFFFFu : sizeof(U) == 2 ? 0x55555555u : sizeof(U) == 4 ? 0x11111111u : 0x01010101u;
+
+		/// Branchless: every index is written, but the output cursor only advances on a match
+		template <typename U>
+		std::size_t filter_scalar(U const* data, std::size_t count, std::size_t base, U required, U forbidden, flag_selection_index* out) noexcept
+		{
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const U v = data[i];
+				out[found] = static_cast<flag_selection_index>(base + i);
+				found += ((v & required) == required) & ((v & forbidden) == 0);
+			}
+			return found;
+		}
+
+		template <typename U>
+		std::size_t count_scalar(U const* data, std::size_t count, U required, U forbidden) noexcept
+		{
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const U v = data[i];
+				found += ((v & required) == required) & ((v & forbidden) == 0);
+			}
+			return found;
+		}
+
+#if defined(GHASSANPL_X86)
+		template <typename U>
+		GHASSANPL_TARGET("avx2") inline __m256i avx2_broadcast(U v) noexcept
+		{
+			if constexpr (sizeof(U) == 1) return _mm256_set1_epi8(static_cast<char>(v));
+			else if constexpr (sizeof(U) == 2) return _mm256_set1_epi16(static_cast<short>(v));
+			else if constexpr (sizeof(U) == 4) return _mm256_set1_epi32(static_cast<int>(v));
+			else return _mm256_set1_epi64x(static_cast<long long>(v));
+		}
+
+		template <typename U>
+		GHASSANPL_TARGET("avx2") inline __m256i avx2_cmpeq(__m256i a, __m256i b) noexcept
+		{
+			if constexpr (sizeof(U) == 1) return _mm256_cmpeq_epi8(a, b);
+			else if constexpr (sizeof(U) == 2) return _mm256_cmpeq_epi16(a, b);
+			else if constexpr (sizeof(U) == 4) return _mm256_cmpeq_epi32(a, b);
+			else return _mm256_cmpeq_epi64(a, b);
+		}
+
+		/// Returns a byte mask of elements `v` for which `(v & required) == required && (v & forbidden) == 0`,
+		/// with only the lowest byte bit of every element kept
+		template <typename U>
+		GHASSANPL_TARGET("avx2") inline std::uint32_t avx2_match(U const* data, __m256i required, __m256i forbidden) noexcept
+		{
+			const auto x = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data));
+			const auto has_required = avx2_cmpeq<U>(_mm256_and_si256(x, required), required);
+			const auto has_forbidden = avx2_cmpeq<U>(_mm256_and_si256(x, forbidden), _mm256_setzero_si256());
+			return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(has_required, has_forbidden))) & element_lead_bytes<U>;
+		}
+
+		template <typename U>
+		GHASSANPL_TARGET("avx2") std::size_t filter_avx2(U const* data, std::size_t count, U required, U forbidden, flag_selection_index* out) noexcept
+		{
+			constexpr std::size_t per_vector = 32 / sizeof(U);
+			const auto vrequired = avx2_broadcast(required);
+			const auto vforbidden = avx2_broadcast(forbidden);
+			std::size_t found = 0, i = 0;
+			for (; i + per_vector <= count; i += per_vector)
+			{
+				auto mask = avx2_match(data + i, vrequired, vforbidden);
+				while (mask)
+				{
+					out[found++] = static_cast<flag_selection_index>(i + std::countr_zero(mask) / sizeof(U));
+					mask &= mask - 1;
+				}
+			}
+			return found + filter_scalar(data + i, count - i, i, required, forbidden, out + found);
+		}
+
+		template <typename U>
+		GHASSANPL_TARGET("avx2") std::size_t count_avx2(U const* data, std::size_t count, U required, U forbidden) noexcept
+		{
+			constexpr std::size_t per_vector = 32 / sizeof(U);
+			const auto vrequired = avx2_broadcast(required);
+			const auto vforbidden = avx2_broadcast(forbidden);
+			std::size_t found = 0, i = 0;
+			for (; i + per_vector <= count; i += per_vector)
+				found += static_cast<std::size_t>(std::popcount(avx2_match(data + i, vrequired, vforbidden)));
+			return found + count_scalar(data + i, count - i, required, forbidden);
+		}
+
+		/// AVX-512 paths exist for 32- and 64-bit elements only (AVX-512F); narrower elements use the AVX2 path
+		template <typename U>
+		GHASSANPL_TARGET("avx512f") inline std::uint32_t avx512_match(U const* data, __m512i required, __m512i forbidden) noexcept
+		{
+			const auto x = _mm512_loadu_si512(data);
+			if constexpr (sizeof(U) == 4)
+				return _mm512_mask_cmpeq_epi32_mask(_mm512_testn_epi32_mask(x, forbidden), _mm512_and_si512(x, required), required);
+			else
+				return _mm512_mask_cmpeq_epi64_mask(_mm512_testn_epi64_mask(x, forbidden), _mm512_and_si512(x, required), required);
+		}
+
+		template <typename U>
+		GHASSANPL_TARGET("avx512f") inline __m512i avx512_broadcast(U v) noexcept
+		{
+			if constexpr (sizeof(U) == 4) return _mm512_set1_epi32(static_cast<int>(v));
+			else return _mm512_set1_epi64(static_cast<long long>(v));
+		}
+
+		/// Matching indices are written with a compress-store, so there is no per-match branch
+		template <typename U>
+		GHASSANPL_TARGET("avx512f") std::size_t filter_avx512(U const* data, std::size_t count, U required, U forbidden, flag_selection_index* out) noexcept
+		{
+			constexpr std::size_t per_vector = 64 / sizeof(U);
+			const auto vrequired = avx512_broadcast(required);
+			const auto vforbidden = avx512_broadcast(forbidden);
+			const auto step = _mm512_set1_epi32(static_cast<int>(per_vector));
+			auto indices = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+			std::size_t found = 0, i = 0;
+			for (; i + per_vector <= count; i += per_vector)
+			{
+				const auto mask = avx512_match(data + i, vrequired, vforbidden);
+				_mm512_mask_compressstoreu_epi32(out + found, static_cast<__mmask16>(mask), indices);
+				found += static_cast<std::size_t>(std::popcount(mask));
+				indices = _mm512_add_epi32(indices, step);
+			}
+			return found + filter_scalar(data + i, count - i, i, required, forbidden, out + found);
+		}
+
+		template <typename U>
+		GHASSANPL_TARGET("avx512f") std::size_t count_avx512(U const* data, std::size_t count, U required, U forbidden) noexcept
+		{
+			constexpr std::size_t per_vector = 64 / sizeof(U);
+			const auto vrequired = avx512_broadcast(required);
+			const auto vforbidden = avx512_broadcast(forbidden);
+			std::size_t found = 0, i = 0;
+			for (; i + per_vector <= count; i += per_vector)
+				found += static_cast<std::size_t>(std::popcount(avx512_match(data + i, vrequired, vforbidden)));
+			return found + count_scalar(data + i, count - i, required, forbidden);
+		}
+#endif
+	}
+
+	/// Writes the indices of all elements of `flags` that have every flag in `required` and none in `forbidden` set into `out`,
+	/// returning the number of indices written. `out` must have room for `flags.size()` indices.
+	template <detail::column_flags FLAGS>
+	std::size_t filter_flags(std::span<FLAGS const> flags, FLAGS required, FLAGS forbidden, std::span<flag_selection_index> out) noexcept
+	{
+		using U = std::make_unsigned_t<typename FLAGS::value_type>;
+		const auto data = detail::column_bits(flags);
+		const auto req = static_cast<U>(required.bits), forb = static_cast<U>(forbidden.bits);
+#if defined(GHASSANPL_X86)
+		auto const& cpu = detail::get_cpu_features();
+		if constexpr (sizeof(U) >= 4)
+		{
+			if (cpu.avx512f) return detail::filter_avx512(data, flags.size(), req, forb, out.data());
+		}
+		if (cpu.avx2) return detail::filter_avx2(data, flags.size(), req, forb, out.data());
+#endif
+		return detail::filter_scalar(data, flags.size(), 0, req, forb, out.data());
+	}
+
+	/// Returns the number of elements of `flags` that have every flag in `required` and none in `forbidden` set
+	template <detail::column_flags FLAGS>
+	std::size_t count_flags(std::span<FLAGS const> flags, FLAGS required, FLAGS forbidden) noexcept
+	{
+		using U = std::make_unsigned_t<typename FLAGS::value_type>;
+		const auto data = detail::column_bits(flags);
+		const auto req = static_cast<U>(required.bits), forb = static_cast<U>(forbidden.bits);
+#if defined(GHASSANPL_X86)
+		auto const& cpu = detail::get_cpu_features();
+		if constexpr (sizeof(U) >= 4)
+		{
+			if (cpu.avx512f) return detail::count_avx512(data, flags.size(), req, forb);
+		}
+		if (cpu.avx2) return detail::count_avx2(data, flags.size(), req, forb);
+#endif
+		return detail::count_scalar(data, flags.size(), req, forb);
+	}
+
+	/// A column of `enum_flags` values with bulk query and update kernels.
+	/// Filtering runs over the raw bits with AVX-512 or AVX2 compare-and-mask when the CPU supports it (detected at runtime).
+	/// Since selections use 32-bit indices, a column can hold at most 2^32 elements.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct enum_flags_column
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using value_type = flags_type;
+		using enum_type = ENUM;
+		using index_type = flag_selection_index;
+		using selection_type = std::vector<index_type>;
+		using container_type = std::vector<flags_type>;
+		using iterator = typename container_type::iterator;
+		using const_iterator = typename container_type::const_iterator;
+
+		enum_flags_column() noexcept = default;
+		explicit enum_flags_column(std::size_t count, flags_type value = {}) : values(count, value) {}
+		enum_flags_column(std::initializer_list<flags_type> init) : values(init) {}
+		explicit enum_flags_column(std::span<flags_type const> init) : values(init.begin(), init.end()) {}
+
+		[[nodiscard]] std::size_t size() const noexcept { return values.size(); }
+		[[nodiscard]] bool empty() const noexcept { return values.empty(); }
+		void reserve(std::size_t count) { values.reserve(count); }
+		void resize(std::size_t count, flags_type value = {}) { values.resize(count, value); }
+		void clear() noexcept { values.clear(); }
+		void push_back(flags_type value) { values.push_back(value); }
+
+		[[nodiscard]] flags_type& operator[](std::size_t index) noexcept { return values[index]; }
+		[[nodiscard]] flags_type const& operator[](std::size_t index) const noexcept { return values[index]; }
+
+		[[nodiscard]] flags_type* data() noexcept { return values.data(); }
+		[[nodiscard]] flags_type const* data() const noexcept { return values.data(); }
+		[[nodiscard]] iterator begin() noexcept { return values.begin(); }
+		[[nodiscard]] iterator end() noexcept { return values.end(); }
+		[[nodiscard]] const_iterator begin() const noexcept { return values.begin(); }
+		[[nodiscard]] const_iterator end() const noexcept { return values.end(); }
+
+		operator std::span<flags_type>() noexcept { return values; }
+		operator std::span<flags_type const>() const noexcept { return values; }
+
+		/// Writes the indices of elements that have all of `required` and none of `forbidden` set into `out`, which must
+		/// have room for `size()` indices. Returns the number of indices written.
+		std::size_t filter(flags_type required, flags_type forbidden, std::span<index_type> out) const noexcept
+		{
+			return filter_flags(std::span<flags_type const>{ values }, required, forbidden, out);
+		}
+
+		/// Returns the indices of elements that have all of `required` and none of `forbidden` set
+		[[nodiscard]]
+		selection_type filter(flags_type required, flags_type forbidden = {}) const
+		{
+			selection_type result(values.size());
+			result.resize(filter(required, forbidden, result));
+			return result;
+		}
+
+		/// Returns the number of elements that have all of `required` and none of `forbidden` set
+		[[nodiscard]]
+		std::size_t count(flags_type required, flags_type forbidden = {}) const noexcept
+		{
+			return count_flags(std::span<flags_type const>{ values }, required, forbidden);
+		}
+
+		/// The selection-based updates are scatters and aren't vectorized; they are bound by the random access to the column
+		void set(std::span<index_type const> selection, flags_type flags) noexcept
+		{
+			for (auto index : selection) values[index].set(flags);
+		}
+
+		void unset(std::span<index_type const> selection, flags_type flags) noexcept
+		{
+			for (auto index : selection) values[index].unset(flags);
+		}
+
+		void toggle(std::span<index_type const> selection, flags_type flags) noexcept
+		{
+			for (auto index : selection) values[index].toggle(flags);
+		}
+
+		void set_to(bool val, std::span<index_type const> selection, flags_type flags) noexcept
+		{
+			if (val) set(selection, flags); else unset(selection, flags);
+		}
+
+	private:
+
+		container_type values;
+	};
+}
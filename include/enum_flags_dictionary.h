@@ -0,0 +1,377 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags_column.h"
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Dictionary encoding for columns of `enum_flags` in which few distinct combinations occur: every distinct value is
+/// interned once and given a dense 8- or 16-bit ID, which is what the column stores.
+/// Predicates are evaluated once per ID into a lookup table, so filtering is a gather from that table, and grouping
+/// by value is a counting sort over the IDs.
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		template <typename ID>
+		concept dictionary_id = std::same_as<ID, std::uint8_t> || std::same_as<ID, std::uint16_t>;
+
+		template <typename FLAGS, typename ID>
+		void decode_ids_scalar(FLAGS const* values, ID const* ids, std::size_t count, FLAGS* out) noexcept
+		{
+			for (std::size_t i = 0; i < count; ++i)
+				out[i] = values[ids[i]];
+		}
+
+		template <typename ID>
+		std::size_t count_ids_scalar(ID const* ids, std::size_t count, std::uint8_t const* table) noexcept
+		{
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < count; ++i)
+				found += table[ids[i]];
+			return found;
+		}
+
+		/// Writes every index, but only advances past the matching ones
+		template <typename ID>
+		std::size_t filter_ids_scalar(ID const* ids, std::size_t count, std::uint8_t const* table, flag_selection_index* out) noexcept
+		{
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				out[found] = static_cast<flag_selection_index>(i);
+				found += table[ids[i]];
+			}
+			return found;
+		}
+
+#if defined(GHASSANPL_X86)
+		/// The loops are simple enough for the compiler to vectorize with AVX2 gathers and widening loads
+		template <typename FLAGS, typename ID>
+		GHASSANPL_TARGET("avx2") void decode_ids_avx2(FLAGS const* values, ID const* ids, std::size_t count, FLAGS* out) noexcept
+		{
+			decode_ids_scalar(values, ids, count, out);
+		}
+
+		template <typename ID>
+		GHASSANPL_TARGET("avx2") std::size_t count_ids_avx2(ID const* ids, std::size_t count, std::uint8_t const* table) noexcept
+		{
+			return count_ids_scalar(ids, count, table);
+		}
+#endif
+	}
+
+	/// Interns distinct `enum_flags` values, giving each a dense ID in order of first appearance.
+	/// The values are kept in a flat open-addressing table (linear probing, at most a quarter full) that stores the bits
+	/// next to the ID, so most lookups hit the first slot they touch. At most `max_size` values fit.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct enum_flags_dictionary
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using value_type = flags_type;
+		using id_type = std::uint16_t;
+		static constexpr std::size_t max_size = std::size_t{ 1 } << 16;
+
+		/// How many values can be given IDs of type `ID`
+		template <detail::dictionary_id ID>
+		static constexpr std::size_t capacity_for = std::size_t{ std::numeric_limits<ID>::max() } + 1;
+
+		[[nodiscard]] std::size_t size() const noexcept { return entries.size(); }
+		[[nodiscard]] bool empty() const noexcept { return entries.empty(); }
+		[[nodiscard]] bool full() const noexcept { return entries.size() == max_size; }
+
+		/// The interned values, indexed by ID
+		[[nodiscard]] std::span<flags_type const> values() const noexcept { return entries; }
+		[[nodiscard]] flags_type operator[](id_type id) const noexcept { return entries[id]; }
+
+		/// The narrowest ID type that holds every ID given so far, in bytes
+		[[nodiscard]] std::size_t id_bytes() const noexcept { return entries.size() <= capacity_for<std::uint8_t> ? 1 : 2; }
+
+		void clear() noexcept
+		{
+			entries.clear();
+			slots.clear();
+		}
+
+		[[nodiscard]]
+		std::optional<id_type> find(flags_type flags) const noexcept
+		{
+			if (slots.empty()) return std::nullopt;
+			const auto bits = static_cast<U>(flags.bits);
+			for (auto s = home_slot(bits);; s = (s + 1) & (slots.size() - 1))
+			{
+				if (slots[s].id == 0) return std::nullopt;
+				if (slots[s].bits == bits) return static_cast<id_type>(slots[s].id - 1);
+			}
+		}
+
+		/// Returns the ID of `flags`, interning it if it's new; `nullopt` if it's new and the dictionary is full
+		std::optional<id_type> intern(flags_type flags)
+		{
+			if (auto id = intern_below(flags, max_size); id < max_size) return static_cast<id_type>(id);
+			return std::nullopt;
+		}
+
+		/// Interns every element of `in` and writes its ID to the same position of `out`, which must be at least as
+		/// large. Stops at the first new value that would need an ID that doesn't fit `ID`, and returns the number
+		/// of elements encoded.
+		template <detail::dictionary_id ID>
+		std::size_t encode(std::span<flags_type const> in, std::span<ID> out)
+		{
+			constexpr auto limit = std::min(capacity_for<ID>, max_size);
+			for (std::size_t i = 0; i < in.size(); ++i)
+			{
+				/// Most values are found in their home slot, which is checked inline
+				const auto bits = static_cast<U>(in[i].bits);
+				std::size_t id = limit;
+				if (!slots.empty())
+				{
+					auto const& home = slots[home_slot(bits)];
+					if (home.bits == bits && home.id != 0) id = home.id - 1;
+				}
+				if (id >= limit) id = intern_below(in[i], limit);
+				if (id >= limit) return i;
+				out[i] = static_cast<ID>(id);
+			}
+			return in.size();
+		}
+
+		/// Writes the value of every ID in `ids` into the same position of `out`, which must be at least as large
+		template <detail::dictionary_id ID>
+		void decode(std::span<ID const> ids, std::span<flags_type> out) const noexcept
+		{
+#if defined(GHASSANPL_X86)
+			if (detail::get_cpu_features().avx2) return detail::decode_ids_avx2(entries.data(), ids.data(), ids.size(), out.data());
+#endif
+			detail::decode_ids_scalar(entries.data(), ids.data(), ids.size(), out.data());
+		}
+
+		/// Evaluates `predicate` once per interned value; the result, indexed by ID, is 1 for the values that satisfy it
+		/// and 0 for the others. Values interned later are not covered, so the table has to be rebuilt after they are.
+		template <std::predicate<flags_type> PREDICATE>
+		[[nodiscard]]
+		std::vector<std::uint8_t> lookup_table(PREDICATE&& predicate) const
+		{
+			std::vector<std::uint8_t> table(entries.size());
+			for (std::size_t id = 0; id < entries.size(); ++id)
+				table[id] = static_cast<bool>(predicate(entries[id]));
+			return table;
+		}
+
+	private:
+
+		using U = std::make_unsigned_t<VALUE_TYPE>;
+
+		struct slot
+		{
+			U bits = 0;
+			/// 0 marks an empty slot, so this is one more than the ID
+			std::uint32_t id = 0;
+		};
+
+		std::vector<flags_type> entries;
+		std::vector<slot> slots;
+
+		std::size_t home_slot(U bits) const noexcept { return detail::hash_flag_bits(bits) & (slots.size() - 1); }
+
+		/// Returns the ID of `flags`, interning it if it's new and there are less than `limit` values; `limit` otherwise
+		std::size_t intern_below(flags_type flags, std::size_t limit)
+		{
+			if (slots.empty()) slots.resize(16);
+			const auto bits = static_cast<U>(flags.bits);
+			auto s = home_slot(bits);
+			for (; slots[s].id != 0; s = (s + 1) & (slots.size() - 1))
+				if (slots[s].bits == bits) return slots[s].id - 1;
+
+			if (entries.size() >= limit) return limit;
+			entries.push_back(flags);
+			slots[s] = { bits, static_cast<std::uint32_t>(entries.size()) };
+			if (entries.size() * 4 > slots.size()) rehash(slots.size() * 2);
+			return entries.size() - 1;
+		}
+
+		void rehash(std::size_t slot_count)
+		{
+			slots.assign(slot_count, slot{});
+			for (std::size_t id = 0; id < entries.size(); ++id)
+			{
+				const auto bits = static_cast<U>(entries[id].bits);
+				auto s = home_slot(bits);
+				while (slots[s].id != 0) s = (s + 1) & (slots.size() - 1);
+				slots[s] = { bits, static_cast<std::uint32_t>(id + 1) };
+			}
+		}
+	};
+
+	/// Returns the number of IDs for which `table` (see `enum_flags_dictionary::lookup_table`) is 1
+	template <detail::dictionary_id ID>
+	[[nodiscard]]
+	std::size_t count_matching_ids(std::span<ID const> ids, std::span<std::uint8_t const> table) noexcept
+	{
+#if defined(GHASSANPL_X86)
+		if (detail::get_cpu_features().avx2) return detail::count_ids_avx2(ids.data(), ids.size(), table.data());
+#endif
+		return detail::count_ids_scalar(ids.data(), ids.size(), table.data());
+	}
+
+	/// Writes the indices of the IDs for which `table` is 1 into `out`, returning the number of indices written.
+	/// `out` must have room for `ids.size()` indices.
+	template <detail::dictionary_id ID>
+	std::size_t filter_matching_ids(std::span<ID const> ids, std::span<std::uint8_t const> table, std::span<flag_selection_index> out) noexcept
+	{
+		return detail::filter_ids_scalar(ids.data(), ids.size(), table.data(), out.data());
+	}
+
+	/// The indices of a column of IDs, grouped by ID: `indices_of(id)` lists the rows holding `id`, in increasing order
+	struct flag_id_groups
+	{
+		/// `offsets[id]` to `offsets[id + 1]` is the range of `rows` holding `id`
+		std::vector<std::size_t> offsets;
+		std::vector<flag_selection_index> rows;
+
+		[[nodiscard]] std::size_t group_count() const noexcept { return offsets.empty() ? 0 : offsets.size() - 1; }
+		[[nodiscard]] std::size_t size_of(std::size_t id) const noexcept { return offsets[id + 1] - offsets[id]; }
+		[[nodiscard]]
+		std::span<flag_selection_index const> indices_of(std::size_t id) const noexcept
+		{
+			return std::span{ rows }.subspan(offsets[id], offsets[id + 1] - offsets[id]);
+		}
+	};
+
+	/// Groups the rows of `ids` by ID with a counting sort. Every ID must be less than `id_count` (the dictionary size).
+	template <detail::dictionary_id ID>
+	[[nodiscard]]
+	flag_id_groups group_by_id(std::span<ID const> ids, std::size_t id_count)
+	{
+		flag_id_groups groups;
+		groups.offsets.assign(id_count + 1, 0);
+		for (auto id : ids) ++groups.offsets[std::size_t{ id } + 1];
+		for (std::size_t id = 0; id < id_count; ++id) groups.offsets[id + 1] += groups.offsets[id];
+
+		groups.rows.resize(ids.size());
+		std::vector<std::size_t> next(groups.offsets.begin(), groups.offsets.end() - 1);
+		for (std::size_t i = 0; i < ids.size(); ++i)
+			groups.rows[next[ids[i]]++] = static_cast<flag_selection_index>(i);
+		return groups;
+	}
+
+	/// A column of `enum_flags` values stored as dictionary IDs. IDs take one byte while the dictionary has at most
+	/// 256 values; the column switches to two-byte IDs when it grows past that. `push_back` and `append` fail once
+	/// there are more than `enum_flags_dictionary::max_size` distinct values.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct enum_flags_dictionary_column
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using value_type = flags_type;
+		using dictionary_type = enum_flags_dictionary<ENUM, VALUE_TYPE>;
+		using index_type = flag_selection_index;
+		using selection_type = std::vector<index_type>;
+
+		enum_flags_dictionary_column() noexcept = default;
+		explicit enum_flags_dictionary_column(std::span<flags_type const> flags) { append(flags); }
+
+		[[nodiscard]] std::size_t size() const noexcept { return wide() ? wide_ids.size() : narrow_ids.size(); }
+		[[nodiscard]] bool empty() const noexcept { return size() == 0; }
+		[[nodiscard]] dictionary_type const& dictionary() const noexcept { return dict; }
+
+		/// Whether the IDs take two bytes
+		[[nodiscard]] bool wide() const noexcept { return is_wide; }
+		[[nodiscard]] std::span<std::uint8_t const> ids8() const noexcept { return narrow_ids; }
+		[[nodiscard]] std::span<std::uint16_t const> ids16() const noexcept { return wide_ids; }
+
+		/// Bytes taken by the IDs and the dictionary values (not counting the hash table)
+		[[nodiscard]]
+		std::size_t storage_bytes() const noexcept { return narrow_ids.size() + wide_ids.size() * 2 + dict.size() * sizeof(flags_type); }
+
+		[[nodiscard]]
+		flags_type operator[](std::size_t index) const noexcept { return dict[wide() ? wide_ids[index] : narrow_ids[index]]; }
+
+		void clear() noexcept
+		{
+			dict.clear();
+			narrow_ids.clear();
+			wide_ids.clear();
+			is_wide = false;
+		}
+
+		void reserve(std::size_t count) { wide() ? wide_ids.reserve(count) : narrow_ids.reserve(count); }
+
+		bool push_back(flags_type flags) { return append(std::span{ &flags, 1 }) == 1; }
+
+		/// Returns the number of elements appended, which is less than `flags.size()` only if the dictionary filled up
+		std::size_t append(std::span<flags_type const> flags)
+		{
+			std::size_t done = 0;
+			if (!wide())
+			{
+				const auto first = narrow_ids.size();
+				narrow_ids.resize(first + flags.size());
+				done = dict.encode(flags, std::span{ narrow_ids }.subspan(first));
+				narrow_ids.resize(first + done);
+				if (done == flags.size()) return done;
+				widen();
+			}
+			const auto first = wide_ids.size();
+			wide_ids.resize(first + flags.size() - done);
+			const auto wide_done = dict.encode(flags.subspan(done), std::span{ wide_ids }.subspan(first));
+			wide_ids.resize(first + wide_done);
+			return done + wide_done;
+		}
+
+		/// Writes every value into the same position of `out`, which must be at least as large
+		void copy_to(std::span<flags_type> out) const noexcept
+		{
+			if (wide()) dict.decode(ids16(), out);
+			else dict.decode(ids8(), out);
+		}
+
+		template <std::predicate<flags_type> PREDICATE>
+		[[nodiscard]]
+		std::size_t count(PREDICATE&& predicate) const
+		{
+			const auto table = dict.lookup_table(std::forward<PREDICATE>(predicate));
+			return wide() ? count_matching_ids(ids16(), std::span<std::uint8_t const>{ table }) : count_matching_ids(ids8(), std::span<std::uint8_t const>{ table });
+		}
+
+		/// Same as `enum_flags_column::filter`, with an arbitrary predicate
+		template <std::predicate<flags_type> PREDICATE>
+		[[nodiscard]]
+		selection_type filter(PREDICATE&& predicate) const
+		{
+			const auto table = dict.lookup_table(std::forward<PREDICATE>(predicate));
+			selection_type result(size());
+			const auto found = wide() ? filter_matching_ids(ids16(), std::span<std::uint8_t const>{ table }, std::span{ result })
+				: filter_matching_ids(ids8(), std::span<std::uint8_t const>{ table }, std::span{ result });
+			result.resize(found);
+			return result;
+		}
+
+		/// The rows grouped by value; group `id` holds the rows equal to `dictionary()[id]`
+		[[nodiscard]]
+		flag_id_groups group() const
+		{
+			return wide() ? group_by_id(ids16(), dict.size()) : group_by_id(ids8(), dict.size());
+		}
+
+	private:
+
+		dictionary_type dict;
+		std::vector<std::uint8_t> narrow_ids;
+		std::vector<std::uint16_t> wide_ids;
+		bool is_wide = false;
+
+		void widen()
+		{
+			wide_ids.assign(narrow_ids.begin(), narrow_ids.end());
+			narrow_ids = {};
+			is_wide = true;
+		}
+	};
+}
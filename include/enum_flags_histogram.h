@@ -0,0 +1,240 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags_column.h"
+#include <array>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/// Per-flag population counts over large arrays of `enum_flags` ("how many elements have each flag set").
+/// Instead of visiting every set bit, the kernels add 16 words (or AVX2 vectors) of elements at a time with a tree of
+/// carry-save adders, as in the Harley-Seal population count. The adders keep each bit position separate, so after
+/// a block they hold, bit-sliced, how many of its elements have each flag. Only the 16s counter needs to be unpacked
+/// into per-flag totals after every block; the 1s, 2s, 4s and 8s are carried across blocks and unpacked once at the end.
+
+namespace ghassanpl
+{
+	/// Number of elements that have each flag set
+	template <detail::integral_or_enum ENUM, std::size_t FLAG_COUNT>
+	struct flag_counts
+	{
+		using enum_type = ENUM;
+		static constexpr std::size_t flag_count = FLAG_COUNT;
+
+		std::array<std::uint64_t, FLAG_COUNT> counts{};
+
+		[[nodiscard]]
+		constexpr std::uint64_t operator[](ENUM flag) const noexcept { return counts[static_cast<std::size_t>(detail::to_underlying_type(flag))]; }
+
+		constexpr flag_counts& operator+=(flag_counts const& other) noexcept
+		{
+			for (std::size_t i = 0; i < FLAG_COUNT; ++i) counts[i] += other.counts[i];
+			return *this;
+		}
+
+		constexpr bool operator==(flag_counts const& other) const noexcept = default;
+	};
+
+	namespace detail
+	{
+		template <typename U>
+		using bit_counts = std::array<std::uint64_t, CHAR_BIT * sizeof(U)>;
+
+		template <typename U>
+		void count_each_flag_tail(U const* data, std::size_t count, bit_counts<U>& counts) noexcept
+		{
+			for (std::size_t i = 0; i < count; ++i)
+				for (auto v = data[i]; v; v = static_cast<U>(v & (v - 1)))
+					++counts[static_cast<std::size_t>(std::countr_zero(v))];
+		}
+
+		/// Carry-save adder: adds `low`, `b` and `c` into a sum (`low`) and a carry (`high`), independently in every bit
+		inline void carry_save_add(std::uint64_t& high, std::uint64_t& low, std::uint64_t b, std::uint64_t c) noexcept
+		{
+			const auto u = low ^ b;
+			high = (low & b) | (u & c);
+			low = u ^ c;
+		}
+
+		/// The lowest bit of every `U` in a 64-bit word
+		template <typename U>
+		constexpr std::uint64_t element_low_bits = ~std::uint64_t{ 0 } / ((std::uint64_t{ 1 } << (CHAR_BIT * sizeof(U) - 1) << 1) - 1);
+
+		/// Adds `weight` times the number of set bits at each bit position of the elements in `v`
+		template <typename U>
+		void scalar_unpack_counts(std::uint64_t v, std::uint64_t weight, bit_counts<U>& counts) noexcept
+		{
+			for (std::size_t j = 0; j < CHAR_BIT * sizeof(U); ++j)
+			{
+				if constexpr (sizeof(U) == sizeof(std::uint64_t))
+					counts[j] += ((v >> j) & 1) * weight;
+				else
+					counts[j] += static_cast<std::uint64_t>(std::popcount(v & (element_low_bits<U> << j))) * weight;
+			}
+		}
+
+		/// Portable path: 64-bit words hold 8 / sizeof(U) elements each
+		template <typename U>
+		void count_each_flag_scalar(U const* data, std::size_t count, bit_counts<U>& counts) noexcept
+		{
+			constexpr std::size_t per_word = sizeof(std::uint64_t) / sizeof(U);
+			constexpr std::size_t per_block = 16 * per_word;
+
+			std::uint64_t ones = 0, twos = 0, fours = 0, eights = 0;
+			std::uint64_t w[16], twos_a, twos_b, fours_a, fours_b, eights_a, eights_b, sixteens;
+			std::size_t i = 0;
+			for (; i + per_block <= count; i += per_block)
+			{
+				std::memcpy(w, data + i, sizeof(w));
+				carry_save_add(twos_a, ones, w[0], w[1]);
+				carry_save_add(twos_b, ones, w[2], w[3]);
+				carry_save_add(fours_a, twos, twos_a, twos_b);
+				carry_save_add(twos_a, ones, w[4], w[5]);
+				carry_save_add(twos_b, ones, w[6], w[7]);
+				carry_save_add(fours_b, twos, twos_a, twos_b);
+				carry_save_add(eights_a, fours, fours_a, fours_b);
+				carry_save_add(twos_a, ones, w[8], w[9]);
+				carry_save_add(twos_b, ones, w[10], w[11]);
+				carry_save_add(fours_a, twos, twos_a, twos_b);
+				carry_save_add(twos_a, ones, w[12], w[13]);
+				carry_save_add(twos_b, ones, w[14], w[15]);
+				carry_save_add(fours_b, twos, twos_a, twos_b);
+				carry_save_add(eights_b, fours, fours_a, fours_b);
+				carry_save_add(sixteens, eights, eights_a, eights_b);
+				if (sixteens) scalar_unpack_counts<U>(sixteens, 16, counts);
+			}
+			scalar_unpack_counts<U>(ones, 1, counts);
+			scalar_unpack_counts<U>(twos, 2, counts);
+			scalar_unpack_counts<U>(fours, 4, counts);
+			scalar_unpack_counts<U>(eights, 8, counts);
+			count_each_flag_tail(data + i, count - i, counts);
+		}
+
+#if defined(GHASSANPL_X86)
+		GHASSANPL_TARGET("avx2") inline void avx2_carry_save_add(__m256i& high, __m256i& low, __m256i b, __m256i c) noexcept
+		{
+			const auto u = _mm256_xor_si256(low, b);
+			high = _mm256_or_si256(_mm256_and_si256(low, b), _mm256_and_si256(u, c));
+			low = _mm256_xor_si256(u, c);
+		}
+
+		/// Shifting left by 7 - k puts bit k of every byte in the byte's top bit, which `movemask` collects; the bytes that
+		/// belong to byte b of every element are then picked out with `element_lead_bytes << b`
+		template <typename U>
+		GHASSANPL_TARGET("avx2,popcnt") inline void avx2_unpack_counts(__m256i v, std::uint64_t weight, bit_counts<U>& counts) noexcept
+		{
+			for (int k = 0; k < CHAR_BIT; ++k)
+			{
+				const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(v, 7 - k)));
+				for (std::size_t b = 0; b < sizeof(U); ++b)
+					counts[b * CHAR_BIT + k] += static_cast<std::uint64_t>(std::popcount(mask & (element_lead_bytes<U> << b))) * weight;
+			}
+		}
+
+		template <typename U>
+		GHASSANPL_TARGET("avx2,popcnt") void count_each_flag_avx2(U const* data, std::size_t count, bit_counts<U>& counts) noexcept
+		{
+			constexpr std::size_t per_vector = 32 / sizeof(U);
+			constexpr std::size_t per_block = 16 * per_vector;
+
+			auto ones = _mm256_setzero_si256(), twos = ones, fours = ones, eights = ones;
+			__m256i w[16], twos_a, twos_b, fours_a, fours_b, eights_a, eights_b, sixteens;
+			std::size_t i = 0;
+			for (; i + per_block <= count; i += per_block)
+			{
+				for (std::size_t k = 0; k < 16; ++k)
+					w[k] = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i + k * per_vector));
+				avx2_carry_save_add(twos_a, ones, w[0], w[1]);
+				avx2_carry_save_add(twos_b, ones, w[2], w[3]);
+				avx2_carry_save_add(fours_a, twos, twos_a, twos_b);
+				avx2_carry_save_add(twos_a, ones, w[4], w[5]);
+				avx2_carry_save_add(twos_b, ones, w[6], w[7]);
+				avx2_carry_save_add(fours_b, twos, twos_a, twos_b);
+				avx2_carry_save_add(eights_a, fours, fours_a, fours_b);
+				avx2_carry_save_add(twos_a, ones, w[8], w[9]);
+				avx2_carry_save_add(twos_b, ones, w[10], w[11]);
+				avx2_carry_save_add(fours_a, twos, twos_a, twos_b);
+				avx2_carry_save_add(twos_a, ones, w[12], w[13]);
+				avx2_carry_save_add(twos_b, ones, w[14], w[15]);
+				avx2_carry_save_add(fours_b, twos, twos_a, twos_b);
+				avx2_carry_save_add(eights_b, fours, fours_a, fours_b);
+				avx2_carry_save_add(sixteens, eights, eights_a, eights_b);
+				if (!_mm256_testz_si256(sixteens, sixteens)) avx2_unpack_counts<U>(sixteens, 16, counts);
+			}
+			avx2_unpack_counts<U>(ones, 1, counts);
+			avx2_unpack_counts<U>(twos, 2, counts);
+			avx2_unpack_counts<U>(fours, 4, counts);
+			avx2_unpack_counts<U>(eights, 8, counts);
+			count_each_flag_tail(data + i, count - i, counts);
+		}
+#endif
+
+		template <typename U>
+		void count_each_flag(U const* data, std::size_t count, bit_counts<U>& counts) noexcept
+		{
+#if defined(GHASSANPL_X86)
+			if (get_cpu_features().avx2) return count_each_flag_avx2(data, count, counts);
+#endif
+			count_each_flag_scalar(data, count, counts);
+		}
+
+		template <typename FLAGS>
+		using flag_counts_for = flag_counts<typename FLAGS::enum_type, usable_flag_count<typename FLAGS::enum_type, typename FLAGS::value_type>>;
+
+		template <typename FLAGS, std::size_t BIT_COUNT>
+		flag_counts_for<FLAGS> to_flag_counts(std::array<std::uint64_t, BIT_COUNT> const& counts) noexcept
+		{
+			flag_counts_for<FLAGS> result;
+			for (std::size_t i = 0; i < result.flag_count; ++i) result.counts[i] = counts[i];
+			return result;
+		}
+	}
+
+	/// Returns how many elements of `flags` have each flag set
+	template <detail::column_flags FLAGS>
+	[[nodiscard]]
+	detail::flag_counts_for<FLAGS> count_each_flag(std::span<FLAGS const> flags) noexcept
+	{
+		using U = std::make_unsigned_t<typename FLAGS::value_type>;
+		detail::bit_counts<U> counts{};
+		detail::count_each_flag(detail::column_bits(flags), flags.size(), counts);
+		return detail::to_flag_counts<FLAGS>(counts);
+	}
+
+	/// Elements per thread below which `count_each_flag` doesn't bother splitting the work
+	inline constexpr std::size_t count_each_flag_min_chunk = std::size_t{ 1 } << 20;
+
+	/// Splits `flags` into up to `thread_count` chunks counted on their own threads (the calling thread takes the first),
+	/// then adds up the results
+	template <detail::column_flags FLAGS>
+	[[nodiscard]]
+	detail::flag_counts_for<FLAGS> count_each_flag(std::span<FLAGS const> flags, unsigned thread_count)
+	{
+		using U = std::make_unsigned_t<typename FLAGS::value_type>;
+		const auto chunks = std::max<std::size_t>(1, std::min<std::size_t>(thread_count, flags.size() / count_each_flag_min_chunk));
+		if (chunks == 1)
+			return count_each_flag(flags);
+
+		const auto data = detail::column_bits(flags);
+		const auto chunk_size = (flags.size() + chunks - 1) / chunks;
+		std::vector<detail::bit_counts<U>> partial(chunks);
+		std::vector<std::thread> threads;
+		threads.reserve(chunks - 1);
+		for (std::size_t c = 1; c < chunks; ++c)
+		{
+			const auto first = c * chunk_size;
+			const auto size = std::min(chunk_size, flags.size() - first);
+			threads.emplace_back([data, first, size, &counts = partial[c]] { detail::count_each_flag(data + first, size, counts); });
+		}
+		detail::count_each_flag(data, chunk_size, partial[0]);
+		for (auto& thread : threads) thread.join();
+
+		for (std::size_t c = 1; c < chunks; ++c)
+			for (std::size_t i = 0; i < partial[0].size(); ++i) partial[0][i] += partial[c][i];
+		return detail::to_flag_counts<FLAGS>(partial[0]);
+	}
+}
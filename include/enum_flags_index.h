@@ -0,0 +1,769 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <vector>
+
+/// An inverted index from each flag to the set of entities that have it, for answering queries like
+/// "all entities with A and B but not C" without scanning every entity.
+/// Entity sets are compressed bitmaps in the style of Roaring bitmaps: the high 16 bits of an entity ID select a
+/// container, which stores the low 16 bits as a sorted array (sparse), a 65536-bit bitmap (dense), or a list of runs.
+
+namespace ghassanpl
+{
+	using flag_entity_id = std::uint32_t;
+
+	namespace detail
+	{
+		constexpr std::size_t entity_bitmap_words = 65536 / 64;
+		/// Above this many values an array container is larger than a bitmap one
+		constexpr std::uint32_t entity_array_max = 4096;
+
+		struct entity_container
+		{
+			enum class kind : std::uint8_t { array, bitmap, run };
+
+			kind type = kind::array;
+			std::uint32_t cardinality = 0;
+			/// array: the sorted values; run: (start, length - 1) pairs, sorted by start
+			std::vector<std::uint16_t> values;
+			/// bitmap: `entity_bitmap_words` words
+			std::vector<std::uint64_t> words;
+		};
+
+		using entity_words = std::array<std::uint64_t, entity_bitmap_words>;
+
+		inline void set_word_range(std::uint64_t* words, std::uint32_t first, std::uint32_t last) noexcept
+		{
+			const auto first_word = first / 64, last_word = last / 64;
+			const auto first_mask = ~0ull << (first % 64), last_mask = ~0ull >> (63 - last % 64);
+			if (first_word == last_word)
+			{
+				words[first_word] |= first_mask & last_mask;
+				return;
+			}
+			words[first_word] |= first_mask;
+			for (auto i = first_word + 1; i < last_word; ++i) words[i] = ~0ull;
+			words[last_word] |= last_mask;
+		}
+
+		inline bool container_contains(entity_container const& c, std::uint16_t value) noexcept
+		{
+			switch (c.type)
+			{
+			case entity_container::kind::array:
+				return std::binary_search(c.values.begin(), c.values.end(), value);
+			case entity_container::kind::bitmap:
+				return (c.words[value / 64] >> (value % 64)) & 1;
+			case entity_container::kind::run:
+			{
+				/// Find the last run starting at or before `value`
+				std::size_t lo = 0, hi = c.values.size() / 2;
+				while (lo < hi)
+				{
+					const auto mid = (lo + hi) / 2;
+					if (c.values[mid * 2] <= value) lo = mid + 1; else hi = mid;
+				}
+				return lo > 0 && value - c.values[(lo - 1) * 2] <= c.values[(lo - 1) * 2 + 1];
+			}
+			}
+			return false;
+		}
+
+		/// Returns the container as bitmap words, either its own or decoded into `scratch`
+		inline std::uint64_t const* container_words(entity_container const& c, entity_words& scratch) noexcept
+		{
+			if (c.type == entity_container::kind::bitmap)
+				return c.words.data();
+			scratch.fill(0);
+			if (c.type == entity_container::kind::array)
+			{
+				for (auto v : c.values) scratch[v / 64] |= 1ull << (v % 64);
+			}
+			else
+			{
+				for (std::size_t i = 0; i < c.values.size(); i += 2)
+					set_word_range(scratch.data(), c.values[i], std::uint32_t(c.values[i]) + c.values[i + 1]);
+			}
+			return scratch.data();
+		}
+
+		inline std::uint32_t count_words_scalar(std::uint64_t const* words) noexcept
+		{
+			std::uint32_t result = 0;
+			for (std::size_t i = 0; i < entity_bitmap_words; ++i)
+				result += static_cast<std::uint32_t>(std::popcount(words[i]));
+			return result;
+		}
+
+#if defined(GHASSANPL_X86)
+		/// Without a target attribute, `std::popcount` compiles to a library call on baseline x86-64
+		GHASSANPL_TARGET("avx2,popcnt") inline std::uint32_t count_words_avx2(std::uint64_t const* words) noexcept
+		{
+			std::uint32_t result = 0;
+			for (std::size_t i = 0; i < entity_bitmap_words; ++i)
+				result += static_cast<std::uint32_t>(std::popcount(words[i]));
+			return result;
+		}
+#endif
+
+		inline std::uint32_t count_words(std::uint64_t const* words) noexcept
+		{
+#if defined(GHASSANPL_X86)
+			if (get_cpu_features().avx2) return count_words_avx2(words);
+#endif
+			return count_words_scalar(words);
+		}
+
+		/// Builds an array or bitmap container, whichever is smaller, from bitmap words with `cardinality` bits set
+		inline entity_container container_from_words(std::uint64_t const* words, std::uint32_t cardinality)
+		{
+			entity_container result;
+			result.cardinality = cardinality;
+			if (cardinality > entity_array_max)
+			{
+				result.type = entity_container::kind::bitmap;
+				result.words.assign(words, words + entity_bitmap_words);
+				return result;
+			}
+			result.values.resize(cardinality);
+			std::size_t out = 0;
+			for (std::size_t i = 0; i < entity_bitmap_words; ++i)
+			{
+				for (auto word = words[i]; word; word &= word - 1)
+					result.values[out++] = static_cast<std::uint16_t>(i * 64 + std::countr_zero(word));
+			}
+			return result;
+		}
+
+		inline entity_container container_from_words(std::uint64_t const* words) { return container_from_words(words, count_words(words)); }
+
+		inline entity_container container_from_array(std::vector<std::uint16_t> values) noexcept
+		{
+			entity_container result;
+			result.cardinality = static_cast<std::uint32_t>(values.size());
+			result.values = std::move(values);
+			return result;
+		}
+
+		/// Run containers are only made by `container_optimize`; they go back to array or bitmap form before being modified
+		inline void container_make_mutable(entity_container& c)
+		{
+			if (c.type != entity_container::kind::run) return;
+			entity_words scratch;
+			c = container_from_words(container_words(c, scratch));
+		}
+
+		inline bool container_add(entity_container& c, std::uint16_t value)
+		{
+			container_make_mutable(c);
+			if (c.type == entity_container::kind::array)
+			{
+				const auto it = std::lower_bound(c.values.begin(), c.values.end(), value);
+				if (it != c.values.end() && *it == value) return false;
+				if (c.cardinality < entity_array_max)
+				{
+					c.values.insert(it, value);
+					++c.cardinality;
+					return true;
+				}
+				entity_words scratch;
+				container_words(c, scratch);
+				c.words.assign(scratch.begin(), scratch.end());
+				c.values = {};
+				c.type = entity_container::kind::bitmap;
+			}
+			auto& word = c.words[value / 64];
+			const auto bit = 1ull << (value % 64);
+			if (word & bit) return false;
+			word |= bit;
+			++c.cardinality;
+			return true;
+		}
+
+		inline bool container_remove(entity_container& c, std::uint16_t value)
+		{
+			container_make_mutable(c);
+			if (c.type == entity_container::kind::array)
+			{
+				const auto it = std::lower_bound(c.values.begin(), c.values.end(), value);
+				if (it == c.values.end() || *it != value) return false;
+				c.values.erase(it);
+				--c.cardinality;
+				return true;
+			}
+			auto& word = c.words[value / 64];
+			const auto bit = 1ull << (value % 64);
+			if (!(word & bit)) return false;
+			word &= ~bit;
+			if (--c.cardinality <= entity_array_max)
+				c = container_from_words(c.words.data());
+			return true;
+		}
+
+		template <typename OP>
+		std::uint32_t combine_words_scalar(std::uint64_t const* a, std::uint64_t const* b, std::uint64_t* out, OP op) noexcept
+		{
+			std::uint32_t cardinality = 0;
+			for (std::size_t i = 0; i < entity_bitmap_words; ++i)
+			{
+				out[i] = op(a[i], b[i]);
+				cardinality += static_cast<std::uint32_t>(std::popcount(out[i]));
+			}
+			return cardinality;
+		}
+
+#if defined(GHASSANPL_X86)
+		/// The same loop, but vectorized and with a hardware popcount
+		template <typename OP>
+		GHASSANPL_TARGET("avx2,popcnt") std::uint32_t combine_words_avx2(std::uint64_t const* a, std::uint64_t const* b, std::uint64_t* out, OP op) noexcept
+		{
+			std::uint32_t cardinality = 0;
+			for (std::size_t i = 0; i < entity_bitmap_words; ++i)
+			{
+				out[i] = op(a[i], b[i]);
+				cardinality += static_cast<std::uint32_t>(std::popcount(out[i]));
+			}
+			return cardinality;
+		}
+#endif
+
+		/// Combines two containers a word at a time; only operands that aren't bitmaps are decoded first
+		template <typename OP>
+		entity_container container_combine_words(entity_container const& a, entity_container const& b, OP op)
+		{
+			entity_words scratch_a, scratch_b;
+			const auto wa = container_words(a, scratch_a), wb = container_words(b, scratch_b);
+			entity_container result;
+			result.words.resize(entity_bitmap_words);
+#if defined(GHASSANPL_X86)
+			if (get_cpu_features().avx2)
+				result.cardinality = combine_words_avx2(wa, wb, result.words.data(), op);
+			else
+#endif
+				result.cardinality = combine_words_scalar(wa, wb, result.words.data(), op);
+			if (result.cardinality > entity_array_max)
+			{
+				result.type = entity_container::kind::bitmap;
+				return result;
+			}
+			return container_from_words(result.words.data(), result.cardinality);
+		}
+
+		/// Keeps the values of `a` that are (or, if `!KEEP_CONTAINED`, aren't) in `b`. Small inputs are merged; larger ones
+		/// are compared through a scratch bitmap of `b`, since scattering bits and probing them don't depend on each other
+		/// the way the steps of a merge do. Both are branchless: every value is written, but the output cursor only
+		/// advances when it belongs in the result.
+		template <bool KEEP_CONTAINED>
+		std::vector<std::uint16_t> filter_arrays(std::vector<std::uint16_t> const& a, std::vector<std::uint16_t> const& b)
+		{
+			std::vector<std::uint16_t> result(a.size());
+			std::size_t found = 0;
+			if (b.size() < 64)
+			{
+				std::size_t i = 0, j = 0;
+				while (i < a.size() && j < b.size())
+				{
+					const auto x = a[i], y = b[j];
+					result[found] = x;
+					found += KEEP_CONTAINED ? x == y : x < y;
+					i += x <= y;
+					j += y <= x;
+				}
+				if constexpr (!KEEP_CONTAINED)
+					while (i < a.size()) result[found++] = a[i++];
+			}
+			else
+			{
+				entity_words bits{};
+				for (auto v : b) bits[v / 64] |= 1ull << (v % 64);
+				for (auto v : a)
+				{
+					result[found] = v;
+					found += (((bits[v / 64] >> (v % 64)) & 1) != 0) == KEEP_CONTAINED;
+				}
+			}
+			result.resize(found);
+			return result;
+		}
+
+		/// Gallops through `large` when it is much bigger than `small`
+		inline std::vector<std::uint16_t> intersect_arrays(std::vector<std::uint16_t> const& small, std::vector<std::uint16_t> const& large)
+		{
+			if (small.size() * 64 >= large.size())
+				return filter_arrays<true>(small, large);
+			std::vector<std::uint16_t> result;
+			result.reserve(small.size());
+			auto it = large.begin();
+			for (auto v : small)
+			{
+				it = std::lower_bound(it, large.end(), v);
+				if (it == large.end()) break;
+				if (*it == v) result.push_back(v);
+			}
+			return result;
+		}
+
+		/// Keeps the values of an array container that are (or, if `!KEEP_CONTAINED`, aren't) in `other`
+		template <bool KEEP_CONTAINED>
+		entity_container filter_array(entity_container const& array, entity_container const& other)
+		{
+			std::vector<std::uint16_t> values(array.cardinality);
+			std::size_t found = 0;
+			if (other.type == entity_container::kind::bitmap)
+			{
+				for (auto v : array.values)
+				{
+					values[found] = v;
+					found += (((other.words[v / 64] >> (v % 64)) & 1) != 0) == KEEP_CONTAINED;
+				}
+			}
+			else
+			{
+				for (auto v : array.values)
+				{
+					values[found] = v;
+					found += container_contains(other, v) == KEEP_CONTAINED;
+				}
+			}
+			values.resize(found);
+			return container_from_array(std::move(values));
+		}
+
+		inline entity_container container_and(entity_container const& a, entity_container const& b)
+		{
+			constexpr auto array = entity_container::kind::array;
+			if (a.type == array && b.type == array)
+				return container_from_array(a.cardinality <= b.cardinality ? intersect_arrays(a.values, b.values) : intersect_arrays(b.values, a.values));
+			if (a.type == array) return filter_array<true>(a, b);
+			if (b.type == array) return filter_array<true>(b, a);
+			return container_combine_words(a, b, [](std::uint64_t x, std::uint64_t y) { return x & y; });
+		}
+
+		inline entity_container container_or(entity_container const& a, entity_container const& b)
+		{
+			if (a.type == entity_container::kind::array && b.type == entity_container::kind::array && a.cardinality + b.cardinality <= entity_array_max)
+			{
+				std::vector<std::uint16_t> values;
+				values.reserve(a.cardinality + b.cardinality);
+				std::set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), std::back_inserter(values));
+				return container_from_array(std::move(values));
+			}
+			return container_combine_words(a, b, [](std::uint64_t x, std::uint64_t y) { return x | y; });
+		}
+
+		inline entity_container container_andnot(entity_container const& a, entity_container const& b)
+		{
+			if (a.type == entity_container::kind::array && b.type == entity_container::kind::array)
+				return container_from_array(filter_arrays<false>(a.values, b.values));
+			if (a.type == entity_container::kind::array) return filter_array<false>(a, b);
+			return container_combine_words(a, b, [](std::uint64_t x, std::uint64_t y) { return x & ~y; });
+		}
+
+		/// Converts the container to runs if that is its smallest form (4 bytes per run, vs 2 per value or 8 KiB)
+		inline void container_optimize(entity_container& c)
+		{
+			container_make_mutable(c);
+			entity_words scratch;
+			const auto words = container_words(c, scratch);
+			std::size_t runs = 0;
+			for (std::size_t i = 0; i < entity_bitmap_words; ++i)
+			{
+				const auto previous_top = i > 0 ? words[i - 1] >> 63 : 0;
+				runs += static_cast<std::size_t>(std::popcount(words[i] & ~((words[i] << 1) | previous_top)));
+			}
+			const auto current_bytes = c.type == entity_container::kind::array ? c.cardinality * 2 : entity_bitmap_words * 8;
+			if (runs * 4 >= current_bytes) return;
+
+			std::vector<std::uint16_t> values;
+			values.reserve(runs * 2);
+			std::uint32_t start = 0;
+			bool in_run = false;
+			for (std::uint32_t v = 0; v < 65536; ++v)
+			{
+				const bool is_set = (words[v / 64] >> (v % 64)) & 1;
+				if (is_set && !in_run) start = v;
+				else if (!is_set && in_run) { values.push_back(std::uint16_t(start)); values.push_back(std::uint16_t(v - 1 - start)); }
+				in_run = is_set;
+			}
+			if (in_run) { values.push_back(std::uint16_t(start)); values.push_back(std::uint16_t(65535 - start)); }
+			c.type = entity_container::kind::run;
+			c.values = std::move(values);
+			c.words = {};
+		}
+
+		inline std::size_t container_bytes(entity_container const& c) noexcept
+		{
+			return c.values.capacity() * sizeof(std::uint16_t) + c.words.capacity() * sizeof(std::uint64_t);
+		}
+	}
+
+	/// A compressed set of entity IDs
+	struct flag_entity_bitmap
+	{
+		flag_entity_bitmap() noexcept = default;
+
+		/// Returns true if `id` was not in the set
+		bool add(flag_entity_id id)
+		{
+			const auto key = static_cast<std::uint16_t>(id >> 16);
+			const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+			const auto index = static_cast<std::size_t>(it - keys.begin());
+			if (it == keys.end() || *it != key)
+			{
+				keys.insert(it, key);
+				containers.insert(containers.begin() + index, detail::entity_container{});
+			}
+			return detail::container_add(containers[index], static_cast<std::uint16_t>(id));
+		}
+
+		/// Returns true if `id` was in the set
+		bool remove(flag_entity_id id)
+		{
+			const auto index = find(static_cast<std::uint16_t>(id >> 16));
+			if (index == npos || !detail::container_remove(containers[index], static_cast<std::uint16_t>(id)))
+				return false;
+			if (containers[index].cardinality == 0)
+			{
+				keys.erase(keys.begin() + index);
+				containers.erase(containers.begin() + index);
+			}
+			return true;
+		}
+
+		[[nodiscard]]
+		bool contains(flag_entity_id id) const noexcept
+		{
+			const auto index = find(static_cast<std::uint16_t>(id >> 16));
+			return index != npos && detail::container_contains(containers[index], static_cast<std::uint16_t>(id));
+		}
+
+		[[nodiscard]]
+		std::size_t cardinality() const noexcept
+		{
+			std::size_t result = 0;
+			for (auto const& c : containers) result += c.cardinality;
+			return result;
+		}
+
+		[[nodiscard]] bool empty() const noexcept { return keys.empty(); }
+		void clear() noexcept { keys.clear(); containers.clear(); }
+
+		/// Bytes of container storage, for measuring compression
+		[[nodiscard]]
+		std::size_t memory_usage() const noexcept
+		{
+			std::size_t result = keys.capacity() * sizeof(std::uint16_t) + containers.capacity() * sizeof(detail::entity_container);
+			for (auto const& c : containers) result += detail::container_bytes(c);
+			return result;
+		}
+
+		/// Converts containers to run form where that is smaller. Modifying a run container converts it back.
+		void optimize()
+		{
+			for (auto& c : containers) detail::container_optimize(c);
+		}
+
+		/// Calls `callback(flag_entity_id)` for every ID in the set, in increasing order
+		template <typename FUNC>
+		void for_each(FUNC&& callback) const
+		{
+			for (std::size_t i = 0; i < keys.size(); ++i)
+			{
+				const auto high = static_cast<flag_entity_id>(keys[i]) << 16;
+				auto const& c = containers[i];
+				switch (c.type)
+				{
+				case detail::entity_container::kind::array:
+					for (auto v : c.values) callback(high | v);
+					break;
+				case detail::entity_container::kind::bitmap:
+					for (std::size_t w = 0; w < detail::entity_bitmap_words; ++w)
+						for (auto word = c.words[w]; word; word &= word - 1)
+							callback(high | static_cast<flag_entity_id>(w * 64 + std::countr_zero(word)));
+					break;
+				case detail::entity_container::kind::run:
+					for (std::size_t r = 0; r < c.values.size(); r += 2)
+						for (std::uint32_t v = c.values[r], last = v + c.values[r + 1]; v <= last; ++v)
+							callback(high | v);
+					break;
+				}
+			}
+		}
+
+		[[nodiscard]]
+		std::vector<flag_entity_id> to_vector() const
+		{
+			std::vector<flag_entity_id> result;
+			result.reserve(cardinality());
+			for_each([&](flag_entity_id id) { result.push_back(id); });
+			return result;
+		}
+
+		/// The set operations only visit the containers (groups of 65536 IDs) present in both operands, or in the left one for `-`
+		[[nodiscard]]
+		friend flag_entity_bitmap operator&(flag_entity_bitmap const& a, flag_entity_bitmap const& b)
+		{
+			auto const& small = a.keys.size() <= b.keys.size() ? a : b;
+			auto const& large = &small == &a ? b : a;
+			flag_entity_bitmap result;
+			for (std::size_t i = 0; i < small.keys.size(); ++i)
+			{
+				const auto j = large.find(small.keys[i]);
+				if (j != npos) result.append(small.keys[i], detail::container_and(small.containers[i], large.containers[j]));
+			}
+			return result;
+		}
+
+		[[nodiscard]]
+		friend flag_entity_bitmap operator|(flag_entity_bitmap const& a, flag_entity_bitmap const& b)
+		{
+			flag_entity_bitmap result;
+			std::size_t i = 0, j = 0;
+			while (i < a.keys.size() || j < b.keys.size())
+			{
+				if (j == b.keys.size() || (i < a.keys.size() && a.keys[i] < b.keys[j])) { result.append(a.keys[i], a.containers[i]); ++i; }
+				else if (i == a.keys.size() || b.keys[j] < a.keys[i]) { result.append(b.keys[j], b.containers[j]); ++j; }
+				else { result.append(a.keys[i], detail::container_or(a.containers[i], b.containers[j])); ++i; ++j; }
+			}
+			return result;
+		}
+
+		/// The IDs in `a` that aren't in `b`
+		[[nodiscard]]
+		friend flag_entity_bitmap operator-(flag_entity_bitmap const& a, flag_entity_bitmap const& b)
+		{
+			flag_entity_bitmap result;
+			for (std::size_t i = 0; i < a.keys.size(); ++i)
+			{
+				const auto j = b.find(a.keys[i]);
+				if (j == npos) result.append(a.keys[i], a.containers[i]);
+				else result.append(a.keys[i], detail::container_andnot(a.containers[i], b.containers[j]));
+			}
+			return result;
+		}
+
+		/// The IDs in `a` that are also in at least one of `any`. Unlike `a & (any[0] | any[1] | ...)`, this only builds
+		/// the union for the containers present in `a`.
+		[[nodiscard]]
+		friend flag_entity_bitmap intersect_any(flag_entity_bitmap const& a, std::span<flag_entity_bitmap const* const> any)
+		{
+			flag_entity_bitmap result;
+			for (std::size_t i = 0; i < a.keys.size(); ++i)
+			{
+				detail::entity_container united;
+				bool found = false;
+				for (auto other : any)
+				{
+					const auto j = other->find(a.keys[i]);
+					if (j == npos) continue;
+					united = found ? detail::container_or(united, other->containers[j]) : other->containers[j];
+					found = true;
+				}
+				if (found) result.append(a.keys[i], detail::container_and(a.containers[i], united));
+			}
+			return result;
+		}
+
+	private:
+
+		static constexpr std::size_t npos = ~std::size_t{ 0 };
+
+		std::size_t find(std::uint16_t key) const noexcept
+		{
+			const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+			return it != keys.end() && *it == key ? static_cast<std::size_t>(it - keys.begin()) : npos;
+		}
+
+		/// Keys must be appended in increasing order
+		void append(std::uint16_t key, detail::entity_container container)
+		{
+			if (container.cardinality == 0) return;
+			keys.push_back(key);
+			containers.push_back(std::move(container));
+		}
+
+		std::vector<std::uint16_t> keys;
+		std::vector<detail::entity_container> containers;
+	};
+
+	/// An inverted index of `enum_flags<ENUM, VALUE_TYPE>` values: one `flag_entity_bitmap` of entity IDs per flag.
+	/// The index doesn't store each entity's flags; keep it up to date by calling `set`/`unset`/`toggle`/`set_to`
+	/// (or `update`) alongside the changes to the entities themselves.
+	/// Bits at or above `flag_count` (e.g. undeclared ones from `from_bits`) are not indexed: mutators ignore them, no
+	/// entity has them, and queries requiring them match nothing.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct enum_flags_index
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using enum_type = ENUM;
+		using entity_id = flag_entity_id;
+		using bitmap_type = flag_entity_bitmap;
+
+		static constexpr std::size_t flag_count = detail::usable_flag_count<ENUM, VALUE_TYPE>;
+
+		enum_flags_index() noexcept = default;
+
+		/// Builds an index where the ID of each entity is its position in `flags`
+		explicit enum_flags_index(std::span<flags_type const> flags)
+		{
+			for (std::size_t i = 0; i < flags.size(); ++i)
+				insert(static_cast<entity_id>(i), flags[i]);
+			optimize();
+		}
+
+		/// Adds an entity with the given flags; an entity can be in the index with no flags set
+		void insert(entity_id id, flags_type flags = {})
+		{
+			entities.add(id);
+			set(id, flags);
+		}
+
+		void erase(entity_id id)
+		{
+			if (!entities.remove(id)) return;
+			for (auto& bitmap : by_flag) bitmap.remove(id);
+		}
+
+		[[nodiscard]] bool contains(entity_id id) const noexcept { return entities.contains(id); }
+		[[nodiscard]] std::size_t size() const noexcept { return entities.cardinality(); }
+		[[nodiscard]] bool empty() const noexcept { return entities.empty(); }
+		void clear() noexcept { entities.clear(); for (auto& bitmap : by_flag) bitmap.clear(); }
+
+		/// Setting flags on an entity that isn't in the index adds it
+		void set(entity_id id, flags_type flags)
+		{
+			flags = stored(flags);
+			if (flags) entities.add(id);
+			flags.for_each([&](enum_type flag) { by_flag[bit_of(flag)].add(id); });
+		}
+
+		void unset(entity_id id, flags_type flags)
+		{
+			stored(flags).for_each([&](enum_type flag) { by_flag[bit_of(flag)].remove(id); });
+		}
+
+		void toggle(entity_id id, flags_type flags)
+		{
+			flags = stored(flags);
+			if (flags) entities.add(id);
+			flags.for_each([&](enum_type flag) {
+				auto& bitmap = by_flag[bit_of(flag)];
+				if (!bitmap.remove(id)) bitmap.add(id);
+			});
+		}
+
+		void set_to(bool val, entity_id id, flags_type flags)
+		{
+			if (val) set(id, flags); else unset(id, flags);
+		}
+
+		/// Applies only the difference between an entity's old and new flags
+		void update(entity_id id, flags_type old_flags, flags_type new_flags)
+		{
+			unset(id, flags_type::from_bits(old_flags.bits & ~new_flags.bits));
+			set(id, flags_type::from_bits(new_flags.bits & ~old_flags.bits));
+		}
+
+		[[nodiscard]]
+		bool is_set(entity_id id, enum_type flag) const noexcept { return bit_of(flag) < flag_count && by_flag[bit_of(flag)].contains(id); }
+
+		/// Reassembles an entity's flags; this does one lookup per flag
+		[[nodiscard]]
+		flags_type flags_of(entity_id id) const noexcept
+		{
+			flags_type result;
+			for (std::size_t i = 0; i < flag_count; ++i)
+				if (by_flag[i].contains(id)) result.set(static_cast<enum_type>(i));
+			return result;
+		}
+
+		/// Empty for flags that aren't indexed
+		[[nodiscard]] bitmap_type const& entities_with(enum_type flag) const noexcept
+		{
+			static const bitmap_type no_entities;
+			return bit_of(flag) < flag_count ? by_flag[bit_of(flag)] : no_entities;
+		}
+		[[nodiscard]] bitmap_type const& all_entities() const noexcept { return entities; }
+
+		/// Returns the entities that have every flag in `all`, at least one flag in `any` (if it isn't empty), and none in `none`.
+		/// The `all` bitmaps are intersected smallest first, and the later steps only visit what is left, so the cost
+		/// follows the size of the result rather than of the index.
+		[[nodiscard]]
+		bitmap_type query(flags_type all, flags_type any = {}, flags_type none = {}) const
+		{
+			if (stored(all) != all) return {};
+			any = stored(any);
+			none = stored(none);
+			std::array<bitmap_type const*, flag_count> required{}, optional{};
+			std::size_t required_count = 0, optional_count = 0;
+			all.for_each([&](enum_type flag) { required[required_count++] = &by_flag[bit_of(flag)]; });
+			any.for_each([&](enum_type flag) { optional[optional_count++] = &by_flag[bit_of(flag)]; });
+			std::sort(required.begin(), required.begin() + required_count, [](auto a, auto b) { return a->cardinality() < b->cardinality(); });
+
+			bitmap_type result;
+			if (required_count > 0)
+			{
+				result = required_count > 1 ? *required[0] & *required[1] : *required[0];
+				for (std::size_t i = 2; i < required_count && !result.empty(); ++i)
+					result = result & *required[i];
+				if (optional_count > 0)
+					result = intersect_any(result, std::span{ optional.data(), optional_count });
+			}
+			else if (optional_count > 0)
+			{
+				for (std::size_t i = 0; i < optional_count; ++i)
+					result = result | *optional[i];
+			}
+			else
+				result = entities;
+
+			none.for_each([&](enum_type flag) {
+				if (!result.empty()) result = result - by_flag[bit_of(flag)];
+			});
+			return result;
+		}
+
+		[[nodiscard]]
+		std::size_t count(flags_type all, flags_type any = {}, flags_type none = {}) const { return query(all, any, none).cardinality(); }
+
+		/// Compresses runs of consecutive IDs; worthwhile after bulk loading
+		void optimize()
+		{
+			entities.optimize();
+			for (auto& bitmap : by_flag) bitmap.optimize();
+		}
+
+		[[nodiscard]]
+		std::size_t memory_usage() const noexcept
+		{
+			std::size_t result = entities.memory_usage();
+			for (auto const& bitmap : by_flag) result += bitmap.memory_usage();
+			return result;
+		}
+
+	private:
+
+		static constexpr std::size_t bit_of(enum_type flag) noexcept { return static_cast<std::size_t>(detail::to_underlying_type(flag)); }
+
+		using unsigned_value = std::make_unsigned_t<VALUE_TYPE>;
+		static constexpr unsigned_value stored_mask = flag_count >= CHAR_BIT * sizeof(VALUE_TYPE) ? unsigned_value(~unsigned_value{ 0 }) : unsigned_value((unsigned_value{ 1 } << flag_count) - 1);
+
+		/// `flags` without the bits that aren't indexed
+		static constexpr flags_type stored(flags_type flags) noexcept { return flags_type::from_bits(static_cast<VALUE_TYPE>(static_cast<unsigned_value>(flags.bits) & stored_mask)); }
+
+		bitmap_type entities;
+		std::array<bitmap_type, flag_count> by_flag;
+	};
+}
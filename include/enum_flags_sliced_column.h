@@ -0,0 +1,326 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags_column.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+/// A bit-sliced (bit-transposed) alternative to `enum_flags_column`: instead of one `enum_flags` value per element,
+/// it stores one dense bitmap ("plane") per flag, with bit i of plane f saying whether element i has flag f.
+/// A query that mentions two flags reads two bits per element, instead of the whole `enum_flags` value.
+/// Converting between the layouts is done 64 elements at a time with a 64x64 bit-matrix transpose.
+
+namespace ghassanpl
+{
+	/// Transposes a 64x64 bit matrix in place, where bit c of `rows[r]` is the element at row r, column c.
+	/// Swaps ever smaller off-diagonal blocks: 32x32, then 16x16, down to 1x1, each step a few shifts and masks over
+	/// 32 pairs of rows (Hacker's Delight, 7-3). The pairs of a step are runs of consecutive rows, so the inner loop
+	/// vectorizes.
+	constexpr void transpose_bits_64x64(std::span<std::uint64_t, 64> rows) noexcept
+	{
+		std::uint64_t mask = 0x00000000FFFFFFFFull;
+		for (std::size_t width = 32; width != 0; width >>= 1, mask ^= mask << width)
+		{
+			for (std::size_t block = 0; block < 64; block += 2 * width)
+			{
+				for (std::size_t k = block; k < block + width; ++k)
+				{
+					const auto t = ((rows[k] >> width) ^ rows[k + width]) & mask;
+					rows[k] ^= t << width;
+					rows[k + width] ^= t;
+				}
+			}
+		}
+	}
+
+	namespace detail
+	{
+		using sliced_word = std::uint64_t;
+		constexpr std::size_t sliced_word_bits = 64;
+		/// Words per plane combined at a time, so the intermediate matches stay in L1 while the planes are streamed
+		constexpr std::size_t sliced_chunk_words = 256;
+
+		/// Computes the match words `AND required planes AND NOT forbidden planes` of words [first, first + count) into `out`
+		inline void sliced_match(sliced_word const* const* required, std::size_t required_count, sliced_word const* const* forbidden, std::size_t forbidden_count,
+			std::size_t first, std::size_t count, sliced_word* out) noexcept
+		{
+			for (std::size_t i = 0; i < count; ++i) out[i] = ~sliced_word{ 0 };
+			for (std::size_t p = 0; p < required_count; ++p)
+			{
+				const auto plane = required[p] + first;
+				for (std::size_t i = 0; i < count; ++i) out[i] &= plane[i];
+			}
+			for (std::size_t p = 0; p < forbidden_count; ++p)
+			{
+				const auto plane = forbidden[p] + first;
+				for (std::size_t i = 0; i < count; ++i) out[i] &= ~plane[i];
+			}
+		}
+
+		/// `bit_count` is the number of valid bits; bits past it in the last word are ignored
+		inline std::size_t sliced_count_scalar(sliced_word const* const* required, std::size_t required_count, sliced_word const* const* forbidden, std::size_t forbidden_count,
+			std::size_t bit_count) noexcept
+		{
+			const auto word_count = (bit_count + sliced_word_bits - 1) / sliced_word_bits;
+			std::array<sliced_word, sliced_chunk_words> matches;
+			std::size_t found = 0;
+			for (std::size_t first = 0; first < word_count; first += sliced_chunk_words)
+			{
+				const auto count = std::min(sliced_chunk_words, word_count - first);
+				sliced_match(required, required_count, forbidden, forbidden_count, first, count, matches.data());
+				if (first + count == word_count && bit_count % sliced_word_bits)
+					matches[count - 1] &= (sliced_word{ 1 } << (bit_count % sliced_word_bits)) - 1;
+				for (std::size_t i = 0; i < count; ++i) found += static_cast<std::size_t>(std::popcount(matches[i]));
+			}
+			return found;
+		}
+
+		inline std::size_t sliced_filter_scalar(sliced_word const* const* required, std::size_t required_count, sliced_word const* const* forbidden, std::size_t forbidden_count,
+			std::size_t bit_count, flag_selection_index* out) noexcept
+		{
+			const auto word_count = (bit_count + sliced_word_bits - 1) / sliced_word_bits;
+			std::array<sliced_word, sliced_chunk_words> matches;
+			std::size_t found = 0;
+			for (std::size_t first = 0; first < word_count; first += sliced_chunk_words)
+			{
+				const auto count = std::min(sliced_chunk_words, word_count - first);
+				sliced_match(required, required_count, forbidden, forbidden_count, first, count, matches.data());
+				if (first + count == word_count && bit_count % sliced_word_bits)
+					matches[count - 1] &= (sliced_word{ 1 } << (bit_count % sliced_word_bits)) - 1;
+				for (std::size_t i = 0; i < count; ++i)
+					for (auto word = matches[i]; word; word &= word - 1)
+						out[found++] = static_cast<flag_selection_index>((first + i) * sliced_word_bits + std::countr_zero(word));
+			}
+			return found;
+		}
+
+#if defined(GHASSANPL_X86)
+		/// The same loops, vectorized and with a hardware popcount (`sliced_match` is inlined into these)
+		GHASSANPL_TARGET("avx2,popcnt") inline std::size_t sliced_count_avx2(sliced_word const* const* required, std::size_t required_count, sliced_word const* const* forbidden, std::size_t forbidden_count,
+			std::size_t bit_count) noexcept
+		{
+			return sliced_count_scalar(required, required_count, forbidden, forbidden_count, bit_count);
+		}
+
+		GHASSANPL_TARGET("avx2,bmi") inline std::size_t sliced_filter_avx2(sliced_word const* const* required, std::size_t required_count, sliced_word const* const* forbidden, std::size_t forbidden_count,
+			std::size_t bit_count, flag_selection_index* out) noexcept
+		{
+			return sliced_filter_scalar(required, required_count, forbidden, forbidden_count, bit_count, out);
+		}
+#endif
+	}
+
+	/// A column of `enum_flags` values stored as one bitmap per flag. Element accessors mirror `enum_flags`
+	/// (`get(i)` returns the whole value, `set(i, flags)` sets flags on element i, etc.), but each one touches one word
+	/// per flag, so the layout pays off for bulk queries over few flags rather than for random access to whole values.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct enum_flags_sliced_column
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using value_type = flags_type;
+		using enum_type = ENUM;
+		using index_type = flag_selection_index;
+		using selection_type = std::vector<index_type>;
+		using word_type = detail::sliced_word;
+
+		static constexpr std::size_t flag_count = detail::usable_flag_count<ENUM, VALUE_TYPE>;
+
+		enum_flags_sliced_column() noexcept = default;
+		explicit enum_flags_sliced_column(std::size_t count, flags_type value = {}) { resize(count, value); }
+
+		/// Transposes `init` 64 elements at a time, and stores the results of `tile_blocks` transposes together, so every
+		/// plane gets a whole cache line at once. Words past the last element (the capacity is rounded up) stay zero.
+		explicit enum_flags_sliced_column(std::span<flags_type const> init)
+		{
+			const auto used_words = words_for(init.size());
+			reallocate(used_words);
+			element_count = init.size();
+			std::array<std::array<std::uint64_t, 64>, tile_blocks> tiles;
+			for (std::size_t first_block = 0; first_block < used_words; first_block += tile_blocks)
+			{
+				const auto blocks = std::min(tile_blocks, used_words - first_block);
+				for (std::size_t b = 0; b < blocks; ++b)
+				{
+					const auto first = (first_block + b) * detail::sliced_word_bits;
+					const auto count = std::min(detail::sliced_word_bits, init.size() - first);
+					for (std::size_t i = 0; i < count; ++i) tiles[b][i] = static_cast<std::make_unsigned_t<VALUE_TYPE>>(init[first + i].bits);
+					for (std::size_t i = count; i < 64; ++i) tiles[b][i] = 0;
+					transpose_bits_64x64(tiles[b]);
+				}
+				for (std::size_t f = 0; f < flag_count; ++f)
+					for (std::size_t b = 0; b < blocks; ++b) planes[f * word_capacity + first_block + b] = tiles[b][f];
+			}
+		}
+
+		[[nodiscard]] std::size_t size() const noexcept { return element_count; }
+		[[nodiscard]] bool empty() const noexcept { return element_count == 0; }
+		void clear() noexcept { element_count = 0; std::fill(planes.begin(), planes.end(), word_type{ 0 }); }
+		void reserve(std::size_t count) { if (words_for(count) > word_capacity) reallocate(words_for(count)); }
+
+		void resize(std::size_t count, flags_type value = {})
+		{
+			reserve(count);
+			if (count > element_count)
+			{
+				for (std::size_t f = 0; f < flag_count; ++f)
+					if (value.is_set(f)) set_bit_range(f, element_count, count);
+			}
+			else
+			{
+				for (std::size_t f = 0; f < flag_count; ++f)
+					clear_bit_range(f, count, element_count);
+			}
+			element_count = count;
+		}
+
+		void push_back(flags_type value)
+		{
+			if (words_for(element_count + 1) > word_capacity)
+				reallocate(std::max<std::size_t>(word_capacity * 2, 1));
+			assign(element_count++, value);
+		}
+
+		/// Writes all the elements into `out`, which must have room for `size()` of them
+		void copy_to(std::span<flags_type> out) const noexcept
+		{
+			std::array<std::uint64_t, 64> rows{};
+			for (std::size_t block = 0; block < words_for(element_count); ++block)
+			{
+				for (std::size_t f = 0; f < flag_count; ++f) rows[f] = planes[f * word_capacity + block];
+				for (std::size_t f = flag_count; f < 64; ++f) rows[f] = 0;
+				transpose_bits_64x64(rows);
+				const auto first = block * detail::sliced_word_bits;
+				const auto count = std::min(detail::sliced_word_bits, element_count - first);
+				for (std::size_t i = 0; i < count; ++i) out[first + i] = flags_type::from_bits(static_cast<VALUE_TYPE>(rows[i]));
+			}
+		}
+
+		[[nodiscard]]
+		flags_type get(std::size_t index) const noexcept
+		{
+			std::make_unsigned_t<VALUE_TYPE> bits = 0;
+			for (std::size_t f = 0; f < flag_count; ++f)
+				bits |= static_cast<decltype(bits)>(static_cast<decltype(bits)>((word(f, index) >> (index % detail::sliced_word_bits)) & 1) << f);
+			return flags_type::from_bits(static_cast<VALUE_TYPE>(bits));
+		}
+		[[nodiscard]] flags_type operator[](std::size_t index) const noexcept { return get(index); }
+
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		bool is_set(std::size_t index, T flag) const noexcept { return bit_of(flag) < flag_count && ((word(bit_of(flag), index) >> (index % detail::sliced_word_bits)) & 1); }
+
+		/// Flags past `flag_count` have no plane and are ignored
+		void set(std::size_t index, flags_type flags) noexcept { for_each_stored(flags, [&](std::size_t f) { word(f, index) |= bit(index); }); }
+		void unset(std::size_t index, flags_type flags) noexcept { for_each_stored(flags, [&](std::size_t f) { word(f, index) &= ~bit(index); }); }
+		void toggle(std::size_t index, flags_type flags) noexcept { for_each_stored(flags, [&](std::size_t f) { word(f, index) ^= bit(index); }); }
+		void set_to(bool val, std::size_t index, flags_type flags) noexcept { if (val) set(index, flags); else unset(index, flags); }
+
+		/// Replaces the whole value of an element
+		void assign(std::size_t index, flags_type value) noexcept
+		{
+			for (std::size_t f = 0; f < flag_count; ++f)
+				word(f, index) = (word(f, index) & ~bit(index)) | (value.is_set(f) ? bit(index) : 0);
+		}
+
+		/// The bitmap of elements that have `flag`; bits past `size()` are zero
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		std::span<word_type const> plane(T flag) const noexcept { return { planes.data() + bit_of(flag) * word_capacity, words_for(element_count) }; }
+
+		/// Returns the number of elements that have all of `required` and none of `forbidden` set.
+		/// Only the planes of the flags in `required` and `forbidden` are read.
+		[[nodiscard]]
+		std::size_t count(flags_type required, flags_type forbidden = {}) const noexcept
+		{
+			query_planes q{ *this, required, forbidden };
+			if (q.unmatchable) return 0;
+#if defined(GHASSANPL_X86)
+			if (detail::get_cpu_features().avx2)
+				return detail::sliced_count_avx2(q.required.data(), q.required_count, q.forbidden.data(), q.forbidden_count, element_count);
+#endif
+			return detail::sliced_count_scalar(q.required.data(), q.required_count, q.forbidden.data(), q.forbidden_count, element_count);
+		}
+
+		/// Writes the indices of elements that have all of `required` and none of `forbidden` set into `out`, which must
+		/// have room for `size()` indices. Returns the number of indices written.
+		std::size_t filter(flags_type required, flags_type forbidden, std::span<index_type> out) const noexcept
+		{
+			query_planes q{ *this, required, forbidden };
+			if (q.unmatchable) return 0;
+#if defined(GHASSANPL_X86)
+			if (detail::get_cpu_features().avx2)
+				return detail::sliced_filter_avx2(q.required.data(), q.required_count, q.forbidden.data(), q.forbidden_count, element_count, out.data());
+#endif
+			return detail::sliced_filter_scalar(q.required.data(), q.required_count, q.forbidden.data(), q.forbidden_count, element_count, out.data());
+		}
+
+		[[nodiscard]]
+		selection_type filter(flags_type required, flags_type forbidden = {}) const
+		{
+			selection_type result(element_count);
+			result.resize(filter(required, forbidden, result));
+			return result;
+		}
+
+	private:
+
+		static constexpr std::size_t tile_blocks = 8;
+
+		/// Flags past `flag_count` are never stored, so requiring one matches nothing and forbidding one changes nothing
+		struct query_planes
+		{
+			std::array<word_type const*, flag_count> required{}, forbidden{};
+			std::size_t required_count = 0, forbidden_count = 0;
+			bool unmatchable = false;
+
+			query_planes(enum_flags_sliced_column const& column, flags_type required_flags, flags_type forbidden_flags) noexcept
+			{
+				required_flags.for_each([&](enum_type f) {
+					if (bit_of(f) < flag_count) required[required_count++] = column.plane_data(bit_of(f));
+					else unmatchable = true;
+				});
+				for_each_stored(forbidden_flags, [&](std::size_t f) { forbidden[forbidden_count++] = column.plane_data(f); });
+			}
+		};
+
+		template <typename FUNC>
+		static void for_each_stored(flags_type flags, FUNC&& callback) noexcept
+		{
+			flags.for_each([&](enum_type f) { if (bit_of(f) < flag_count) callback(bit_of(f)); });
+		}
+
+		template <typename T>
+		static constexpr std::size_t bit_of(T flag) noexcept { return static_cast<std::size_t>(detail::to_underlying_type(flag)); }
+		static constexpr std::size_t words_for(std::size_t count) noexcept { return (count + detail::sliced_word_bits - 1) / detail::sliced_word_bits; }
+		static constexpr word_type bit(std::size_t index) noexcept { return word_type{ 1 } << (index % detail::sliced_word_bits); }
+
+		word_type const* plane_data(std::size_t flag) const noexcept { return planes.data() + flag * word_capacity; }
+		word_type& word(std::size_t flag, std::size_t index) noexcept { return planes[flag * word_capacity + index / detail::sliced_word_bits]; }
+		word_type word(std::size_t flag, std::size_t index) const noexcept { return planes[flag * word_capacity + index / detail::sliced_word_bits]; }
+
+		/// Planes are laid out one after the other, each `new_capacity` words long. The capacity is rounded to an odd number
+		/// of cache lines, since with a power-of-two stride the same word of every plane maps to the same cache set.
+		void reallocate(std::size_t new_capacity)
+		{
+			if (new_capacity > 8) new_capacity = (new_capacity + 7) / 8 * 8 | 8;
+			std::vector<word_type> new_planes(flag_count * new_capacity);
+			const auto used = std::min(word_capacity, new_capacity);
+			for (std::size_t f = 0; f < flag_count; ++f)
+				std::copy_n(planes.begin() + f * word_capacity, used, new_planes.begin() + f * new_capacity);
+			planes = std::move(new_planes);
+			word_capacity = new_capacity;
+		}
+
+		/// Sets or clears bits [first, last) of a plane
+		void set_bit_range(std::size_t flag, std::size_t first, std::size_t last) noexcept { for (auto i = first; i < last; ++i) word(flag, i) |= bit(i); }
+		void clear_bit_range(std::size_t flag, std::size_t first, std::size_t last) noexcept { for (auto i = first; i < last; ++i) word(flag, i) &= ~bit(i); }
+
+		std::size_t element_count = 0;
+		std::size_t word_capacity = 0;
+		std::vector<word_type> planes;
+	};
+}
@@ -0,0 +1,510 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// A compact binary format for sequences of frames of `enum_flags` (e.g. one value per entity per tick), written with
+/// `enum_flags_stream_writer` and read in place (e.g. from an `enum_flags_mapped_file`) with `enum_flags_stream_reader`.
+///
+/// Every frame is stored as its XOR with the previous frame, so unchanged values cost nothing. A frame is either
+/// sparse (the number of changed values, then for each one the number of unchanged values before it and its XOR, all
+/// as LEB128 varints) or dense (the XOR of every value, at the stored width), whichever is smaller.
+/// Frames are grouped into blocks whose first frame is XORed with zeroes, so that any block can be decoded on its own;
+/// an index of block offsets at the end of the stream makes frames seekable.
+///
+/// All integers are little-endian. Layout:
+///   header  "EFST", u16 version, u16 value bits, u32 entities per frame, u32 frames per block
+///   blocks  frames, each a u8 kind (0 sparse, 1 dense) and its data
+///   index   u64 offset of every block from the start of the stream
+///   footer  u64 offset of the index, u64 frame count, "EFND"
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		inline constexpr std::array<std::byte, 4> stream_magic{ std::byte{ 'E' }, std::byte{ 'F' }, std::byte{ 'S' }, std::byte{ 'T' } };
+		inline constexpr std::array<std::byte, 4> stream_end_magic{ std::byte{ 'E' }, std::byte{ 'F' }, std::byte{ 'N' }, std::byte{ 'D' } };
+		inline constexpr std::uint16_t stream_version = 1;
+		inline constexpr std::size_t stream_header_size = 16;
+		inline constexpr std::size_t stream_footer_size = 20;
+
+		enum class stream_frame_kind : std::uint8_t { sparse, dense };
+
+		template <typename T>
+		constexpr T byteswap(T value) noexcept
+		{
+			auto bytes = std::bit_cast<std::array<std::byte, sizeof(T)>>(value);
+			for (std::size_t i = 0; i < sizeof(T) / 2; ++i) std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+			return std::bit_cast<T>(bytes);
+		}
+
+		template <typename T>
+		T load_le(std::byte const* data) noexcept
+		{
+			T value;
+			std::memcpy(&value, data, sizeof(T));
+			if constexpr (std::endian::native == std::endian::big) value = byteswap(value);
+			return value;
+		}
+
+		template <typename T>
+		void store_le(std::vector<std::byte>& out, T value)
+		{
+			if constexpr (std::endian::native == std::endian::big) value = byteswap(value);
+			const auto size = out.size();
+			out.resize(size + sizeof(T));
+			std::memcpy(out.data() + size, &value, sizeof(T));
+		}
+
+		inline void store_varint(std::vector<std::byte>& out, std::uint64_t value)
+		{
+			while (value >= 0x80)
+			{
+				out.push_back(static_cast<std::byte>(value | 0x80));
+				value >>= 7;
+			}
+			out.push_back(static_cast<std::byte>(value));
+		}
+
+		/// Advances `data`; returns false on a truncated or overlong varint
+		inline bool load_varint(std::byte const*& data, std::byte const* end, std::uint64_t& value) noexcept
+		{
+			/// Most varints here are gaps and single flags, which fit in one byte
+			if (data != end && (std::to_integer<unsigned>(*data) & 0x80) == 0)
+			{
+				value = std::to_integer<std::uint64_t>(*data++);
+				return true;
+			}
+			value = 0;
+			for (unsigned shift = 0; shift < 64 && data != end; shift += 7)
+			{
+				const auto byte = std::to_integer<std::uint64_t>(*data++);
+				value |= (byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) return true;
+			}
+			return false;
+		}
+
+		/// XORs `count` little-endian values of `STORED` bytes into `out`
+		template <std::size_t STORED, typename U>
+		void xor_dense_scalar(std::byte const* data, std::size_t count, U* out) noexcept
+		{
+			using stored_type = std::conditional_t<STORED == 1, std::uint8_t, std::conditional_t<STORED == 2, std::uint16_t, std::conditional_t<STORED == 4, std::uint32_t, std::uint64_t>>>;
+			for (std::size_t i = 0; i < count; ++i)
+				out[i] ^= static_cast<U>(load_le<stored_type>(data + i * STORED));
+		}
+
+#if defined(GHASSANPL_X86)
+		/// Dense frames are where decoding has real work to do; the loop vectorizes (with widening when the stored
+		/// values are narrower than `U`), so it's compiled for AVX2 too
+		template <std::size_t STORED, typename U>
+		GHASSANPL_TARGET("avx2") void xor_dense_avx2(std::byte const* data, std::size_t count, U* out) noexcept
+		{
+			xor_dense_scalar<STORED>(data, count, out);
+		}
+#endif
+
+		template <std::size_t STORED, typename U>
+		void xor_dense(std::byte const* data, std::size_t count, U* out) noexcept
+		{
+#if defined(GHASSANPL_X86)
+			if (get_cpu_features().avx2) return xor_dense_avx2<STORED>(data, count, out);
+#endif
+			xor_dense_scalar<STORED>(data, count, out);
+		}
+	}
+
+	/// Writes frames of `enum_flags` to a binary `std::ostream` in the format described above. The stream is complete
+	/// once `finish` (or the destructor) has written the index.
+	/// Failures are reported by `good()`, `write_frame` and `finish`: a write to `out` failed, or `entity_count` doesn't
+	/// fit the header (more than `max_entity_count`), in which case nothing is written at all.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct enum_flags_stream_writer
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+
+		static constexpr std::size_t max_entity_count = std::numeric_limits<std::uint32_t>::max();
+
+		enum_flags_stream_writer(std::ostream& out, std::size_t entity_count, std::size_t frames_per_block = 256)
+			: stream(out), block_frames(std::clamp<std::size_t>(frames_per_block, 1, std::numeric_limits<std::uint32_t>::max()))
+		{
+			if (entity_count > max_entity_count)
+			{
+				unusable = true;
+				return;
+			}
+			entities = entity_count;
+			previous.resize(entities);
+			buffer.insert(buffer.end(), detail::stream_magic.begin(), detail::stream_magic.end());
+			detail::store_le<std::uint16_t>(buffer, detail::stream_version);
+			detail::store_le<std::uint16_t>(buffer, CHAR_BIT * sizeof(VALUE_TYPE));
+			detail::store_le<std::uint32_t>(buffer, static_cast<std::uint32_t>(entities));
+			detail::store_le<std::uint32_t>(buffer, static_cast<std::uint32_t>(block_frames));
+			flush_buffer();
+		}
+
+		enum_flags_stream_writer(enum_flags_stream_writer const&) = delete;
+		enum_flags_stream_writer& operator=(enum_flags_stream_writer const&) = delete;
+
+		/// Finishes the stream if it wasn't yet; errors (including exceptions from `out`) are ignored here, so call
+		/// `finish` to know whether the stream is complete
+		~enum_flags_stream_writer()
+		{
+			if (finished || !good()) return;
+			try { finish(); }
+			catch (...) {}
+		}
+
+		/// False if the entity count was too large or a write to the stream failed
+		[[nodiscard]] bool good() const noexcept { return !unusable && !stream.fail(); }
+
+		[[nodiscard]] std::size_t entity_count() const noexcept { return entities; }
+		[[nodiscard]] std::size_t frame_count() const noexcept { return frames; }
+		[[nodiscard]] std::uint64_t bytes_written() const noexcept { return written; }
+
+		/// `frame` must hold `entity_count()` values. Returns `good()`; nothing is written if the frame is too short, or
+		/// the writer was already unusable or finished.
+		bool write_frame(std::span<flags_type const> frame)
+		{
+			if (!good() || finished || frame.size() < entities) return false;
+			if (frames % block_frames == 0)
+			{
+				block_offsets.push_back(written);
+				std::fill(previous.begin(), previous.end(), U{ 0 });
+			}
+
+			buffer.push_back(static_cast<std::byte>(detail::stream_frame_kind::sparse));
+			const auto count_at = buffer.size();
+			std::size_t changes = 0, last = 0;
+			const auto dense_size = 1 + entities * sizeof(U);
+			for (std::size_t i = 0; i < entities && buffer.size() < dense_size; ++i)
+			{
+				const auto bits = static_cast<U>(frame[i].bits);
+				if (bits == previous[i]) continue;
+				detail::store_varint(buffer, i - last);
+				detail::store_varint(buffer, static_cast<U>(bits ^ previous[i]));
+				last = i + 1;
+				++changes;
+			}
+
+			if (buffer.size() >= dense_size)
+			{
+				buffer.resize(1);
+				buffer[0] = static_cast<std::byte>(detail::stream_frame_kind::dense);
+				for (std::size_t i = 0; i < entities; ++i)
+					detail::store_le<U>(buffer, static_cast<U>(static_cast<U>(frame[i].bits) ^ previous[i]));
+			}
+			else
+			{
+				/// The change count goes before the changes, but is only known after them
+				std::vector<std::byte> count;
+				detail::store_varint(count, changes);
+				buffer.insert(buffer.begin() + static_cast<std::ptrdiff_t>(count_at), count.begin(), count.end());
+			}
+
+			for (std::size_t i = 0; i < entities; ++i) previous[i] = static_cast<U>(frame[i].bits);
+			flush_buffer();
+			++frames;
+			return good();
+		}
+
+		/// Writes the block index and footer; frames can't be written afterwards. Returns whether the whole stream was
+		/// written successfully.
+		bool finish()
+		{
+			if (finished || !good()) return good();
+			finished = true;
+			const auto index_offset = written;
+			for (auto offset : block_offsets) detail::store_le<std::uint64_t>(buffer, offset);
+			detail::store_le<std::uint64_t>(buffer, index_offset);
+			detail::store_le<std::uint64_t>(buffer, frames);
+			buffer.insert(buffer.end(), detail::stream_end_magic.begin(), detail::stream_end_magic.end());
+			flush_buffer();
+			stream.flush();
+			return good();
+		}
+
+	private:
+
+		using U = std::make_unsigned_t<VALUE_TYPE>;
+
+		std::ostream& stream;
+		std::size_t entities = 0;
+		std::size_t block_frames = 0;
+		std::uint64_t frames = 0;
+		std::uint64_t written = 0;
+		std::vector<U> previous;
+		std::vector<std::uint64_t> block_offsets;
+		std::vector<std::byte> buffer;
+		bool finished = false;
+		bool unusable = false;
+
+		void flush_buffer()
+		{
+			stream.write(reinterpret_cast<char const*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+			written += buffer.size();
+			buffer.clear();
+		}
+	};
+
+	/// Reads a stream written by `enum_flags_stream_writer` in place, decoding frames only when asked for.
+	/// Streams written with a value type up to as wide as `VALUE_TYPE` can be read. All offsets and sizes are
+	/// checked against the data, so corrupt streams make `open` or the decoding functions fail instead of reading
+	/// out of bounds.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct enum_flags_stream_reader
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+
+		/// `data` must outlive the reader. Returns `nullopt` if it isn't a complete stream readable as `VALUE_TYPE`.
+		[[nodiscard]]
+		static std::optional<enum_flags_stream_reader> open(std::span<std::byte const> data) noexcept
+		{
+			if (data.size() < detail::stream_header_size + detail::stream_footer_size) return std::nullopt;
+			const auto header = data.data();
+			const auto footer = data.data() + data.size() - detail::stream_footer_size;
+			if (!std::equal(detail::stream_magic.begin(), detail::stream_magic.end(), header)) return std::nullopt;
+			if (!std::equal(detail::stream_end_magic.begin(), detail::stream_end_magic.end(), footer + 16)) return std::nullopt;
+			if (detail::load_le<std::uint16_t>(header + 4) != detail::stream_version) return std::nullopt;
+
+			enum_flags_stream_reader reader;
+			reader.data = data;
+			reader.value_bits = detail::load_le<std::uint16_t>(header + 6);
+			reader.entities = detail::load_le<std::uint32_t>(header + 8);
+			reader.block_frames = detail::load_le<std::uint32_t>(header + 12);
+			reader.index_offset = detail::load_le<std::uint64_t>(footer);
+			reader.frames = detail::load_le<std::uint64_t>(footer + 8);
+			if (!std::has_single_bit(reader.value_bits) || reader.value_bits < 8 || reader.value_bits > CHAR_BIT * sizeof(VALUE_TYPE)) return std::nullopt;
+			if (reader.block_frames == 0) return std::nullopt;
+
+			/// Not rounded up by adding first, as a corrupt frame count could wrap around
+			const auto blocks = reader.frames / reader.block_frames + (reader.frames % reader.block_frames != 0);
+			const auto index_end = data.size() - detail::stream_footer_size;
+			if (reader.index_offset < detail::stream_header_size || reader.index_offset > index_end || (index_end - reader.index_offset) / 8 != blocks || (index_end - reader.index_offset) % 8 != 0)
+				return std::nullopt;
+			return reader;
+		}
+
+		[[nodiscard]] std::size_t entity_count() const noexcept { return entities; }
+		[[nodiscard]] std::size_t frame_count() const noexcept { return static_cast<std::size_t>(frames); }
+		[[nodiscard]] std::size_t frames_per_block() const noexcept { return block_frames; }
+		[[nodiscard]] std::size_t block_count() const noexcept { return static_cast<std::size_t>(frames / block_frames + (frames % block_frames != 0)); }
+		/// The width of the values the stream was written with
+		[[nodiscard]] std::size_t stored_value_bits() const noexcept { return value_bits; }
+
+		/// Decodes the frames of `block` in order, calling `callback(frame_index, std::span<flags_type const>)` for each.
+		/// Returns false if the block is corrupt, or if the callback returns false.
+		template <typename FUNC>
+		bool decode_block(std::size_t block, FUNC&& callback) const
+		{
+			if (block >= block_count()) return false;
+			std::vector<flags_type> frame(entities);
+			const auto first = block * block_frames;
+			const auto last = std::min(first + block_frames, frame_count());
+			auto cursor = block_start(block);
+			const auto end = block + 1 < block_count() ? block_start(block + 1) : data.data() + index_offset;
+			if (cursor == nullptr || end == nullptr || cursor > end) return false;
+			for (auto f = first; f < last; ++f)
+			{
+				if (!decode_frame(cursor, end, frame)) return false;
+				if constexpr (std::is_convertible_v<std::invoke_result_t<FUNC, std::size_t, std::span<flags_type const>>, bool>)
+				{
+					if (!callback(f, std::span<flags_type const>{ frame })) return false;
+				}
+				else
+					callback(f, std::span<flags_type const>{ frame });
+			}
+			return true;
+		}
+
+		/// Decodes every frame in order; see `decode_block`
+		template <typename FUNC>
+		bool for_each_frame(FUNC&& callback) const
+		{
+			for (std::size_t block = 0; block < block_count(); ++block)
+				if (!decode_block(block, callback)) return false;
+			return true;
+		}
+
+		/// Decodes frame `index` into `out`, which must hold `entity_count()` values, by decoding its block up to it
+		bool read_frame(std::size_t index, std::span<flags_type> out) const
+		{
+			if (index >= frame_count() || out.size() < entities) return false;
+			auto cursor = block_start(index / block_frames);
+			const auto end = data.data() + index_offset;
+			if (cursor == nullptr) return false;
+			std::fill_n(out.begin(), entities, flags_type{});
+			for (auto f = index - index % block_frames; f <= index; ++f)
+				if (!decode_frame(cursor, end, out)) return false;
+			return true;
+		}
+
+	private:
+
+		using U = std::make_unsigned_t<VALUE_TYPE>;
+
+		std::span<std::byte const> data;
+		std::size_t value_bits = 0;
+		std::size_t entities = 0;
+		std::size_t block_frames = 0;
+		std::uint64_t index_offset = 0;
+		std::uint64_t frames = 0;
+
+		enum_flags_stream_reader() noexcept = default;
+
+		std::byte const* block_start(std::size_t block) const noexcept
+		{
+			if (block >= block_count()) return nullptr;
+			const auto offset = detail::load_le<std::uint64_t>(data.data() + index_offset + block * 8);
+			return offset >= detail::stream_header_size && offset <= index_offset ? data.data() + offset : nullptr;
+		}
+
+		/// XORs the next frame into `frame`
+		bool decode_frame(std::byte const*& cursor, std::byte const* end, std::span<flags_type> frame) const noexcept
+		{
+			static_assert(sizeof(flags_type) == sizeof(U) && std::is_standard_layout_v<flags_type>);
+			const auto bits = reinterpret_cast<U*>(frame.data());
+			if (cursor == end) return false;
+			const auto kind = static_cast<detail::stream_frame_kind>(*cursor++);
+			if (kind == detail::stream_frame_kind::dense)
+			{
+				const auto stored = value_bits / CHAR_BIT;
+				if (static_cast<std::size_t>(end - cursor) / stored < entities) return false;
+				switch (stored)
+				{
+				case 1: detail::xor_dense<1>(cursor, entities, bits); break;
+				case 2: detail::xor_dense<2>(cursor, entities, bits); break;
+				case 4: detail::xor_dense<4>(cursor, entities, bits); break;
+				default: detail::xor_dense<8>(cursor, entities, bits); break;
+				}
+				cursor += entities * stored;
+				return true;
+			}
+			if (kind != detail::stream_frame_kind::sparse) return false;
+
+			std::uint64_t changes = 0, gap = 0, value = 0;
+			if (!detail::load_varint(cursor, end, changes) || changes > entities) return false;
+			const auto max_value = value_bits == 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << value_bits) - 1;
+			std::size_t position = 0;
+			for (std::uint64_t c = 0; c < changes; ++c)
+			{
+				if (!detail::load_varint(cursor, end, gap) || !detail::load_varint(cursor, end, value)) return false;
+				if (gap >= entities - position || value > max_value) return false;
+				position += static_cast<std::size_t>(gap);
+				bits[position++] ^= static_cast<U>(value);
+			}
+			return true;
+		}
+	};
+
+	/// A read-only memory mapping of a whole file, e.g. for an `enum_flags_stream_reader`
+	struct enum_flags_mapped_file
+	{
+		/// Returns `nullopt` if the file can't be opened or mapped
+		[[nodiscard]]
+		static std::optional<enum_flags_mapped_file> open(std::filesystem::path const& path) noexcept
+		{
+			enum_flags_mapped_file file;
+#if defined(_WIN32)
+			const auto handle = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (handle == INVALID_HANDLE_VALUE) return std::nullopt;
+			LARGE_INTEGER size{};
+			if (::GetFileSizeEx(handle, &size) && size.QuadPart > 0)
+			{
+				if (const auto mapping = ::CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr))
+				{
+					file.address = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					::CloseHandle(mapping);
+				}
+				file.length = static_cast<std::size_t>(size.QuadPart);
+			}
+			::CloseHandle(handle);
+			if (size.QuadPart > 0 && file.address == nullptr) return std::nullopt;
+#else
+			const auto fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return std::nullopt;
+			struct stat info {};
+			if (::fstat(fd, &info) != 0) { ::close(fd); return std::nullopt; }
+			if (info.st_size > 0)
+			{
+				const auto address = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (address != MAP_FAILED)
+				{
+					file.address = address;
+					file.length = static_cast<std::size_t>(info.st_size);
+				}
+			}
+			::close(fd);
+			if (info.st_size > 0 && file.address == nullptr) return std::nullopt;
+#endif
+			return file;
+		}
+
+		enum_flags_mapped_file(enum_flags_mapped_file&& other) noexcept : address(std::exchange(other.address, nullptr)), length(std::exchange(other.length, 0)) {}
+		enum_flags_mapped_file& operator=(enum_flags_mapped_file&& other) noexcept
+		{
+			if (this != &other)
+			{
+				unmap();
+				address = std::exchange(other.address, nullptr);
+				length = std::exchange(other.length, 0);
+			}
+			return *this;
+		}
+		~enum_flags_mapped_file() { unmap(); }
+
+		[[nodiscard]]
+		std::span<std::byte const> bytes() const noexcept { return { static_cast<std::byte const*>(address), length }; }
+
+	private:
+
+		void* address = nullptr;
+		std::size_t length = 0;
+
+		enum_flags_mapped_file() noexcept = default;
+
+		void unmap() noexcept
+		{
+			if (address == nullptr) return;
+#if defined(_WIN32)
+			::UnmapViewOfFile(address);
+#else
+			::munmap(address, length);
+#endif
+			address = nullptr;
+		}
+	};
+}
@@ -0,0 +1,315 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <version>
+#if __has_include(<format>)
+#include <format>
+#endif
+
+/// Conversion of `enum_flags` to and from text like "Read|Write|Exec".
+/// Enumerator names are extracted at compile time from the compiler's pretty function name, so they need no
+/// hand-written tables. This requires an enum with a fixed underlying type (e.g. any `enum class`) so that every
+/// bit index is a valid value. Bits without a named enumerator are written (and parsed) as their decimal bit index.
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		template <auto VALUE>
+		constexpr std::string_view enumerator_signature() noexcept
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			return __FUNCSIG__;
+#else
+			return __PRETTY_FUNCTION__;
+#endif
+		}
+
+		/// Returns an empty view if `VALUE` isn't a named enumerator
+		template <auto VALUE>
+		constexpr std::string_view enumerator_name() noexcept
+		{
+			constexpr auto signature = enumerator_signature<VALUE>();
+#if defined(_MSC_VER) && !defined(__clang__)
+			/// ...enumerator_signature<Namespace::Enum::Name>(void) noexcept
+			constexpr auto start = signature.find("enumerator_signature<") + 21;
+			constexpr auto end = signature.rfind(">(void)");
+#else
+			/// ...enumerator_signature() [with auto VALUE = Namespace::Enum::Name] (GCC), or [VALUE = Namespace::Enum::Name] (Clang)
+			constexpr auto start = signature.find("VALUE = ") + 8;
+			constexpr auto end = signature.find_first_of(";]", start);
+#endif
+			auto name = signature.substr(start, end - start);
+			/// Values without an enumerator are printed as casts, e.g. `(Namespace::Enum)3`
+			if (name.empty() || name[0] == '(' || name[0] == '-' || (name[0] >= '0' && name[0] <= '9'))
+				return {};
+			if (const auto colons = name.rfind("::"); colons != std::string_view::npos)
+				name.remove_prefix(colons + 2);
+			return name;
+		}
+
+		template <typename ENUM, std::size_t COUNT>
+		constexpr std::size_t total_name_length = []<std::size_t... I>(std::index_sequence<I...>) {
+			return (enumerator_name<static_cast<ENUM>(I)>().size() + ... + 0);
+		}(std::make_index_sequence<COUNT>{});
+
+		/// Hashes a name by its length and its first, middle and last characters, which together are almost always
+		/// enough to tell the enumerators of one enum apart
+		constexpr std::uint32_t flag_name_hash(std::string_view text, std::uint32_t seed) noexcept
+		{
+			auto h = seed ^ static_cast<std::uint32_t>(text.size());
+			h = (h ^ static_cast<unsigned char>(text[0])) * 0x9E3779B1u;
+			h = (h ^ static_cast<unsigned char>(text[text.size() / 2])) * 0x9E3779B1u;
+			h = (h ^ static_cast<unsigned char>(text[text.size() - 1])) * 0x9E3779B1u;
+			return h ^ (h >> 15);
+		}
+
+		/// All the enumerator names of an enum, packed into one character array, plus an open-addressing hash table
+		/// for parsing. The hash seed is searched for at compile time so that (nearly always) every name lands in its
+		/// own slot, making a lookup one hash, one probe and one comparison.
+		template <typename ENUM, std::size_t COUNT>
+		struct flag_name_table
+		{
+			static constexpr std::size_t chars_size = total_name_length<ENUM, COUNT>;
+			static constexpr std::size_t slot_count = std::bit_ceil(COUNT * 2);
+			static constexpr std::uint8_t empty_slot = 0xFF;
+			static constexpr std::uint32_t max_seed_attempts = 4096;
+
+			std::array<char, chars_size + 1> chars{};
+			std::array<std::uint16_t, COUNT + 1> offsets{};
+			std::array<std::uint8_t, slot_count> slots{};
+			std::uint32_t seed = 0;
+
+			constexpr std::string_view name(std::size_t bit) const noexcept { return { chars.data() + offsets[bit], std::size_t(offsets[bit + 1] - offsets[bit]) }; }
+
+			constexpr std::size_t slot_of(std::string_view text, std::uint32_t with_seed) const noexcept { return flag_name_hash(text, with_seed) & (slot_count - 1); }
+
+			constexpr flag_name_table() noexcept
+			{
+				std::array<std::string_view, COUNT> names{};
+				[&]<std::size_t... I>(std::index_sequence<I...>) {
+					((names[I] = enumerator_name<static_cast<ENUM>(I)>()), ...);
+				}(std::make_index_sequence<COUNT>{});
+
+				std::size_t offset = 0;
+				for (std::size_t i = 0; i < COUNT; ++i)
+				{
+					offsets[i] = static_cast<std::uint16_t>(offset);
+					for (auto c : names[i]) chars[offset++] = c;
+				}
+				offsets[COUNT] = static_cast<std::uint16_t>(offset);
+
+				/// Find a collision-free seed; if there is none, the last one tried is kept and collisions are resolved by
+				/// linear probing, which stays correct, just slower
+				for (seed = 0; seed < max_seed_attempts; ++seed)
+				{
+					std::array<bool, slot_count> taken{};
+					bool collided = false;
+					for (std::size_t i = 0; i < COUNT && !collided; ++i)
+					{
+						if (names[i].empty()) continue;
+						auto& slot = taken[slot_of(names[i], seed)];
+						collided = slot;
+						slot = true;
+					}
+					if (!collided) break;
+				}
+				seed = std::min(seed, max_seed_attempts - 1);
+
+				slots.fill(empty_slot);
+				for (std::size_t i = 0; i < COUNT; ++i)
+				{
+					if (names[i].empty()) continue;
+					auto slot = slot_of(names[i], seed);
+					while (slots[slot] != empty_slot) slot = (slot + 1) & (slot_count - 1);
+					slots[slot] = static_cast<std::uint8_t>(i);
+				}
+			}
+
+			/// Returns the bit index of the enumerator named `text`, or -1
+			constexpr int find(std::string_view text) const noexcept
+			{
+				if (text.empty()) return -1;
+				for (auto slot = slot_of(text, seed); slots[slot] != empty_slot; slot = (slot + 1) & (slot_count - 1))
+				{
+					if (name(slots[slot]) == text)
+						return slots[slot];
+				}
+				return -1;
+			}
+		};
+
+		template <typename ENUM, typename VALUE_TYPE>
+		inline constexpr flag_name_table<ENUM, usable_flag_count<ENUM, VALUE_TYPE>> flag_names{};
+
+		constexpr bool is_flag_text_space(char c) noexcept { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+		/// Finds the next `separator` (or `last`), eight characters at a time on little-endian targets outside of
+		/// constant evaluation. The zero-byte test can misfire only on bytes *after* a real match, so the lowest
+		/// flagged byte is always the right one.
+		constexpr char const* find_flag_separator(char const* first, char const* last, char separator) noexcept
+		{
+			if (std::endian::native == std::endian::little && !std::is_constant_evaluated())
+			{
+				constexpr std::uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+				const auto pattern = ones * static_cast<unsigned char>(separator);
+				for (; last - first >= 8; first += 8)
+				{
+					std::uint64_t word;
+					std::memcpy(&word, first, sizeof(word));
+					const auto x = word ^ pattern;
+					if (const auto zeroes = (x - ones) & ~x & highs)
+						return first + std::countr_zero(zeroes) / CHAR_BIT;
+				}
+			}
+			while (first != last && *first != separator) ++first;
+			return first;
+		}
+	}
+
+	/// Returns the name of `flag`, or an empty view if it has no named enumerator
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	requires std::is_enum_v<ENUM>
+	[[nodiscard]]
+	constexpr std::string_view flag_name(ENUM flag) noexcept
+	{
+		constexpr auto& names = detail::flag_names<ENUM, VALUE_TYPE>;
+		const auto bit = static_cast<std::size_t>(detail::to_underlying_type(flag));
+		return bit < detail::usable_flag_count<ENUM, VALUE_TYPE> ? names.name(bit) : std::string_view{};
+	}
+
+	/// The largest number of characters `to_chars` can write for this type of flags
+	template <typename FLAGS>
+	inline constexpr std::size_t max_flags_chars = [] {
+		constexpr auto& names = detail::flag_names<typename FLAGS::enum_type, typename FLAGS::value_type>;
+		constexpr auto count = detail::usable_flag_count<typename FLAGS::enum_type, typename FLAGS::value_type>;
+		std::size_t result = 0;
+		for (std::size_t i = 0; i < CHAR_BIT * sizeof(typename FLAGS::value_type); ++i)
+			result += (i < count && !names.name(i).empty() ? names.name(i).size() : (i < 10 ? 1 : 2)) + 1;
+		return result;
+	}();
+
+	/// Writes the names of the set flags, separated by `separator`, into [first, last).
+	/// Does not allocate. On failure returns `{ last, std::errc::value_too_large }`, like `std::to_chars`.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	requires std::is_enum_v<ENUM>
+	constexpr std::to_chars_result to_chars(char* first, char* last, enum_flags<ENUM, VALUE_TYPE> flags, char separator = '|') noexcept
+	{
+		constexpr auto& names = detail::flag_names<ENUM, VALUE_TYPE>;
+		bool first_flag = true;
+		for (auto flag : flags)
+		{
+			if (!first_flag)
+			{
+				if (first == last) return { last, std::errc::value_too_large };
+				*first++ = separator;
+			}
+			first_flag = false;
+
+			const auto bit = static_cast<std::size_t>(flag);
+			const auto name = bit < names.offsets.size() - 1 ? names.name(bit) : std::string_view{};
+			if (name.empty())
+			{
+				const auto result = std::to_chars(first, last, bit);
+				if (result.ec != std::errc{}) return result;
+				first = result.ptr;
+			}
+			else
+			{
+				if (static_cast<std::size_t>(last - first) < name.size()) return { last, std::errc::value_too_large };
+				for (auto c : name) *first++ = c;
+			}
+		}
+		return { first, std::errc{} };
+	}
+
+	/// Parses names (or decimal bit indices) separated by `separator` from [first, last) into `flags`.
+	/// Whitespace around names is ignored, and empty text parses as no flags.
+	/// On an unknown name, returns `{ start of the name, std::errc::invalid_argument }` and leaves `flags` unchanged.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	requires std::is_enum_v<ENUM>
+	constexpr std::from_chars_result from_chars(char const* first, char const* last, enum_flags<ENUM, VALUE_TYPE>& flags, char separator = '|') noexcept
+	{
+		constexpr auto& names = detail::flag_names<ENUM, VALUE_TYPE>;
+		constexpr auto bit_count = CHAR_BIT * sizeof(VALUE_TYPE);
+		enum_flags<ENUM, VALUE_TYPE> result;
+		auto token_start = first;
+		while (true)
+		{
+			const auto token_end = detail::find_flag_separator(token_start, last, separator);
+
+			auto name_start = token_start, name_end = token_end;
+			while (name_start != name_end && detail::is_flag_text_space(*name_start)) ++name_start;
+			while (name_end != name_start && detail::is_flag_text_space(name_end[-1])) --name_end;
+
+			if (name_start != name_end)
+			{
+				int bit = names.find({ name_start, static_cast<std::size_t>(name_end - name_start) });
+				if (bit < 0 && *name_start >= '0' && *name_start <= '9')
+				{
+					const auto parsed = std::from_chars(name_start, name_end, bit);
+					if (parsed.ptr != name_end || static_cast<std::size_t>(bit) >= bit_count) bit = -1;
+				}
+				if (bit < 0) return { name_start, std::errc::invalid_argument };
+				result.set(bit);
+			}
+			else if (token_end != last || token_start != first)
+				return { name_start, std::errc::invalid_argument }; /// Empty name between separators
+
+			if (token_end == last) break;
+			token_start = token_end + 1;
+		}
+		flags = result;
+		return { last, std::errc{} };
+	}
+
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	requires std::is_enum_v<ENUM>
+	[[nodiscard]]
+	std::string to_string(enum_flags<ENUM, VALUE_TYPE> flags, char separator = '|')
+	{
+		std::array<char, max_flags_chars<enum_flags<ENUM, VALUE_TYPE>>> buffer;
+		const auto result = ghassanpl::to_chars(buffer.data(), buffer.data() + buffer.size(), flags, separator);
+		return std::string(buffer.data(), result.ptr);
+	}
+}
+
+#if defined(__cpp_lib_format)
+/// Formats as `to_chars` does; the format spec may contain a single character to use as the separator, e.g. `{:,}`
+template <typename ENUM, typename VALUE_TYPE>
+requires std::is_enum_v<ENUM> && ghassanpl::detail::bit_integral<VALUE_TYPE>
+struct std::formatter<ghassanpl::enum_flags<ENUM, VALUE_TYPE>, char>
+{
+	char separator = '|';
+
+	constexpr auto parse(std::format_parse_context& ctx)
+	{
+		auto it = ctx.begin();
+		if (it != ctx.end() && *it != '}')
+			separator = *it++;
+		if (it != ctx.end() && *it != '}')
+			throw std::format_error("invalid format for enum_flags");
+		return it;
+	}
+
+	template <typename FORMAT_CONTEXT>
+	auto format(ghassanpl::enum_flags<ENUM, VALUE_TYPE> flags, FORMAT_CONTEXT& ctx) const
+	{
+		std::array<char, ghassanpl::max_flags_chars<ghassanpl::enum_flags<ENUM, VALUE_TYPE>>> buffer;
+		const auto result = ghassanpl::to_chars(buffer.data(), buffer.data() + buffer.size(), flags, separator);
+		return std::copy(buffer.data(), result.ptr, ctx.out());
+	}
+};
+#endif
@@ -0,0 +1,193 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include <array>
+#include <iterator>
+#include <ranges>
+
+/// Lazy, constexpr ranges of `enum_flags` values built from a mask, in increasing order of their bits:
+///   subsets(mask)                      every sub-mask of `mask`, from none to `mask` itself
+///   subsets_of_size(mask, k)           every combination of `k` flags of `mask`
+///   supersets_within(mask, universe)   every value that contains `mask` and is contained in `universe`
+/// Every step is a handful of bit operations; nothing is allocated.
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		/// The sub-masks are computed in 64 bits for every value type, so that the carries out of the narrower types
+		/// don't need special cases
+		using subset_bits = std::uint64_t;
+
+		template <typename FLAGS>
+		constexpr subset_bits to_subset_bits(FLAGS flags) noexcept { return static_cast<std::make_unsigned_t<typename FLAGS::value_type>>(flags.bits); }
+
+		template <typename FLAGS>
+		constexpr FLAGS from_subset_bits(subset_bits bits) noexcept { return FLAGS::from_bits(static_cast<typename FLAGS::value_type>(bits)); }
+	}
+
+	/// The sub-masks of a mask, each combined with a fixed set of flags (empty for `subsets`, the lower bound for `supersets_within`)
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	struct flag_subsets_view : std::ranges::view_interface<flag_subsets_view<ENUM, VALUE_TYPE>>
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+
+		/// Steps with `(current - free) & free`, which increments `current` as if the bits outside `free` weren't there
+		struct iterator
+		{
+			using iterator_concept = std::forward_iterator_tag;
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = flags_type;
+			using difference_type = std::ptrdiff_t;
+			using reference = flags_type;
+			using pointer = void;
+
+			constexpr iterator() noexcept = default;
+			constexpr iterator(detail::subset_bits free, detail::subset_bits fixed, bool done) noexcept : free_bits(free), fixed_bits(fixed), finished(done) {}
+
+			[[nodiscard]]
+			constexpr flags_type operator*() const noexcept { return detail::from_subset_bits<flags_type>(fixed_bits | current); }
+
+			constexpr iterator& operator++() noexcept
+			{
+				finished = current == free_bits;
+				current = (current - free_bits) & free_bits;
+				return *this;
+			}
+			constexpr iterator operator++(int) noexcept { auto copy = *this; ++*this; return copy; }
+
+			constexpr bool operator==(iterator const& other) const noexcept { return current == other.current && finished == other.finished; }
+			constexpr bool operator==(std::default_sentinel_t) const noexcept { return finished; }
+
+		private:
+
+			detail::subset_bits free_bits = 0;
+			detail::subset_bits fixed_bits = 0;
+			detail::subset_bits current = 0;
+			bool finished = true;
+		};
+
+		constexpr flag_subsets_view() noexcept = default;
+		constexpr flag_subsets_view(flags_type free, flags_type fixed, bool empty = false) noexcept
+			: free_bits(detail::to_subset_bits(free)), fixed_bits(detail::to_subset_bits(fixed)), is_empty(empty) {}
+
+		[[nodiscard]] constexpr iterator begin() const noexcept { return { free_bits, fixed_bits, is_empty }; }
+		[[nodiscard]] constexpr std::default_sentinel_t end() const noexcept { return {}; }
+
+	private:
+
+		detail::subset_bits free_bits = 0;
+		detail::subset_bits fixed_bits = 0;
+		bool is_empty = true;
+	};
+
+	/// The combinations of `k` flags of a mask
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	struct flag_combinations_view : std::ranges::view_interface<flag_combinations_view<ENUM, VALUE_TYPE>>
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		static constexpr std::size_t max_flags = CHAR_BIT * sizeof(VALUE_TYPE);
+
+		/// Gosper's hack, generalized to flags that aren't adjacent: adding the lowest flag to `current | ~mask` lets the
+		/// carry skip the bits outside the mask, and clears the run of flags above it. All but one of those flags go back
+		/// to the lowest positions of the mask, which the view keeps in a table. The length of the run comes from
+		/// running the plain Gosper's hack on the flag positions (`positions`), which needs `countr_zero` instead of
+		/// the `popcount` that counting the flags in the mask would (a library call on baseline x86-64).
+		struct iterator
+		{
+			using iterator_concept = std::forward_iterator_tag;
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = flags_type;
+			using difference_type = std::ptrdiff_t;
+			using reference = flags_type;
+			using pointer = void;
+
+			constexpr iterator() noexcept = default;
+			constexpr iterator(flag_combinations_view const* view, detail::subset_bits first, detail::subset_bits first_positions) noexcept
+				: parent(view), current(first), positions(first_positions) {}
+
+			[[nodiscard]]
+			constexpr flags_type operator*() const noexcept { return detail::from_subset_bits<flags_type>(current); }
+
+			constexpr iterator& operator++() noexcept
+			{
+				const auto mask = parent->mask_bits;
+				const auto next = ((current | ~mask) + (current & (0 - current))) & mask;
+				if (next == 0 || current == 0)
+				{
+					current = 0;
+					positions = 0;
+					parent = nullptr;
+				}
+				else
+				{
+					const auto next_positions = positions + (positions & (0 - positions));
+					const auto moved_back = static_cast<std::size_t>(std::countr_zero(next_positions) - std::countr_zero(positions) - 1);
+					positions = next_positions | ((detail::subset_bits{ 1 } << moved_back) - 1);
+					current = next | parent->lowest_flags[moved_back];
+				}
+				return *this;
+			}
+			constexpr iterator operator++(int) noexcept { auto copy = *this; ++*this; return copy; }
+
+			constexpr bool operator==(iterator const& other) const noexcept { return current == other.current && (parent == nullptr) == (other.parent == nullptr); }
+			constexpr bool operator==(std::default_sentinel_t) const noexcept { return parent == nullptr; }
+
+		private:
+
+			flag_combinations_view const* parent = nullptr;
+			detail::subset_bits current = 0;
+			detail::subset_bits positions = 0;
+		};
+
+		constexpr flag_combinations_view() noexcept = default;
+		constexpr flag_combinations_view(flags_type mask, std::size_t k) noexcept : mask_bits(detail::to_subset_bits(mask)), size_k(k)
+		{
+			auto remaining = mask_bits;
+			for (std::size_t i = 1; i <= max_flags; ++i)
+			{
+				lowest_flags[i] = lowest_flags[i - 1] | (remaining & (0 - remaining));
+				remaining &= remaining - 1;
+			}
+		}
+
+		/// The view must outlive its iterators
+		[[nodiscard]]
+		constexpr iterator begin() const noexcept
+		{
+			if (size_k > static_cast<std::size_t>(std::popcount(mask_bits))) return {};
+			return { this, lowest_flags[size_k], size_k == 64 ? ~detail::subset_bits{ 0 } : (detail::subset_bits{ 1 } << size_k) - 1 };
+		}
+		[[nodiscard]] constexpr std::default_sentinel_t end() const noexcept { return {}; }
+
+	private:
+
+		detail::subset_bits mask_bits = 0;
+		std::size_t size_k = max_flags + 1;
+		/// `lowest_flags[i]` is the lowest `i` flags of the mask
+		std::array<detail::subset_bits, max_flags + 1> lowest_flags{};
+	};
+
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	[[nodiscard]]
+	constexpr flag_subsets_view<ENUM, VALUE_TYPE> subsets(enum_flags<ENUM, VALUE_TYPE> mask) noexcept { return { mask, {} }; }
+
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	[[nodiscard]]
+	constexpr flag_combinations_view<ENUM, VALUE_TYPE> subsets_of_size(enum_flags<ENUM, VALUE_TYPE> mask, std::size_t k) noexcept { return { mask, k }; }
+
+	/// Empty if `mask` has flags that aren't in `universe`
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE>
+	[[nodiscard]]
+	constexpr flag_subsets_view<ENUM, VALUE_TYPE> supersets_within(enum_flags<ENUM, VALUE_TYPE> mask, enum_flags<ENUM, VALUE_TYPE> universe) noexcept
+	{
+		return { enum_flags<ENUM, VALUE_TYPE>::from_bits(universe.bits & ~mask.bits), mask, (mask.bits & ~universe.bits) != 0 };
+	}
+}
+
+template <typename ENUM, typename VALUE_TYPE>
+inline constexpr bool std::ranges::enable_borrowed_range<ghassanpl::flag_subsets_view<ENUM, VALUE_TYPE>> = true;
@@ -24,6 +24,42 @@ namespace ghassanpl
 		concept valid_flag_bits_arguments = detail::valid_integral<RESULT_TYPE> && (detail::integral_or_enum<ENUM_TYPES> && ...);
 	}
 
+	/// The kinds of flag operations an instrumentation policy is told about
+	enum class flag_operation_kind : std::uint8_t { test, set, unset, toggle };
+
+	namespace detail
+	{
+		/// `void` is accepted as "none", so a build switch can pick between a policy and nothing
+		template <typename ENUM>
+		concept has_flag_instrumentation = requires { typename enum_flags_traits<ENUM>::instrumentation; } &&
+			!std::is_void_v<typename enum_flags_traits<ENUM>::instrumentation>;
+
+		/// Tells the instrumentation policy of `ENUM` (if any) about an operation on the flags in `mask` (the first 64)
+		template <typename ENUM, typename MASK>
+		constexpr void record_flag_mask([[maybe_unused]] flag_operation_kind op, [[maybe_unused]] MASK const& mask) noexcept
+		{
+			if constexpr (has_flag_instrumentation<ENUM> && bit_integral<MASK>)
+			{
+				if (!std::is_constant_evaluated())
+					enum_flags_traits<ENUM>::instrumentation::template record<ENUM>(op, static_cast<std::uint64_t>(static_cast<std::make_unsigned_t<MASK>>(mask)));
+			}
+		}
+
+		/// Tells the instrumentation policy of each argument's type (if any) about an operation on that flag
+		template <typename... ARGS>
+		constexpr void record_flags([[maybe_unused]] flag_operation_kind op, [[maybe_unused]] ARGS... args) noexcept
+		{
+			([&] {
+				if constexpr (has_flag_instrumentation<ARGS>)
+				{
+					const auto bit = static_cast<std::uint64_t>(to_underlying_type(args));
+					if (!std::is_constant_evaluated() && bit < 64)
+						enum_flags_traits<ARGS>::instrumentation::template record<ARGS>(op, std::uint64_t{ 1 } << bit);
+				}
+			}(), ...);
+		}
+	}
+
 	template <typename RESULT_TYPE = unsigned long long, typename... ARGS>
 	constexpr RESULT_TYPE flag_bits(ARGS... args) noexcept
 	requires detail::valid_flag_bits_arguments<RESULT_TYPE, ARGS...>
@@ -33,38 +69,45 @@ namespace ghassanpl
 
 	template <typename INTEGRAL, typename ENUM_TYPE>
 	requires detail::valid_flag_bits_arguments<INTEGRAL, ENUM_TYPE>
-	constexpr bool is_flag_set(INTEGRAL const& bits, ENUM_TYPE flag) noexcept { return (bits & flag_bits<INTEGRAL>(flag)) != 0; }
+	constexpr bool is_flag_set(INTEGRAL const& bits, ENUM_TYPE flag) noexcept
+	{
+		detail::record_flags(flag_operation_kind::test, flag);
+		return (bits & flag_bits<INTEGRAL>(flag)) != 0;
+	}
 
 	template <typename INTEGRAL, typename... ARGS>
-	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS>
+	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS...>
 	constexpr bool are_any_flags_set(INTEGRAL const& bits, ARGS... args) noexcept
 	{
+		detail::record_flags(flag_operation_kind::test, args...);
 		return (bits & flag_bits(args...)) != 0;
 	}
 
 	template <typename INTEGRAL, typename... ARGS>
-	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS>
+	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS...>
 	constexpr bool are_all_flags_set(INTEGRAL const& bits, ARGS... args) noexcept
 	{
+		detail::record_flags(flag_operation_kind::test, args...);
 		return (bits & flag_bits(args...)) == flag_bits(args...);
 	}
 
 	template <typename INTEGRAL, typename... ARGS>
-	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS>
-	constexpr void set_flags(INTEGRAL& bits, ARGS... args) noexcept { bits |= flag_bits<INTEGRAL>(args...); }
+	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS...>
+	constexpr void set_flags(INTEGRAL& bits, ARGS... args) noexcept { detail::record_flags(flag_operation_kind::set, args...); bits |= flag_bits<INTEGRAL>(args...); }
 	
 	template <typename INTEGRAL, typename... ARGS>
-	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS>
-	constexpr void unset_flags(INTEGRAL& bits, ARGS... args) noexcept { bits &= ~ flag_bits<INTEGRAL>(args...); }
+	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS...>
+	constexpr void unset_flags(INTEGRAL& bits, ARGS... args) noexcept { detail::record_flags(flag_operation_kind::unset, args...); bits &= ~ flag_bits<INTEGRAL>(args...); }
 	
 	template <typename INTEGRAL, typename... ARGS>
-	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS>
-	constexpr void toggle_flags(INTEGRAL& bits, ARGS... args) noexcept { bits ^= flag_bits<INTEGRAL>(args...); }
+	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS...>
+	constexpr void toggle_flags(INTEGRAL& bits, ARGS... args) noexcept { detail::record_flags(flag_operation_kind::toggle, args...); bits ^= flag_bits<INTEGRAL>(args...); }
 	
 	template <typename INTEGRAL, typename... ARGS>
-	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS>
+	requires detail::valid_flag_bits_arguments<INTEGRAL, ARGS...>
 	constexpr void set_flags_to(INTEGRAL& bits, bool val, ARGS... args) noexcept
 	{
+		detail::record_flags(val ? flag_operation_kind::set : flag_operation_kind::unset, args...);
 		if (val)
 			bits |= flag_bits<INTEGRAL>(args...);
 		else
@@ -6,9 +6,20 @@
 
 #include <type_traits>
 #include <concepts>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
 
 namespace ghassanpl
 {
+	/// Specialize this for an enum to declare its highest enumerator:
+	///   template <> struct ghassanpl::enum_flags_traits<MyEnum> { static constexpr MyEnum last = MyEnum::Last; };
+	/// With it, `enum_flags_for<MyEnum>` picks the smallest value type that holds all flags, `flag_bits_v` rejects
+	/// enumerators above `last`, and `enum_flags<MyEnum>::all()` only returns valid bits.
+	/// It can also declare `using instrumentation = ...;` to count the flag operations on `MyEnum` (see flag_instrumentation.h).
+	template <typename ENUM>
+	struct enum_flags_traits {};
+
 	namespace detail
 	{
 		template<typename T>
@@ -30,13 +41,50 @@ namespace ghassanpl
 		template <typename INT_TYPE, typename BIT_TYPE, BIT_TYPE BIT_NUM>
 		concept allowed_bit_num = BIT_NUM >= 0 && BIT_NUM < CHAR_BIT * sizeof(INT_TYPE);
 
+		template <typename ENUM>
+		concept has_declared_last_flag = requires { { enum_flags_traits<ENUM>::last } -> std::convertible_to<ENUM>; };
+
+		template <auto VALUE>
+		concept within_declared_flags = !has_declared_last_flag<decltype(VALUE)> ||
+			(detail::to_underlying_type(VALUE) <= detail::to_underlying_type(enum_flags_traits<decltype(VALUE)>::last));
+
+		template <std::size_t BIT_COUNT>
+		requires (BIT_COUNT <= 64)
+		using smallest_flag_value_type =
+			std::conditional_t<BIT_COUNT <= 8, std::uint8_t,
+			std::conditional_t<BIT_COUNT <= 16, std::uint16_t,
+			std::conditional_t<BIT_COUNT <= 32, std::uint32_t, std::uint64_t>>>;
+
 		template <typename RESULT_TYPE, auto... VALUES>
 		concept valid_flag_bits_v_arguments =
 			 detail::bit_integral<RESULT_TYPE> &&
 			(detail::integral_or_enum<decltype(VALUES)> && ...) &&
-			(detail::allowed_bit_num<RESULT_TYPE, decltype(detail::to_underlying_type(VALUES)), static_cast<decltype(detail::to_underlying_type(VALUES))>(VALUES)> && ...);
+			(detail::allowed_bit_num<RESULT_TYPE, decltype(detail::to_underlying_type(VALUES)), static_cast<decltype(detail::to_underlying_type(VALUES))>(VALUES)> && ...) &&
+			(detail::within_declared_flags<VALUES> && ...);
 	}
 
+	/// Number of flags in an enum with a declared last enumerator (see `enum_flags_traits`)
+	template <typename ENUM>
+	requires detail::has_declared_last_flag<ENUM>
+	inline constexpr std::size_t declared_flag_count = static_cast<std::size_t>(detail::to_underlying_type(enum_flags_traits<ENUM>::last)) + 1;
+
+	namespace detail
+	{
+		/// The number of flags a `VALUE_TYPE` holding `ENUM` flags can have: the declared count if there is one, the bit width otherwise
+		template <typename ENUM, typename VALUE_TYPE>
+		constexpr std::size_t usable_flag_count = []{
+			if constexpr (has_declared_last_flag<ENUM>)
+				return declared_flag_count<ENUM> < CHAR_BIT * sizeof(VALUE_TYPE) ? declared_flag_count<ENUM> : CHAR_BIT * sizeof(VALUE_TYPE);
+			else
+				return CHAR_BIT * sizeof(VALUE_TYPE);
+		}();
+	}
+
+	/// The smallest unsigned integer type that can hold all the flags of `ENUM`
+	template <typename ENUM>
+	requires detail::has_declared_last_flag<ENUM>
+	using flag_value_type_for = detail::smallest_flag_value_type<declared_flag_count<ENUM>>;
+
 	template <typename RESULT_TYPE, auto... VALUES> 
 	requires detail::valid_flag_bits_v_arguments<RESULT_TYPE, VALUES...>
 	inline constexpr RESULT_TYPE flag_bits_v = ((RESULT_TYPE(1) << (detail::to_underlying_type(VALUES))) | ... | 0);
@@ -0,0 +1,353 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags_string.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <ostream>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Counters of how often each flag of an enum is tested, set, unset and toggled, and from where, to find the hot and
+/// cold flags of a real workload. Instrumentation is opt-in per enum, through its `enum_flags_traits`:
+///
+///   template <> struct ghassanpl::enum_flags_traits<MyEnum> { using instrumentation = ghassanpl::flag_counting_instrumentation; };
+///
+/// after which every `enum_flags<MyEnum>` operation and every `flag_bits.h` function called with `MyEnum` flags is
+/// counted. Enums without it (or with `using instrumentation = void;`) compile to exactly the code they did before.
+///
+/// Each thread counts into blocks of its own, so counting is a plain load and store with no locked instruction or
+/// shared cache line. The blocks are published to a global lock-free list when created and never freed, so a report
+/// (or the dump at exit) sums the counts of all threads, including those that already exited.
+/// Only the first 64 flags of an enum are counted.
+
+namespace ghassanpl
+{
+	/// Attributes the flag operations of this thread to a call site for as long as it lives, when the enum uses
+	/// `flag_site_counting_instrumentation`. Sites nest; the innermost one counts.
+	///
+	///   flag_instrumentation_site site; /// defaults to the location of this line
+	struct flag_instrumentation_site
+	{
+		explicit flag_instrumentation_site(std::source_location location = std::source_location::current()) noexcept
+			: location(location), previous(current)
+		{
+			current = this;
+		}
+		~flag_instrumentation_site() { current = previous; }
+
+		flag_instrumentation_site(flag_instrumentation_site const&) = delete;
+		flag_instrumentation_site& operator=(flag_instrumentation_site const&) = delete;
+
+		std::source_location const location;
+
+		[[nodiscard]] static flag_instrumentation_site const* innermost() noexcept { return current; }
+
+	private:
+
+		flag_instrumentation_site const* const previous;
+		static inline thread_local flag_instrumentation_site const* current = nullptr;
+	};
+
+	namespace detail
+	{
+		inline constexpr std::size_t instrumented_flag_count = 64;
+		inline constexpr std::size_t flag_operation_count = 4;
+
+		template <typename T>
+		constexpr std::string_view type_signature() noexcept
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			return __FUNCSIG__;
+#else
+			return __PRETTY_FUNCTION__;
+#endif
+		}
+
+		template <typename T>
+		constexpr std::string_view instrumented_type_name() noexcept
+		{
+			constexpr auto signature = type_signature<T>();
+#if defined(_MSC_VER) && !defined(__clang__)
+			/// ...type_signature<enum Namespace::Enum>(void) noexcept
+			constexpr auto start = signature.find("type_signature<") + 15;
+			constexpr auto end = signature.rfind(">(void)");
+			auto name = signature.substr(start, end - start);
+			if (name.starts_with("enum ")) name.remove_prefix(5);
+			return name;
+#else
+			/// ...type_signature() [with T = Namespace::Enum; ...] (GCC), or [T = Namespace::Enum] (Clang)
+			constexpr auto start = signature.find("T = ") + 4;
+			constexpr auto end = signature.find_first_of(";]", start);
+			return signature.substr(start, end - start);
+#endif
+		}
+
+		/// Enumerator names can only be extracted when every bit index is a valid value of the enum
+		template <typename ENUM>
+		concept has_fixed_underlying_type = std::is_enum_v<ENUM> && requires { ENUM{ std::underlying_type_t<ENUM>{} }; };
+
+		struct flag_instrumentation_type
+		{
+			std::string_view name;
+			std::array<std::string_view, instrumented_flag_count> flag_names{};
+		};
+
+		template <typename ENUM>
+		inline constexpr flag_instrumentation_type flag_instrumentation_type_of = [] {
+			flag_instrumentation_type result{ instrumented_type_name<ENUM>() };
+			if constexpr (has_fixed_underlying_type<ENUM>)
+			{
+				for (std::size_t i = 0; i < instrumented_flag_count; ++i)
+					result.flag_names[i] = flag_name(static_cast<ENUM>(i));
+			}
+			return result;
+		}();
+
+		/// The counts of one thread for one enum and one site (or none). Only the owning thread writes to it.
+		struct flag_counter_block
+		{
+			flag_instrumentation_type const* type = nullptr;
+			bool has_site = false;
+			std::source_location location{};
+			std::atomic<std::uint64_t> counts[flag_operation_count][instrumented_flag_count]{};
+			flag_counter_block* next_global = nullptr;
+			flag_counter_block* next_in_thread = nullptr;
+		};
+
+		inline std::atomic<flag_counter_block*> flag_counter_blocks{ nullptr };
+
+		struct thread_flag_counters
+		{
+			flag_counter_block* blocks = nullptr;
+			flag_counter_block* last = nullptr;
+		};
+		inline thread_local thread_flag_counters this_thread_flag_counters;
+
+		inline bool same_location(std::source_location const& a, std::source_location const& b) noexcept
+		{
+			return a.line() == b.line() && a.column() == b.column() &&
+				(a.file_name() == b.file_name() || std::string_view{ a.file_name() } == b.file_name()) &&
+				(a.function_name() == b.function_name() || std::string_view{ a.function_name() } == b.function_name());
+		}
+
+		/// Sites are compared by location rather than by object, as they are usually scopes on the stack
+		inline bool counts_for(flag_counter_block const& block, flag_instrumentation_type const* type, flag_instrumentation_site const* site) noexcept
+		{
+			return block.type == type && (site ? block.has_site && same_location(block.location, site->location) : !block.has_site);
+		}
+
+		/// Returns nullptr only if a new block could not be allocated, in which case the operation goes uncounted
+		inline flag_counter_block* find_flag_counters(flag_instrumentation_type const* type, flag_instrumentation_site const* site) noexcept
+		{
+			auto& thread = this_thread_flag_counters;
+			if (thread.last && counts_for(*thread.last, type, site))
+				return thread.last;
+
+			for (auto block = thread.blocks; block; block = block->next_in_thread)
+				if (counts_for(*block, type, site)) return thread.last = block;
+
+			const auto block = new (std::nothrow) flag_counter_block{};
+			if (!block) return nullptr;
+			block->type = type;
+			block->has_site = site != nullptr;
+			if (site) block->location = site->location;
+			block->next_in_thread = thread.blocks;
+			thread.blocks = block;
+			block->next_global = flag_counter_blocks.load(std::memory_order_relaxed);
+			while (!flag_counter_blocks.compare_exchange_weak(block->next_global, block, std::memory_order_release, std::memory_order_relaxed)) {}
+			return thread.last = block;
+		}
+	}
+
+	/// The instrumentation policies to use as `enum_flags_traits<ENUM>::instrumentation`.
+	/// `SITES` additionally splits the counts by the innermost `flag_instrumentation_site` of the calling thread.
+	template <bool SITES>
+	struct basic_flag_counting_instrumentation
+	{
+		template <typename ENUM>
+		static void record(flag_operation_kind op, std::uint64_t mask) noexcept
+		{
+			const auto block = detail::find_flag_counters(&detail::flag_instrumentation_type_of<ENUM>, SITES ? flag_instrumentation_site::innermost() : nullptr);
+			if (!block) return;
+			auto& counts = block->counts[static_cast<std::size_t>(op)];
+			for (; mask != 0; mask &= mask - 1)
+			{
+				/// Single writer, so no read-modify-write is needed; readers may just see a slightly older count
+				auto& count = counts[std::countr_zero(mask)];
+				count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	using flag_counting_instrumentation = basic_flag_counting_instrumentation<false>;
+	using flag_site_counting_instrumentation = basic_flag_counting_instrumentation<true>;
+
+	/// The counts of one flag, indexed by `flag_operation_kind`
+	struct flag_operation_counts
+	{
+		std::size_t bit = 0;
+		std::string_view name;
+		std::array<std::uint64_t, detail::flag_operation_count> counts{};
+
+		[[nodiscard]] std::uint64_t total() const noexcept { return counts[0] + counts[1] + counts[2] + counts[3]; }
+		[[nodiscard]] std::uint64_t operator[](flag_operation_kind op) const noexcept { return counts[static_cast<std::size_t>(op)]; }
+	};
+
+	/// The counts of all threads for one enum and one site; `has_site` is false for operations outside of any site
+	struct flag_instrumentation_entry
+	{
+		std::string_view type_name;
+		bool has_site = false;
+		std::source_location site{};
+		/// Only flags that were operated on, in order of bit
+		std::vector<flag_operation_counts> flags;
+
+		[[nodiscard]] std::uint64_t total() const noexcept
+		{
+			std::uint64_t result = 0;
+			for (auto const& flag : flags) result += flag.total();
+			return result;
+		}
+
+		/// The counts of the flag at bit index `bit`, which are all zero if it was never operated on
+		[[nodiscard]] flag_operation_counts counts_of(std::size_t bit) const noexcept
+		{
+			for (auto const& flag : flags)
+				if (flag.bit == bit) return flag;
+			return { bit, {}, {} };
+		}
+	};
+
+	/// Sums the counts of all threads so far, one entry per enum and site, hottest first. Can be called while other
+	/// threads are counting.
+	[[nodiscard]]
+	inline std::vector<flag_instrumentation_entry> flag_instrumentation_report()
+	{
+		struct merged
+		{
+			detail::flag_counter_block const* first;
+			std::array<std::array<std::uint64_t, detail::flag_operation_count>, detail::instrumented_flag_count> counts{};
+		};
+		std::vector<merged> groups;
+		for (auto block = detail::flag_counter_blocks.load(std::memory_order_acquire); block; block = block->next_global)
+		{
+			auto group = std::find_if(groups.begin(), groups.end(), [&](merged const& g) {
+				return g.first->type == block->type && g.first->has_site == block->has_site &&
+					(!block->has_site || detail::same_location(g.first->location, block->location));
+			});
+			if (group == groups.end()) group = groups.insert(groups.end(), merged{ block });
+			for (std::size_t op = 0; op < detail::flag_operation_count; ++op)
+				for (std::size_t bit = 0; bit < detail::instrumented_flag_count; ++bit)
+					group->counts[bit][op] += block->counts[op][bit].load(std::memory_order_relaxed);
+		}
+
+		std::vector<flag_instrumentation_entry> result;
+		for (auto const& group : groups)
+		{
+			flag_instrumentation_entry entry{ group.first->type->name, group.first->has_site, group.first->location, {} };
+			for (std::size_t bit = 0; bit < detail::instrumented_flag_count; ++bit)
+			{
+				flag_operation_counts flag{ bit, group.first->type->flag_names[bit], group.counts[bit] };
+				if (flag.total() != 0) entry.flags.push_back(flag);
+			}
+			if (!entry.flags.empty()) result.push_back(std::move(entry));
+		}
+		std::stable_sort(result.begin(), result.end(), [](auto const& a, auto const& b) { return a.total() > b.total(); });
+		return result;
+	}
+
+	/// Zeroes all counts. Counts made by other threads at the same time may survive.
+	inline void reset_flag_instrumentation() noexcept
+	{
+		for (auto block = detail::flag_counter_blocks.load(std::memory_order_acquire); block; block = block->next_global)
+			for (auto& op : block->counts)
+				for (auto& count : op) count.store(0, std::memory_order_relaxed);
+	}
+
+	namespace detail
+	{
+		inline void write_json_string(std::ostream& out, std::string_view text)
+		{
+			out << '"';
+			for (const char c : text)
+			{
+				if (c == '"' || c == '\\') out << '\\' << c;
+				else if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+					out << escaped;
+				}
+				else out << c;
+			}
+			out << '"';
+		}
+	}
+
+	/// Writes `flag_instrumentation_report()` as a JSON array of
+	/// `{"type", "site": {"file", "line", "column", "function"} or null, "flags": [{"bit", "name", "test", "set", "unset", "toggle"}]}`
+	inline void write_flag_instrumentation_json(std::ostream& out)
+	{
+		static constexpr std::string_view operation_names[] = { "test", "set", "unset", "toggle" };
+		const auto report = flag_instrumentation_report();
+		out << "[";
+		for (std::size_t e = 0; e < report.size(); ++e)
+		{
+			auto const& entry = report[e];
+			out << (e ? ",\n " : "\n ") << "{\"type\": ";
+			detail::write_json_string(out, entry.type_name);
+			out << ", \"site\": ";
+			if (entry.has_site)
+			{
+				out << "{\"file\": ";
+				detail::write_json_string(out, entry.site.file_name());
+				out << ", \"line\": " << entry.site.line() << ", \"column\": " << entry.site.column() << ", \"function\": ";
+				detail::write_json_string(out, entry.site.function_name());
+				out << "}";
+			}
+			else
+				out << "null";
+			out << ", \"flags\": [";
+			for (std::size_t f = 0; f < entry.flags.size(); ++f)
+			{
+				auto const& flag = entry.flags[f];
+				out << (f ? ", " : "") << "{\"bit\": " << flag.bit << ", \"name\": ";
+				detail::write_json_string(out, flag.name);
+				for (std::size_t op = 0; op < detail::flag_operation_count; ++op)
+					out << ", \"" << operation_names[op] << "\": " << flag.counts[op];
+				out << "}";
+			}
+			out << "]}";
+		}
+		out << (report.empty() ? "]\n" : "\n]\n");
+	}
+
+	/// Writes the JSON report to `path` when the program exits normally. Later calls only change the path.
+	/// Returns false if the exit handler could not be registered.
+	inline bool dump_flag_instrumentation_at_exit(std::string path)
+	{
+		static std::string dump_path;
+		static bool registered = false;
+		dump_path = std::move(path);
+		if (!registered)
+		{
+			registered = std::atexit([] {
+				std::ofstream out{ dump_path };
+				write_flag_instrumentation_json(out);
+			}) == 0;
+		}
+		return registered;
+	}
+}
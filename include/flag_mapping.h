@@ -0,0 +1,253 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <array>
+#include <span>
+#include <utility>
+
+/// Translation of flags between two bit layouts (e.g. an internal enum and OS, wire-protocol or legacy flags),
+/// compiled from a list of flag pairs instead of a chain of `if (f.is_set(X)) out.set(Y)` branches:
+///
+///   using to_os = flag_mapping<Access, OsFlags, flag_pair{ Access::Read, OsFlags::R }, flag_pair{ Access::Write, OsFlags::W }>;
+///   enum_flags<OsFlags, unsigned> os = to_os::map<unsigned>(access);
+
+namespace ghassanpl
+{
+	/// One entry of a `flag_mapping`: flag `from` of the source enum becomes flag `to` of the target enum
+	template <detail::integral_or_enum FROM, detail::integral_or_enum TO>
+	struct flag_pair
+	{
+		FROM from;
+		TO to;
+	};
+
+	/// How a `flag_mapping` moves the bits:
+	/// - `shift`: bits that move by the same distance are masked and shifted together; used when there are few distances
+	/// - `pext_pdep`: when the mapping keeps the order of the flags and the source flags span more than two bytes,
+	///   BMI2 `pext` gathers the source bits and `pdep` scatters them to the target bits
+	/// - `byte_table`: otherwise, every source byte that has mapped flags indexes a 256-entry table of target bits
+	enum class flag_mapping_strategy
+	{
+		shift,
+		pext_pdep,
+		byte_table,
+	};
+
+	namespace detail
+	{
+		using mapping_mask = unsigned long long;
+
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+		inline constexpr bool bmi2_enabled = true;
+#else
+		inline constexpr bool bmi2_enabled = false;
+#endif
+
+		/// `bits & mask`, shifted left by `shift` (right if it's negative)
+		struct flag_shift_group
+		{
+			mapping_mask mask = 0;
+			int shift = 0;
+		};
+
+		template <std::size_t N>
+		struct flag_mapping_plan
+		{
+			std::array<flag_shift_group, N> groups{};
+			std::size_t group_count = 0;
+			mapping_mask from_mask = 0;
+			mapping_mask to_mask = 0;
+			/// Source and target flags pair up one-to-one in the same order, so `pdep(pext(bits, from_mask), to_mask)` maps them
+			bool order_preserving = true;
+			bool valid = true;
+		};
+
+		template <typename FROM, typename TO, std::size_t N>
+		consteval flag_mapping_plan<N> make_flag_mapping_plan(std::array<flag_pair<FROM, TO>, N> const& pairs)
+		{
+			flag_mapping_plan<N> plan;
+			for (auto const& pair : pairs)
+			{
+				const auto from = static_cast<long long>(to_underlying_type(pair.from));
+				const auto to = static_cast<long long>(to_underlying_type(pair.to));
+				if (from < 0 || from >= 64 || to < 0 || to >= 64)
+				{
+					plan.valid = false;
+					return plan;
+				}
+				plan.from_mask |= mapping_mask{ 1 } << from;
+				plan.to_mask |= mapping_mask{ 1 } << to;
+
+				const auto shift = static_cast<int>(to - from);
+				std::size_t g = 0;
+				while (g < plan.group_count && plan.groups[g].shift != shift) ++g;
+				if (g == plan.group_count) plan.groups[plan.group_count++].shift = shift;
+				plan.groups[g].mask |= mapping_mask{ 1 } << from;
+			}
+
+			for (auto const& a : pairs)
+				for (auto const& b : pairs)
+					if ((a.from < b.from) != (a.to < b.to) || (a.from == b.from) != (a.to == b.to))
+						plan.order_preserving = false;
+			return plan;
+		}
+
+		template <std::size_t N>
+		constexpr mapping_mask apply_shift_groups(flag_mapping_plan<N> const& plan, mapping_mask bits) noexcept
+		{
+			mapping_mask result = 0;
+			for (std::size_t g = 0; g < plan.group_count; ++g)
+			{
+				const auto masked = bits & plan.groups[g].mask;
+				result |= plan.groups[g].shift >= 0 ? masked << plan.groups[g].shift : masked >> -plan.groups[g].shift;
+			}
+			return result;
+		}
+
+#if defined(GHASSANPL_X86) && (defined(__x86_64__) || defined(_M_X64))
+		template <mapping_mask FROM_MASK, mapping_mask TO_MASK, typename FROM_FLAGS, typename TO_FLAGS>
+		GHASSANPL_TARGET("bmi2") void map_flags_bmi2(FROM_FLAGS const* in, TO_FLAGS* out, std::size_t count) noexcept
+		{
+			using FU = std::make_unsigned_t<typename FROM_FLAGS::value_type>;
+			using TV = typename TO_FLAGS::value_type;
+			for (std::size_t i = 0; i < count; ++i)
+				out[i] = TO_FLAGS::from_bits(static_cast<TV>(_pdep_u64(_pext_u64(static_cast<FU>(in[i].bits), FROM_MASK), TO_MASK)));
+		}
+#endif
+	}
+
+	/// Maps `enum_flags<FROM>` to `enum_flags<TO>` according to `PAIRS`; source flags without a pair are dropped.
+	/// A source flag can appear in several pairs (it sets all their target flags), and so can a target flag (it's set
+	/// if any of its source flags is). The strategy (see `flag_mapping_strategy`) is picked at compile time.
+	/// `pext_pdep` uses the instructions directly when the program is compiled for BMI2; otherwise single values go
+	/// through the byte tables, and the batch `map` checks for BMI2 at runtime.
+	template <detail::integral_or_enum FROM, detail::integral_or_enum TO, flag_pair<FROM, TO>... PAIRS>
+	struct flag_mapping
+	{
+		using from_type = FROM;
+		using to_type = TO;
+
+		static constexpr auto plan = detail::make_flag_mapping_plan(std::array<flag_pair<FROM, TO>, sizeof...(PAIRS)>{ PAIRS... });
+		static_assert(plan.valid, "flag_mapping pairs must use flags 0 to 63");
+
+		/// Mapped source flags and the target flags they can set
+		static constexpr detail::mapping_mask from_mask = plan.from_mask;
+		static constexpr detail::mapping_mask to_mask = plan.to_mask;
+
+	private:
+
+		/// Indices of the source bytes that have mapped flags
+		static constexpr auto table_bytes = [] {
+			std::array<std::size_t, 8> bytes{};
+			std::size_t count = 0;
+			for (std::size_t b = 0; b < 8; ++b)
+				if ((from_mask >> (b * CHAR_BIT)) & 0xFF) bytes[count++] = b;
+			return std::pair{ bytes, count };
+		}();
+
+	public:
+
+		/// A table lookup costs about as much as one or two shift groups, so shifts win until there are more groups than bytes.
+		/// `pext` and `pdep` share one execution port on Intel CPUs, so they only beat the tables from three bytes up
+		/// (see benchmarks/mapping_benchmark.cpp).
+		static constexpr flag_mapping_strategy strategy =
+			plan.group_count <= std::max<std::size_t>(2, table_bytes.second) ? flag_mapping_strategy::shift :
+			plan.order_preserving && table_bytes.second > 2 ? flag_mapping_strategy::pext_pdep :
+			flag_mapping_strategy::byte_table;
+
+		/// The default target value type: `enum_flags_for<TO>` if `TO` declares its last flag, otherwise the smallest one
+		/// that holds all the mapped target flags
+		using value_type = decltype([] {
+			if constexpr (detail::has_declared_last_flag<TO>)
+				return flag_value_type_for<TO>{};
+			else
+				return detail::smallest_flag_value_type<std::max<std::size_t>(std::bit_width(to_mask), 1)>{};
+		}());
+
+		template <detail::bit_integral TO_VALUE>
+		static constexpr bool fits_in = std::bit_width(to_mask) <= CHAR_BIT * sizeof(TO_VALUE);
+
+		template <detail::bit_integral TO_VALUE = value_type, detail::bit_integral FROM_VALUE>
+		requires fits_in<TO_VALUE>
+		[[nodiscard]]
+		static constexpr enum_flags<TO, TO_VALUE> map(enum_flags<FROM, FROM_VALUE> flags) noexcept
+		{
+			using TU = std::make_unsigned_t<TO_VALUE>;
+			const auto bits = static_cast<detail::mapping_mask>(static_cast<std::make_unsigned_t<FROM_VALUE>>(flags.bits));
+			return enum_flags<TO, TO_VALUE>::from_bits(static_cast<TO_VALUE>(map_bits<TU>(bits)));
+		}
+
+		template <detail::bit_integral TO_VALUE = value_type, detail::bit_integral FROM_VALUE>
+		requires fits_in<TO_VALUE>
+		[[nodiscard]]
+		constexpr enum_flags<TO, TO_VALUE> operator()(enum_flags<FROM, FROM_VALUE> flags) const noexcept { return map<TO_VALUE>(flags); }
+
+		/// Maps every element of `in` into the same position of `out`, which must be at least as large
+		template <detail::bit_integral FROM_VALUE, detail::bit_integral TO_VALUE>
+		requires fits_in<TO_VALUE>
+		static void map(std::span<enum_flags<FROM, FROM_VALUE> const> in, std::span<enum_flags<TO, TO_VALUE>> out) noexcept
+		{
+#if defined(GHASSANPL_X86) && (defined(__x86_64__) || defined(_M_X64))
+			if constexpr (strategy == flag_mapping_strategy::pext_pdep && !detail::bmi2_enabled)
+			{
+				if (detail::get_cpu_features().bmi2)
+					return detail::map_flags_bmi2<from_mask, to_mask>(in.data(), out.data(), in.size());
+			}
+#endif
+			for (std::size_t i = 0; i < in.size(); ++i)
+				out[i] = map<TO_VALUE>(in[i]);
+		}
+
+	private:
+
+		template <typename TU>
+		static constexpr TU map_bits(detail::mapping_mask bits) noexcept
+		{
+			if constexpr (strategy == flag_mapping_strategy::shift)
+			{
+				return [bits]<std::size_t... G>(std::index_sequence<G...>) {
+					return static_cast<TU>((shift_group<G>(bits) | ... | detail::mapping_mask{ 0 }));
+				}(std::make_index_sequence<plan.group_count>{});
+			}
+			else
+			{
+#if defined(GHASSANPL_X86) && (defined(__x86_64__) || defined(_M_X64))
+				if constexpr (strategy == flag_mapping_strategy::pext_pdep && detail::bmi2_enabled)
+				{
+					if (!std::is_constant_evaluated())
+						return static_cast<TU>(_pdep_u64(_pext_u64(bits, from_mask), to_mask));
+				}
+#endif
+				return [bits]<std::size_t... B>(std::index_sequence<B...>) {
+					return static_cast<TU>((byte_tables<TU>[B][(bits >> (table_bytes.first[B] * CHAR_BIT)) & 0xFF] | ... | TU{ 0 }));
+				}(std::make_index_sequence<table_bytes.second>{});
+			}
+		}
+
+		template <std::size_t G>
+		static constexpr detail::mapping_mask shift_group(detail::mapping_mask bits) noexcept
+		{
+			constexpr auto group = plan.groups[G];
+			if constexpr (group.shift >= 0)
+				return (bits & group.mask) << group.shift;
+			else
+				return (bits & group.mask) >> -group.shift;
+		}
+
+		/// One 256-entry table per source byte in `table_bytes`, holding the target bits of every value of that byte
+		template <typename TU>
+		static constexpr auto byte_tables = [] {
+			std::array<std::array<TU, 256>, table_bytes.second> tables{};
+			for (std::size_t b = 0; b < table_bytes.second; ++b)
+				for (std::size_t v = 0; v < 256; ++v)
+					tables[b][v] = static_cast<TU>(detail::apply_shift_groups(plan, detail::mapping_mask{ v } << (table_bytes.first[b] * CHAR_BIT)));
+			return tables;
+		}();
+	};
+}
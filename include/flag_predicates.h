@@ -0,0 +1,218 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include <array>
+#include <span>
+#include <utility>
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		using predicate_mask = unsigned long long;
+
+		/// The normal form of a predicate: `(bits & mask) == expected && (bits & any[0]) != 0 && (bits & any[1]) != 0 && ...`
+		template <std::size_t N>
+		struct predicate_clauses
+		{
+			predicate_mask mask = 0;
+			predicate_mask expected = 0;
+			bool never = false;
+			std::array<predicate_mask, N> any{};
+			std::size_t any_count = 0;
+		};
+
+		template <std::size_t N>
+		consteval predicate_clauses<N> normalize(predicate_clauses<N> c)
+		{
+			/// Fold "any" clauses into the equality test until nothing changes:
+			/// - a clause containing a required flag is always satisfied
+			/// - forbidden flags can never satisfy a clause, so they are removed from it
+			/// - a clause left with no flags can never be satisfied
+			/// - a clause left with one flag requires that flag
+			for (bool changed = true; changed && !c.never;)
+			{
+				changed = false;
+				std::size_t kept = 0;
+				for (std::size_t i = 0; i < c.any_count && !c.never; ++i)
+				{
+					auto m = c.any[i];
+					if (m & c.expected) { changed = true; continue; }
+					m &= ~c.mask;
+					if (m == 0) c.never = true;
+					else if ((m & (m - 1)) == 0) { c.mask |= m; c.expected |= m; changed = true; }
+					else c.any[kept++] = m;
+				}
+				c.any_count = kept;
+			}
+
+			if (c.never)
+				return predicate_clauses<N>{ 0, 0, true, {}, 0 };
+
+			/// A clause that is a superset of another is implied by it
+			std::size_t kept = 0;
+			for (std::size_t i = 0; i < c.any_count; ++i)
+			{
+				bool implied = false;
+				for (std::size_t j = 0; j < c.any_count && !implied; ++j)
+					implied = j != i && (c.any[j] & c.any[i]) == c.any[j] && (c.any[j] != c.any[i] || j < i);
+				if (!implied) c.any[kept++] = c.any[i];
+			}
+			c.any_count = kept;
+
+			/// Sort, so equivalent predicates have the same type
+			for (std::size_t i = 1; i < c.any_count; ++i)
+				for (std::size_t j = i; j > 0 && c.any[j - 1] > c.any[j]; --j)
+					std::swap(c.any[j - 1], c.any[j]);
+
+			for (std::size_t i = c.any_count; i < N; ++i)
+				c.any[i] = 0;
+			return c;
+		}
+
+		template <predicate_mask MASK, predicate_mask EXPECTED, bool NEVER, predicate_mask... ANY>
+		inline constexpr auto normalized_predicate_clauses = normalize(predicate_clauses<sizeof...(ANY)>{ MASK, EXPECTED, NEVER, { ANY... }, sizeof...(ANY) });
+
+		template <auto FIRST, auto... REST>
+		concept same_enum_values = detail::integral_or_enum<decltype(FIRST)> && (std::is_same_v<decltype(FIRST), decltype(REST)> && ...);
+	}
+
+	template <detail::integral_or_enum ENUM, detail::predicate_mask MASK, detail::predicate_mask EXPECTED, bool NEVER, detail::predicate_mask... ANY>
+	struct flag_predicate;
+
+	namespace detail
+	{
+		template <typename ENUM, auto const& CLAUSES, std::size_t... I>
+		constexpr auto make_flag_predicate_from(std::index_sequence<I...>) noexcept
+		{
+			return flag_predicate<ENUM, CLAUSES.mask, CLAUSES.expected, CLAUSES.never, CLAUSES.any[I]...>{};
+		}
+
+		template <typename ENUM, predicate_mask MASK, predicate_mask EXPECTED, bool NEVER, predicate_mask... ANY>
+		constexpr auto make_flag_predicate() noexcept
+		{
+			constexpr auto const& clauses = normalized_predicate_clauses<MASK, EXPECTED, NEVER, ANY...>;
+			return make_flag_predicate_from<ENUM, normalized_predicate_clauses<MASK, EXPECTED, NEVER, ANY...>>(std::make_index_sequence<clauses.any_count>{});
+		}
+	}
+
+	/// A compile-time query over a set of flags, built by combining `flag_predicates::all_of`, `none_of` and `any_of` with `&`.
+	/// The template arguments are always in normal form: a single `(bits & MASK) == EXPECTED` test, plus one
+	/// `(bits & M) != 0` test for each `M` in `ANY`. Redundant and contradictory clauses are removed at compile time,
+	/// and evaluation combines the tests without branches.
+	template <detail::integral_or_enum ENUM, detail::predicate_mask MASK, detail::predicate_mask EXPECTED, bool NEVER, detail::predicate_mask... ANY>
+	struct flag_predicate
+	{
+		using enum_type = ENUM;
+
+		static constexpr detail::predicate_mask mask = MASK;
+		static constexpr detail::predicate_mask expected = EXPECTED;
+		static constexpr bool never = NEVER;
+		static constexpr std::array<detail::predicate_mask, sizeof...(ANY)> any_masks{ ANY... };
+		/// All flags mentioned by the predicate
+		static constexpr detail::predicate_mask used_bits = (MASK | ... | ANY);
+
+		template <detail::bit_integral T>
+		static constexpr bool fits_in = (used_bits & ~static_cast<detail::predicate_mask>(static_cast<std::make_unsigned_t<T>>(~std::make_unsigned_t<T>{}))) == 0;
+
+		template <detail::bit_integral T>
+		requires fits_in<T>
+		[[nodiscard]]
+		static constexpr bool test(T value) noexcept
+		{
+			if constexpr (NEVER)
+				return false;
+			else
+			{
+				using U = std::make_unsigned_t<T>;
+				const auto bits = static_cast<U>(value);
+				bool result = static_cast<U>(bits & static_cast<U>(MASK)) == static_cast<U>(EXPECTED);
+				((result &= static_cast<U>(bits & static_cast<U>(ANY)) != 0), ...);
+				return result;
+			}
+		}
+
+		template <detail::bit_integral VALUE_TYPE>
+		requires fits_in<VALUE_TYPE>
+		[[nodiscard]]
+		constexpr bool operator()(enum_flags<ENUM, VALUE_TYPE> const& flags) const noexcept { return test(flags.bits); }
+
+		template <detail::bit_integral T>
+		requires fits_in<T>
+		[[nodiscard]]
+		constexpr bool operator()(T bits) const noexcept { return test(bits); }
+
+		/// Batch evaluation
+
+		/// Returns the number of elements that satisfy the predicate
+		template <detail::bit_integral VALUE_TYPE>
+		requires fits_in<VALUE_TYPE>
+		[[nodiscard]]
+		static constexpr std::size_t count(std::span<enum_flags<ENUM, VALUE_TYPE> const> flags) noexcept
+		{
+			std::size_t result = 0;
+			for (auto const& f : flags)
+				result += test(f.bits);
+			return result;
+		}
+
+		/// Writes the result for every element of `flags` into `results`, which must be at least as large
+		template <detail::bit_integral VALUE_TYPE>
+		requires fits_in<VALUE_TYPE>
+		static constexpr void evaluate(std::span<enum_flags<ENUM, VALUE_TYPE> const> flags, std::span<bool> results) noexcept
+		{
+			for (std::size_t i = 0; i < flags.size(); ++i)
+				results[i] = test(flags[i].bits);
+		}
+
+		/// Writes the indices of elements that satisfy the predicate into `out`, which must be at least as large as `flags`.
+		/// Returns the number of indices written.
+		template <detail::bit_integral VALUE_TYPE, std::integral INDEX>
+		requires fits_in<VALUE_TYPE>
+		static constexpr std::size_t filter(std::span<enum_flags<ENUM, VALUE_TYPE> const> flags, std::span<INDEX> out) noexcept
+		{
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < flags.size(); ++i)
+			{
+				out[found] = static_cast<INDEX>(i);
+				found += test(flags[i].bits);
+			}
+			return found;
+		}
+
+		template <detail::predicate_mask MASK2, detail::predicate_mask EXPECTED2, bool NEVER2, detail::predicate_mask... ANY2>
+		[[nodiscard]]
+		constexpr auto operator&(flag_predicate<ENUM, MASK2, EXPECTED2, NEVER2, ANY2...>) const noexcept
+		{
+			constexpr bool contradiction = ((EXPECTED ^ EXPECTED2) & MASK & MASK2) != 0;
+			return detail::make_flag_predicate<ENUM, MASK | MASK2, EXPECTED | EXPECTED2, NEVER || NEVER2 || contradiction, ANY..., ANY2...>();
+		}
+
+		template <detail::predicate_mask MASK2, detail::predicate_mask EXPECTED2, bool NEVER2, detail::predicate_mask... ANY2>
+		constexpr bool operator==(flag_predicate<ENUM, MASK2, EXPECTED2, NEVER2, ANY2...>) const noexcept
+		{
+			return std::is_same_v<flag_predicate, flag_predicate<ENUM, MASK2, EXPECTED2, NEVER2, ANY2...>>;
+		}
+	};
+
+	/// The predicate building blocks live in their own namespace so they don't clash with the `std` algorithms of the same name.
+	/// Use them with `using namespace ghassanpl::flag_predicates;`
+	namespace flag_predicates
+	{
+		template <auto FIRST, auto... REST>
+		requires detail::same_enum_values<FIRST, REST...> && detail::valid_flag_bits_v_arguments<detail::predicate_mask, FIRST, REST...>
+		inline constexpr auto all_of = flag_predicate<decltype(FIRST), flag_bits_v<detail::predicate_mask, FIRST, REST...>, flag_bits_v<detail::predicate_mask, FIRST, REST...>, false>{};
+
+		template <auto FIRST, auto... REST>
+		requires detail::same_enum_values<FIRST, REST...> && detail::valid_flag_bits_v_arguments<detail::predicate_mask, FIRST, REST...>
+		inline constexpr auto none_of = flag_predicate<decltype(FIRST), flag_bits_v<detail::predicate_mask, FIRST, REST...>, 0, false>{};
+
+		template <auto FIRST, auto... REST>
+		requires detail::same_enum_values<FIRST, REST...> && detail::valid_flag_bits_v_arguments<detail::predicate_mask, FIRST, REST...>
+		inline constexpr auto any_of = detail::make_flag_predicate<decltype(FIRST), 0, 0, false, flag_bits_v<detail::predicate_mask, FIRST, REST...>>();
+	}
+}
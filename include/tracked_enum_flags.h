@@ -0,0 +1,199 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "enum_flags.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Change tracking for `enum_flags`, for incremental systems that need to know which flags were added and removed
+/// since they last looked, without keeping and comparing full copies themselves.
+/// Both types keep the value as of the last `flush()` next to the current one, and compute the added and removed
+/// masks from the two when asked, so a flag that is set and then unset again between flushes is not a change.
+
+namespace ghassanpl
+{
+	/// `enum_flags` that remembers its value as of the last `flush()`. The mutators are those of `enum_flags`, and cost
+	/// the same.
+	template <detail::integral_or_enum ENUM, detail::valid_integral VALUE_TYPE = unsigned long long>
+	struct tracked_enum_flags
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using value_type = VALUE_TYPE;
+		using enum_type = ENUM;
+		using self_type = tracked_enum_flags;
+
+		constexpr tracked_enum_flags() noexcept = default;
+		/// The initial value counts as already flushed
+		constexpr tracked_enum_flags(flags_type value) noexcept : current(value), baseline(value) {}
+
+		[[nodiscard]] constexpr flags_type value() const noexcept { return current; }
+		[[nodiscard]] constexpr operator flags_type() const noexcept { return current; }
+		[[nodiscard]] constexpr flags_type flushed_value() const noexcept { return baseline; }
+
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		constexpr bool is_set(T flag) const noexcept { return current.is_set(flag); }
+
+		/// Flags set since the last `flush()`
+		[[nodiscard]] constexpr flags_type added() const noexcept { return flags_type::from_bits(static_cast<VALUE_TYPE>(current.bits & ~baseline.bits)); }
+		/// Flags cleared since the last `flush()`
+		[[nodiscard]] constexpr flags_type removed() const noexcept { return flags_type::from_bits(static_cast<VALUE_TYPE>(baseline.bits & ~current.bits)); }
+		[[nodiscard]] constexpr bool changed() const noexcept { return current.bits != baseline.bits; }
+
+		constexpr void flush() noexcept { baseline = current; }
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& set(ARGS... args) noexcept { current.set(args...); return *this; }
+		constexpr self_type& set(flags_type other) noexcept { current.set(other); return *this; }
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& unset(ARGS... args) noexcept { current.unset(args...); return *this; }
+		constexpr self_type& unset(flags_type other) noexcept { current.unset(other); return *this; }
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& toggle(ARGS... args) noexcept { current.toggle(args...); return *this; }
+		constexpr self_type& toggle(flags_type other) noexcept { current.toggle(other); return *this; }
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& set_to(bool val, ARGS... args) noexcept { current.set_to(val, args...); return *this; }
+		constexpr self_type& set_to(bool val, flags_type other) noexcept { current.set_to(val, other); return *this; }
+
+		template <detail::integral_or_enum T>
+		constexpr self_type& operator+=(T flag) noexcept { current += flag; return *this; }
+		template <detail::integral_or_enum T>
+		constexpr self_type& operator-=(T flag) noexcept { current -= flag; return *this; }
+		constexpr self_type& operator+=(flags_type other) noexcept { current += other; return *this; }
+		constexpr self_type& operator-=(flags_type other) noexcept { current -= other; return *this; }
+
+		/// Replaces the value; the change is tracked like any other
+		constexpr self_type& operator=(flags_type value) noexcept { current = value; return *this; }
+
+	private:
+
+		flags_type current;
+		flags_type baseline;
+	};
+
+	/// One changed entry of a `tracked_enum_flags_column`
+	template <typename FLAGS>
+	struct flag_change
+	{
+		std::size_t index = 0;
+		FLAGS added;
+		FLAGS removed;
+	};
+
+	/// A column of `enum_flags` that tracks which entries changed since the last `flush()`. Every mutator does its
+	/// operation plus one OR into a bitmap of dirty entries (one bit per entry), so consumers scan 64 entries per word
+	/// of that bitmap, and only look at the values of dirty entries. Appended entries count as added to an empty value.
+	template <detail::integral_or_enum ENUM, detail::bit_integral VALUE_TYPE = unsigned long long>
+	struct tracked_enum_flags_column
+	{
+		using flags_type = enum_flags<ENUM, VALUE_TYPE>;
+		using value_type = flags_type;
+		using change_type = flag_change<flags_type>;
+
+		tracked_enum_flags_column() noexcept = default;
+		explicit tracked_enum_flags_column(std::size_t count, flags_type value = {}) { resize(count, value); }
+
+		[[nodiscard]] std::size_t size() const noexcept { return values.size(); }
+		[[nodiscard]] bool empty() const noexcept { return values.empty(); }
+
+		[[nodiscard]] flags_type operator[](std::size_t index) const noexcept { return values[index]; }
+		[[nodiscard]] flags_type flushed_value(std::size_t index) const noexcept { return baseline[index]; }
+
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		bool is_set(std::size_t index, T flag) const noexcept { return values[index].is_set(flag); }
+
+		/// Whether the entry was modified since the last `flush()`, even if its value ended up the same
+		[[nodiscard]]
+		bool is_dirty(std::size_t index) const noexcept { return (dirty[index / word_bits] >> (index % word_bits)) & 1; }
+
+		void reserve(std::size_t count)
+		{
+			values.reserve(count);
+			baseline.reserve(count);
+			dirty.reserve((count + word_bits - 1) / word_bits);
+		}
+
+		void resize(std::size_t count, flags_type value = {})
+		{
+			const auto old_size = values.size();
+			values.resize(count, value);
+			baseline.resize(count);
+			dirty.resize((count + word_bits - 1) / word_bits);
+			for (auto i = old_size; i < count; ++i) mark(i);
+			/// Entries past the end may be dirty from before a shrink
+			if (count % word_bits) dirty.back() &= (word_type{ 1 } << (count % word_bits)) - 1;
+		}
+
+		void push_back(flags_type value)
+		{
+			values.push_back(value);
+			baseline.emplace_back();
+			if (values.size() > dirty.size() * word_bits) dirty.push_back(0);
+			mark(values.size() - 1);
+		}
+
+		void set(std::size_t index, flags_type flags) noexcept { values[index].set(flags); mark(index); }
+		void unset(std::size_t index, flags_type flags) noexcept { values[index].unset(flags); mark(index); }
+		void toggle(std::size_t index, flags_type flags) noexcept { values[index].toggle(flags); mark(index); }
+		void set_to(bool val, std::size_t index, flags_type flags) noexcept { values[index].set_to(val, flags); mark(index); }
+		void assign(std::size_t index, flags_type value) noexcept { values[index] = value; mark(index); }
+
+		/// Calls `callback(change_type)` for every entry whose value differs from its value at the last `flush()`, in
+		/// order of index
+		template <typename FUNC>
+		void for_each_change(FUNC&& callback) const
+		{
+			for_each_dirty([&](std::size_t index) {
+				const auto now = values[index].bits, before = baseline[index].bits;
+				if (now != before)
+					callback(change_type{ index, flags_type::from_bits(static_cast<VALUE_TYPE>(now & ~before)), flags_type::from_bits(static_cast<VALUE_TYPE>(before & ~now)) });
+			});
+		}
+
+		[[nodiscard]]
+		std::vector<change_type> changes() const
+		{
+			std::vector<change_type> result;
+			for_each_change([&](change_type const& change) { result.push_back(change); });
+			return result;
+		}
+
+		/// Makes the current values the baseline for the next changes
+		void flush() noexcept
+		{
+			for_each_dirty([&](std::size_t index) { baseline[index] = values[index]; });
+			std::fill(dirty.begin(), dirty.end(), word_type{ 0 });
+		}
+
+	private:
+
+		using word_type = std::uint64_t;
+		static constexpr std::size_t word_bits = 64;
+
+		std::vector<flags_type> values;
+		std::vector<flags_type> baseline;
+		std::vector<word_type> dirty;
+
+		void mark(std::size_t index) noexcept { dirty[index / word_bits] |= word_type{ 1 } << (index % word_bits); }
+
+		template <typename FUNC>
+		void for_each_dirty(FUNC&& func) const
+		{
+			for (std::size_t w = 0; w < dirty.size(); ++w)
+			{
+				for (auto bits = dirty[w]; bits != 0; bits &= bits - 1)
+					func(w * word_bits + static_cast<std::size_t>(std::countr_zero(bits)));
+			}
+		}
+	};
+}
@@ -0,0 +1,339 @@
+/// Copyright 2017-2020 Ghassan.pl
+/// Usage of the works is permitted provided that this instrument is retained with
+/// the works, so that any entity that uses the works is notified of this instrument.
+/// DISCLAIMER: THE WORKS ARE WITHOUT WARRANTY.
+#pragma once
+
+#include "flag_bits.h"
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#define GHASSANPL_WIDE_FLAGS_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GHASSANPL_WIDE_FLAGS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ghassanpl
+{
+	namespace detail
+	{
+		using wide_word_type = std::uint64_t;
+		constexpr std::size_t wide_word_bits = CHAR_BIT * sizeof(wide_word_type);
+
+		template <typename BIT_TYPE, BIT_TYPE BIT_NUM, std::size_t BIT_COUNT>
+		concept allowed_wide_bit_num = BIT_NUM >= 0 && static_cast<unsigned long long>(BIT_NUM) < BIT_COUNT;
+
+		/// Whole-set operations on arrays of 64-bit words. Each function has a scalar path (used in constant evaluation and
+		/// when no vector ISA is available) and processes 256 (AVX2) or 128 (SSE2) bits per step otherwise.
+		/// Unaligned loads are used throughout; `wide_enum_flags` aligns its storage so they never split cache lines.
+		template <std::size_t N>
+		struct wide_ops
+		{
+			using words = std::array<wide_word_type, N>;
+
+#if defined(GHASSANPL_WIDE_FLAGS_AVX2)
+			static constexpr std::size_t vector_words = 4;
+			static __m256i load(wide_word_type const* p) noexcept { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p)); }
+			static void store(wide_word_type* p, __m256i v) noexcept { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+			static __m256i vand(__m256i a, __m256i b) noexcept { return _mm256_and_si256(a, b); }
+			static __m256i vor(__m256i a, __m256i b) noexcept { return _mm256_or_si256(a, b); }
+			static __m256i vxor(__m256i a, __m256i b) noexcept { return _mm256_xor_si256(a, b); }
+			/// a & ~b
+			static __m256i vandnot(__m256i a, __m256i b) noexcept { return _mm256_andnot_si256(b, a); }
+			static bool vzero(__m256i v) noexcept { return _mm256_testz_si256(v, v) != 0; }
+#elif defined(GHASSANPL_WIDE_FLAGS_SSE2)
+			static constexpr std::size_t vector_words = 2;
+			static __m128i load(wide_word_type const* p) noexcept { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p)); }
+			static void store(wide_word_type* p, __m128i v) noexcept { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+			static __m128i vand(__m128i a, __m128i b) noexcept { return _mm_and_si128(a, b); }
+			static __m128i vor(__m128i a, __m128i b) noexcept { return _mm_or_si128(a, b); }
+			static __m128i vxor(__m128i a, __m128i b) noexcept { return _mm_xor_si128(a, b); }
+			/// a & ~b
+			static __m128i vandnot(__m128i a, __m128i b) noexcept { return _mm_andnot_si128(b, a); }
+			static bool vzero(__m128i v) noexcept { return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF; }
+#else
+			static constexpr std::size_t vector_words = 0;
+#endif
+			static constexpr std::size_t vector_end = vector_words ? N - N % vector_words : 0;
+
+			/// Calls `op(vector_lhs, vector_rhs)` for every full vector and `sop(word_lhs, word_rhs)` for the rest,
+			/// storing the results into `lhs`.
+			template <typename VOP, typename SOP>
+			static constexpr void transform(words& lhs, words const& rhs, VOP&& op, SOP&& sop) noexcept
+			{
+				std::size_t i = 0;
+#if defined(GHASSANPL_WIDE_FLAGS_AVX2) || defined(GHASSANPL_WIDE_FLAGS_SSE2)
+				if (!std::is_constant_evaluated())
+				{
+					for (; i < vector_end; i += vector_words)
+						store(lhs.data() + i, op(load(lhs.data() + i), load(rhs.data() + i)));
+				}
+#else
+				(void)op;
+#endif
+				for (; i < N; ++i)
+					lhs[i] = sop(lhs[i], rhs[i]);
+			}
+
+			/// Returns true if `op(lhs, rhs)` is zero for every word
+			template <typename VOP, typename SOP>
+			static constexpr bool all_zero(words const& lhs, words const& rhs, VOP&& op, SOP&& sop) noexcept
+			{
+				std::size_t i = 0;
+#if defined(GHASSANPL_WIDE_FLAGS_AVX2) || defined(GHASSANPL_WIDE_FLAGS_SSE2)
+				if (!std::is_constant_evaluated() && vector_end)
+				{
+					auto acc = op(load(lhs.data()), load(rhs.data()));
+					for (i = vector_words; i < vector_end; i += vector_words)
+						acc = vor(acc, op(load(lhs.data() + i), load(rhs.data() + i)));
+					if (!vzero(acc))
+						return false;
+				}
+#else
+				(void)op;
+#endif
+				wide_word_type acc = 0;
+				for (; i < N; ++i)
+					acc |= sop(lhs[i], rhs[i]);
+				return acc == 0;
+			}
+
+			static constexpr void or_with(words& lhs, words const& rhs) noexcept
+			{
+				transform(lhs, rhs, [](auto a, auto b) { return vor(a, b); }, [](wide_word_type a, wide_word_type b) { return a | b; });
+			}
+			static constexpr void and_with(words& lhs, words const& rhs) noexcept
+			{
+				transform(lhs, rhs, [](auto a, auto b) { return vand(a, b); }, [](wide_word_type a, wide_word_type b) { return a & b; });
+			}
+			static constexpr void xor_with(words& lhs, words const& rhs) noexcept
+			{
+				transform(lhs, rhs, [](auto a, auto b) { return vxor(a, b); }, [](wide_word_type a, wide_word_type b) { return a ^ b; });
+			}
+			static constexpr void andnot_with(words& lhs, words const& rhs) noexcept
+			{
+				transform(lhs, rhs, [](auto a, auto b) { return vandnot(a, b); }, [](wide_word_type a, wide_word_type b) { return a & ~b; });
+			}
+
+			/// (lhs & rhs) == 0
+			static constexpr bool disjoint(words const& lhs, words const& rhs) noexcept
+			{
+				return all_zero(lhs, rhs, [](auto a, auto b) { return vand(a, b); }, [](wide_word_type a, wide_word_type b) { return a & b; });
+			}
+			/// (lhs & rhs) == rhs, i.e. (rhs & ~lhs) == 0
+			static constexpr bool contains(words const& lhs, words const& rhs) noexcept
+			{
+				return all_zero(lhs, rhs, [](auto a, auto b) { return vandnot(b, a); }, [](wide_word_type a, wide_word_type b) { return b & ~a; });
+			}
+			static constexpr bool equal(words const& lhs, words const& rhs) noexcept
+			{
+				return all_zero(lhs, rhs, [](auto a, auto b) { return vxor(a, b); }, [](wide_word_type a, wide_word_type b) { return a ^ b; });
+			}
+			static constexpr bool empty(words const& w) noexcept
+			{
+				return all_zero(w, w, [](auto a, auto) { return a; }, [](wide_word_type a, wide_word_type) { return a; });
+			}
+		};
+	}
+
+	/// A version of `enum_flags` for enums with more enumerators than fit in a single integer.
+	/// Stores `BIT_COUNT` bits in an array of 64-bit words; whole-set operations (the `self_type` overloads) are vectorized.
+	template <detail::integral_or_enum ENUM, std::size_t BIT_COUNT>
+	requires (BIT_COUNT > 0)
+	struct wide_enum_flags
+	{
+		using word_type = detail::wide_word_type;
+		static constexpr std::size_t word_bits = detail::wide_word_bits;
+		static constexpr std::size_t word_count = (BIT_COUNT + word_bits - 1) / word_bits;
+		static constexpr std::size_t bit_count = BIT_COUNT;
+		using value_type = std::array<word_type, word_count>;
+		using enum_type = ENUM;
+		using self_type = wide_enum_flags;
+		static constexpr bool enum_type_is_enum = std::is_enum_v<ENUM>;
+
+		alignas(word_count >= 4 ? 32 : alignof(word_type)) value_type bits{};
+
+		constexpr wide_enum_flags() noexcept = default;
+		constexpr wide_enum_flags(const wide_enum_flags&) noexcept = default;
+		constexpr wide_enum_flags(wide_enum_flags&&) noexcept = default;
+		constexpr wide_enum_flags& operator=(const wide_enum_flags&) noexcept = default;
+		constexpr wide_enum_flags& operator=(wide_enum_flags&&) noexcept = default;
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr wide_enum_flags(ARGS... args) noexcept { (set_bit(args), ...); }
+
+		[[nodiscard]]
+		constexpr static self_type from_bits(value_type const& val) noexcept {
+			self_type ret;
+			ret.bits = val;
+			ret.bits[word_count - 1] &= last_word_mask;
+			return ret;
+		}
+
+		[[nodiscard]]
+		constexpr static self_type all() noexcept
+		{
+			self_type ret;
+			for (auto& word : ret.bits) word = ~word_type{ 0 };
+			ret.bits[word_count - 1] = last_word_mask;
+			return ret;
+		}
+
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		constexpr static self_type all(T last) noexcept
+		{
+			const auto index = static_cast<std::size_t>(detail::to_underlying_type(last));
+			self_type ret;
+			for (std::size_t i = 0; i < index / word_bits; ++i)
+				ret.bits[i] = ~word_type{ 0 };
+			const auto top = word_type{ 1 } << (index % word_bits);
+			ret.bits[index / word_bits] = top | (top - 1);
+			return ret;
+		}
+
+		/// Compile-time checked equivalent of the variadic constructor
+		template <auto... VALUES>
+		requires (detail::integral_or_enum<decltype(VALUES)> && ...) &&
+			(detail::allowed_wide_bit_num<decltype(detail::to_underlying_type(VALUES)), detail::to_underlying_type(VALUES), BIT_COUNT> && ...)
+		[[nodiscard]]
+		constexpr static self_type of() noexcept { return self_type{ VALUES... }; }
+
+		[[nodiscard]]
+		constexpr static self_type none() noexcept { return {}; }
+
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		constexpr bool is_set(T flag) const noexcept { return (bits[word_index(flag)] & word_bit(flag)) != 0; }
+
+		template <detail::integral_or_enum... ARGS>
+		[[nodiscard]]
+		constexpr bool are_any_set(ARGS... args) const noexcept
+		{
+			return (this->is_set(args) || ...);
+		}
+
+		/// are_any_set({}) is true, to match `enum_flags`
+		[[nodiscard]]
+		constexpr bool are_any_set(self_type const& other) const noexcept { return ops::empty(other.bits) || !ops::disjoint(bits, other.bits); }
+
+		template <detail::integral_or_enum... ARGS>
+		[[nodiscard]]
+		constexpr bool are_all_set(ARGS... args) const noexcept
+		{
+			return (this->is_set(args) && ...);
+		}
+
+		[[nodiscard]]
+		constexpr bool are_all_set(self_type const& other) const noexcept { return ops::contains(bits, other.bits); }
+
+		[[nodiscard]]
+		constexpr bool empty() const noexcept { return ops::empty(bits); }
+		constexpr explicit operator bool() const noexcept { return !empty(); }
+
+		[[nodiscard]]
+		constexpr std::size_t count() const noexcept
+		{
+			std::size_t result = 0;
+			for (auto word : bits)
+				result += static_cast<std::size_t>(std::popcount(word));
+			return result;
+		}
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& set(ARGS... args) noexcept { (set_bit(args), ...); return *this; }
+		constexpr self_type& set(self_type const& other) noexcept { ops::or_with(bits, other.bits); return *this; }
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& unset(ARGS... args) noexcept { (unset_bit(args), ...); return *this; }
+		constexpr self_type& unset(self_type const& other) noexcept { ops::andnot_with(bits, other.bits); return *this; }
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& toggle(ARGS... args) noexcept { (toggle_bit(args), ...); return *this; }
+		constexpr self_type& toggle(self_type const& other) noexcept { ops::xor_with(bits, other.bits); return *this; }
+
+		template <detail::integral_or_enum... ARGS>
+		constexpr self_type& set_to(bool val, ARGS... args) noexcept
+		{
+			if (val) set(args...); else unset(args...);
+			return *this;
+		}
+
+		constexpr self_type& set_to(bool val, self_type const& other) noexcept
+		{
+			if (val) set(other); else unset(other);
+			return *this;
+		}
+
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		constexpr self_type operator+(T flag) const noexcept { auto result = *this; result.set_bit(flag); return result; }
+		template <detail::integral_or_enum T>
+		[[nodiscard]]
+		constexpr self_type operator-(T flag) const noexcept { auto result = *this; result.unset_bit(flag); return result; }
+
+		template <detail::integral_or_enum T>
+		constexpr self_type& operator+=(T flag) noexcept { set_bit(flag); return *this; }
+		template <detail::integral_or_enum T>
+		constexpr self_type& operator-=(T flag) noexcept { unset_bit(flag); return *this; }
+
+		constexpr self_type& operator+=(self_type const& flag) noexcept { return set(flag); }
+		constexpr self_type& operator-=(self_type const& flag) noexcept { return unset(flag); }
+
+		[[nodiscard]]
+		constexpr self_type operator&(self_type const& other) const noexcept { auto result = *this; ops::and_with(result.bits, other.bits); return result; }
+		[[nodiscard]]
+		constexpr self_type operator|(self_type const& other) const noexcept { auto result = *this; ops::or_with(result.bits, other.bits); return result; }
+		[[nodiscard]]
+		constexpr self_type operator^(self_type const& other) const noexcept { auto result = *this; ops::xor_with(result.bits, other.bits); return result; }
+
+		constexpr bool operator==(self_type const& other) const noexcept { return ops::equal(bits, other.bits); }
+		constexpr bool operator!=(self_type const& other) const noexcept { return !ops::equal(bits, other.bits); }
+
+		template <typename FUNC>
+		constexpr auto for_each(FUNC&& callback) const
+		{
+			using return_type = std::invoke_result_t<FUNC, enum_type>;
+			for (std::size_t w = 0; w < word_count; ++w)
+			{
+				auto bitset = bits[w];
+				while (bitset)
+				{
+					const auto r = static_cast<std::size_t>(std::countr_zero(bitset)) + w * word_bits;
+					if constexpr (std::is_convertible_v<return_type, bool>)
+					{
+						if (auto ret = callback((enum_type)r)) return ret;
+					}
+					else
+						callback((enum_type)r);
+					bitset &= bitset - 1;
+				}
+			}
+			if constexpr (std::is_convertible_v<return_type, bool>)
+				return return_type{};
+		}
+
+	private:
+
+		using ops = detail::wide_ops<word_count>;
+
+		static constexpr word_type last_word_mask = BIT_COUNT % word_bits ? (word_type{ 1 } << (BIT_COUNT % word_bits)) - 1 : ~word_type{ 0 };
+
+		template <detail::integral_or_enum T>
+		static constexpr std::size_t word_index(T flag) noexcept { return static_cast<std::size_t>(detail::to_underlying_type(flag)) / word_bits; }
+		template <detail::integral_or_enum T>
+		static constexpr word_type word_bit(T flag) noexcept { return word_type{ 1 } << (static_cast<std::size_t>(detail::to_underlying_type(flag)) % word_bits); }
+
+		template <detail::integral_or_enum T>
+		constexpr void set_bit(T flag) noexcept { bits[word_index(flag)] |= word_bit(flag); }
+		template <detail::integral_or_enum T>
+		constexpr void unset_bit(T flag) noexcept { bits[word_index(flag)] &= ~word_bit(flag); }
+		template <detail::integral_or_enum T>
+		constexpr void toggle_bit(T flag) noexcept { bits[word_index(flag)] ^= word_bit(flag); }
+	};
+}
@@ -6,7 +6,34 @@
 #include "../include/flag_bits_v.h"
 #include "../include/flag_bits.h"
 #include "../include/enum_flags.h"
+#include "../include/wide_enum_flags.h"
+#include "../include/enum_flags_column.h"
+#include "../include/atomic_enum_flags.h"
+#include "../include/flag_predicates.h"
+#include "../include/enum_flags_string.h"
+#include "../include/enum_flags_index.h"
+#include "../include/enum_flags_histogram.h"
+#include "../include/enum_flags_sliced_column.h"
+#include "../include/flag_mapping.h"
+#include "../include/enum_flags_subsets.h"
+#include "../include/enum_flags_algorithms.h"
+#include "../include/enum_flags_dictionary.h"
+#include "../include/enum_flags_stream.h"
+#include "../include/tracked_enum_flags.h"
+#include "../include/flag_instrumentation.h"
+#include "../include/atomic_wide_enum_flags.h"
 #include <cstdint>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
 #include <gtest/gtest.h>
 
 template <typename RESULT_TYPE>
@@ -205,6 +232,1507 @@ TYPED_TEST(flag_bits_test, allows_cv_types)
   EXPECT_TRUE((flag_bits_v_overload_exists<std::add_cv_t<TypeParam>>));
 }
 
+enum class WideTestEnum : uint16_t
+{
+  Zero = 0,
+  One = 1,
+  SixtyThree = 63,
+  SixtyFour = 64,
+  HundredTwentySeven = 127,
+  TwoHundred = 200,
+  TwoFiftyFive = 255,
+  TwoFiftySix = 256,
+};
+
+template <class U, auto... ARGS>
+concept wide_of_overload_exists = requires { U::template of<ARGS...>(); };
+
+TEST(wide_enum_flags_test, basic_operations_work_across_words)
+{
+  using flags = wide_enum_flags<WideTestEnum, 256>;
+  static_assert(flags::word_count == 4);
+
+  flags f{ WideTestEnum::One, WideTestEnum::TwoHundred };
+  EXPECT_TRUE(f.is_set(WideTestEnum::One));
+  EXPECT_TRUE(f.is_set(WideTestEnum::TwoHundred));
+  EXPECT_FALSE(f.is_set(WideTestEnum::SixtyFour));
+  EXPECT_EQ(f.count(), 2u);
+
+  f.set(WideTestEnum::SixtyFour).unset(WideTestEnum::One).toggle(WideTestEnum::TwoFiftyFive);
+  EXPECT_TRUE(f.are_all_set(WideTestEnum::SixtyFour, WideTestEnum::TwoHundred, WideTestEnum::TwoFiftyFive));
+  EXPECT_FALSE(f.are_any_set(WideTestEnum::One, WideTestEnum::Zero));
+
+  f.set_to(false, WideTestEnum::TwoFiftyFive);
+  f += WideTestEnum::HundredTwentySeven;
+  f -= WideTestEnum::SixtyFour;
+  EXPECT_EQ(f, (flags{ WideTestEnum::HundredTwentySeven, WideTestEnum::TwoHundred }));
+}
+
+TEST(wide_enum_flags_test, whole_set_operations_work)
+{
+  using flags = wide_enum_flags<WideTestEnum, 256>;
+  const flags a{ WideTestEnum::Zero, WideTestEnum::SixtyFour, WideTestEnum::TwoFiftyFive };
+  const flags b{ WideTestEnum::SixtyFour, WideTestEnum::TwoFiftyFive };
+  const flags c{ WideTestEnum::One, WideTestEnum::TwoHundred };
+
+  EXPECT_TRUE(a.are_all_set(b));
+  EXPECT_FALSE(b.are_all_set(a));
+  EXPECT_TRUE(a.are_any_set(b));
+  EXPECT_FALSE(a.are_any_set(c));
+  EXPECT_TRUE(a.are_any_set(flags::none()));
+  EXPECT_TRUE(flags::all().are_all_set(a));
+  EXPECT_EQ(flags::all().count(), 256u);
+  EXPECT_EQ(flags::all(WideTestEnum::SixtyFour).count(), 65u);
+
+  EXPECT_EQ((a & b), b);
+  EXPECT_EQ((b | c).count(), 4u);
+  EXPECT_EQ((a ^ b), flags{ WideTestEnum::Zero });
+  EXPECT_EQ(flags{ a }.unset(b), flags{ WideTestEnum::Zero });
+  EXPECT_FALSE(flags::none());
+  EXPECT_TRUE(a);
+
+  static_assert(flags::of<WideTestEnum::Zero, WideTestEnum::TwoFiftyFive>().are_all_set(WideTestEnum::TwoFiftyFive));
+  static_assert(flags::all().count() == 256);
+}
+
+TEST(wide_enum_flags_test, partial_last_word_is_masked)
+{
+  using flags = wide_enum_flags<WideTestEnum, 150>;
+  EXPECT_EQ(flags::all().count(), 150u);
+  flags::value_type raw{};
+  for (auto& word : raw) word = ~uint64_t{ 0 };
+  EXPECT_EQ(flags::from_bits(raw), flags::all());
+}
+
+TEST(wide_enum_flags_test, for_each_visits_in_order)
+{
+  using flags = wide_enum_flags<WideTestEnum, 256>;
+  const flags f{ WideTestEnum::TwoHundred, WideTestEnum::One, WideTestEnum::SixtyFour };
+  std::vector<int> seen;
+  f.for_each([&](WideTestEnum e) { seen.push_back(int(e)); });
+  EXPECT_EQ(seen, (std::vector<int>{ 1, 64, 200 }));
+  EXPECT_TRUE(f.for_each([](WideTestEnum e) { return e == WideTestEnum::SixtyFour; }));
+}
+
+TEST(wide_enum_flags_test, disallow_invalid_bit_numbers_for_template_parameters)
+{
+  using flags = wide_enum_flags<WideTestEnum, 256>;
+  EXPECT_TRUE((wide_of_overload_exists<flags, WideTestEnum::TwoFiftyFive>));
+  EXPECT_FALSE((wide_of_overload_exists<flags, WideTestEnum::TwoFiftySix>));
+  EXPECT_FALSE((wide_of_overload_exists<flags, TestEnum::Negative>));
+}
+
+template <typename VALUE_TYPE>
+class enum_flags_column_test : public ::testing::Test {};
+
+using column_value_types = ::testing::Types<uint8_t, int16_t, uint32_t, int64_t, uint64_t>;
+TYPED_TEST_SUITE(enum_flags_column_test, column_value_types);
+
+TYPED_TEST(enum_flags_column_test, kernels_match_member_functions)
+{
+  using column = enum_flags_column<int, TypeParam>;
+  using flags = typename column::flags_type;
+
+  std::mt19937_64 rng{ 1234 };
+  column col;
+  for (size_t i = 0; i < 1000 + 13; ++i)
+    col.push_back(flags::from_bits(static_cast<TypeParam>(rng())));
+
+  const flags required{ 1, 3 };
+  const flags forbidden{ 2 };
+
+  std::vector<uint32_t> expected;
+  for (size_t i = 0; i < col.size(); ++i)
+    if (col[i].are_all_set(required) && !(col[i].bits & forbidden.bits))
+      expected.push_back(uint32_t(i));
+
+  EXPECT_EQ(col.filter(required, forbidden), expected);
+  EXPECT_EQ(col.count(required, forbidden), expected.size());
+  EXPECT_EQ(col.count(flags::none()), col.size());
+  EXPECT_EQ(col.filter(flags::none(), flags::all()).size(), size_t(std::count(col.begin(), col.end(), flags::none())));
+
+  std::vector<uint32_t> out(col.size());
+  const auto data = detail::column_bits(std::span<flags const>{ col });
+  using U = std::make_unsigned_t<TypeParam>;
+  const auto req = static_cast<U>(required.bits), forb = static_cast<U>(forbidden.bits);
+  if (detail::get_cpu_features().avx2)
+  {
+    out.resize(detail::filter_avx2(data, col.size(), req, forb, out.data()));
+    EXPECT_EQ(out, expected);
+    EXPECT_EQ(detail::count_avx2(data, col.size(), req, forb), expected.size());
+  }
+  if constexpr (sizeof(U) >= 4)
+  {
+    if (detail::get_cpu_features().avx512f)
+    {
+      out.resize(col.size());
+      out.resize(detail::filter_avx512(data, col.size(), req, forb, out.data()));
+      EXPECT_EQ(out, expected);
+      EXPECT_EQ(detail::count_avx512(data, col.size(), req, forb), expected.size());
+    }
+  }
+}
+
+TEST(enum_flags_column_test, bulk_updates_touch_only_selection)
+{
+  enum_flags_column<TestEnum, uint32_t> col(10, { TestEnum::One });
+  col[3].set(TestEnum::Seven);
+  col[7].set(TestEnum::Seven);
+
+  const auto selection = col.filter(TestEnum::Seven);
+  EXPECT_EQ(selection, (std::vector<uint32_t>{ 3, 7 }));
+
+  col.set(selection, TestEnum::Nine);
+  col.unset(selection, TestEnum::One);
+  EXPECT_EQ(col.count(TestEnum::Nine, TestEnum::One), 2u);
+  EXPECT_EQ(col.count(TestEnum::One), 8u);
+
+  col.toggle(selection, { TestEnum::Nine, TestEnum::Zero });
+  EXPECT_EQ(col[3], (enum_flags<TestEnum, uint32_t>{ TestEnum::Seven, TestEnum::Zero }));
+  col.set_to(true, selection, TestEnum::One);
+  EXPECT_EQ(col.count(TestEnum::One), 10u);
+}
+
+TEST(atomic_enum_flags_test, fetch_operations_return_previous_value)
+{
+  using flags = enum_flags<TestEnum, uint32_t>;
+  atomic_enum_flags<TestEnum, uint32_t> f{ TestEnum::One };
+
+  EXPECT_EQ(f.fetch_set(TestEnum::Seven, std::memory_order_relaxed), flags{ TestEnum::One });
+  EXPECT_EQ(f.fetch_unset(TestEnum::One, std::memory_order_release), (flags{ TestEnum::One, TestEnum::Seven }));
+  EXPECT_EQ(f.fetch_toggle({ TestEnum::Seven, TestEnum::Nine }, std::memory_order_acq_rel), flags{ TestEnum::Seven });
+  EXPECT_EQ(f.load(std::memory_order_acquire), flags{ TestEnum::Nine });
+  EXPECT_EQ(f.fetch_set_to(true, TestEnum::Zero), flags{ TestEnum::Nine });
+
+  f.store({ TestEnum::Eight }, std::memory_order_release);
+  EXPECT_EQ(f.exchange(TestEnum::Zero), flags{ TestEnum::Eight });
+  EXPECT_TRUE(f.is_set(TestEnum::Zero, std::memory_order_relaxed));
+
+  f.set(TestEnum::One).unset(TestEnum::Zero).toggle(TestEnum::Seven);
+  f += TestEnum::Eight;
+  f -= TestEnum::Seven;
+  EXPECT_TRUE(f.are_all_set({ TestEnum::One, TestEnum::Eight }));
+  EXPECT_FALSE(f.are_any_set({ TestEnum::Zero, TestEnum::Seven }));
+
+  int count = 0;
+  f.for_each([&](TestEnum) { ++count; }, std::memory_order_acquire);
+  EXPECT_EQ(count, 2);
+}
+
+TEST(atomic_enum_flags_test, test_and_set_and_transitions)
+{
+  using flags = enum_flags<TestEnum, uint32_t>;
+  atomic_enum_flags<TestEnum, uint32_t> f;
+
+  EXPECT_FALSE(f.test_and_set(TestEnum::One));
+  EXPECT_TRUE(f.test_and_set(TestEnum::One));
+  EXPECT_TRUE(f.test_and_unset(TestEnum::One));
+  EXPECT_FALSE(f.test_and_unset(TestEnum::One));
+
+  /// Set Seven only if One is set and Nine is not
+  EXPECT_FALSE(f.transition(TestEnum::One, TestEnum::Nine, TestEnum::Seven));
+  f.set({ TestEnum::One, TestEnum::Nine });
+  flags observed;
+  EXPECT_FALSE(f.transition(TestEnum::One, TestEnum::Nine, TestEnum::Seven, {}, std::memory_order_acq_rel, &observed));
+  EXPECT_EQ(observed, (flags{ TestEnum::One, TestEnum::Nine }));
+  f.unset(TestEnum::Nine);
+  EXPECT_TRUE(f.transition(TestEnum::One, TestEnum::Nine, TestEnum::Seven, TestEnum::One, std::memory_order_acq_rel));
+  EXPECT_EQ(f.load(), flags{ TestEnum::Seven });
+
+  flags expected{ TestEnum::Zero };
+  EXPECT_FALSE(f.compare_exchange_strong(expected, TestEnum::Eight));
+  EXPECT_EQ(expected, flags{ TestEnum::Seven });
+  EXPECT_TRUE(f.compare_exchange_strong(expected, TestEnum::Eight, std::memory_order_acq_rel, std::memory_order_acquire));
+
+  EXPECT_EQ(f.update([](flags v) { return v + TestEnum::Zero; }), flags{ TestEnum::Eight });
+  EXPECT_EQ(f.load(), (flags{ TestEnum::Zero, TestEnum::Eight }));
+}
+
+TEST(atomic_enum_flags_test, test_and_set_has_exactly_one_winner)
+{
+  atomic_enum_flags<TestEnum, uint64_t> f;
+  std::atomic<int> winners = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i)
+    threads.emplace_back([&, i] {
+      if (!f.test_and_set(TestEnum::SixtyThree, std::memory_order_acq_rel))
+        ++winners;
+      f.set(TestEnum(i), std::memory_order_relaxed);
+    });
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(winners.load(), 1);
+  EXPECT_EQ(f.load().bits, 0x80000000000000FFull);
+}
+
+TEST(atomic_enum_flags_test, wait_any_and_wait_all_wake_up_on_notify)
+{
+  using flags = enum_flags<TestEnum, uint32_t>;
+  atomic_enum_flags<TestEnum, uint32_t> f;
+
+  std::thread setter([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    f.set_and_notify(TestEnum::Seven, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    f.set_and_notify({ TestEnum::One, TestEnum::Nine }, std::memory_order_release);
+  });
+
+  const auto any = f.wait_any({ TestEnum::Seven, TestEnum::Eight }, false, std::memory_order_acquire);
+  EXPECT_TRUE(any.is_set(TestEnum::Seven));
+  const auto all = f.wait_all({ TestEnum::One, TestEnum::Nine }, true, std::memory_order_acq_rel);
+  EXPECT_TRUE(all.are_all_set({ TestEnum::One, TestEnum::Nine, TestEnum::Seven }));
+  setter.join();
+
+  /// clear_on_exit only clears the waited-for bits
+  EXPECT_EQ(f.load(), flags{ TestEnum::Seven });
+}
+
+TEST(atomic_enum_flags_test, timed_waits)
+{
+  using namespace std::chrono_literals;
+  atomic_enum_flags<TestEnum, uint32_t> f{ TestEnum::One };
+
+  EXPECT_FALSE(f.wait_any_for(TestEnum::Seven, 2ms).has_value());
+  EXPECT_FALSE(f.wait_all_until({ TestEnum::One, TestEnum::Seven }, std::chrono::steady_clock::now() + 2ms).has_value());
+
+  const auto result = f.wait_all_for(TestEnum::One, 1s, true);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_TRUE(result->is_set(TestEnum::One));
+  EXPECT_FALSE(f.load());
+
+  std::thread setter([&] {
+    std::this_thread::sleep_for(5ms);
+    f.set_and_notify(TestEnum::Eight);
+  });
+  EXPECT_TRUE(f.wait_any_for({ TestEnum::Seven, TestEnum::Eight }, 10s).has_value());
+  setter.join();
+
+  EXPECT_TRUE(f.unset_and_notify(TestEnum::Eight).is_set(TestEnum::Eight));
+}
+
+TEST(enum_flags_test, iterates_over_set_flags)
+{
+  using flags = enum_flags<TestEnum, uint8_t>;
+  static_assert(std::ranges::bidirectional_range<flags>);
+  static_assert(std::ranges::borrowed_range<flags>);
+
+  const flags f{ TestEnum::Seven, TestEnum::Zero, TestEnum::One };
+  std::vector<TestEnum> forward(f.begin(), f.end());
+  EXPECT_EQ(forward, (std::vector<TestEnum>{ TestEnum::Zero, TestEnum::One, TestEnum::Seven }));
+
+  std::vector<TestEnum> backward(f.rbegin(), f.rend());
+  EXPECT_EQ(backward, (std::vector<TestEnum>{ TestEnum::Seven, TestEnum::One, TestEnum::Zero }));
+
+  auto it = f.end();
+  EXPECT_EQ(*--it, TestEnum::Seven);
+  EXPECT_EQ(*--it, TestEnum::One);
+  EXPECT_EQ(*it++, TestEnum::One);
+  EXPECT_EQ(*it, TestEnum::Seven);
+
+  auto rit = f.rend();
+  EXPECT_EQ(*--rit, TestEnum::Zero);
+  EXPECT_EQ(*--rit, TestEnum::One);
+  EXPECT_EQ(*rit++, TestEnum::One);
+  EXPECT_EQ(*rit, TestEnum::Zero);
+
+  EXPECT_EQ(flags{}.begin(), flags{}.end());
+  EXPECT_EQ(std::ranges::distance(f), 3);
+  EXPECT_EQ(std::ranges::distance(f | std::views::filter([](TestEnum e) { return e != TestEnum::One; })), 2);
+  EXPECT_EQ(*std::ranges::begin(f | std::views::reverse), TestEnum::Seven);
+
+  static_assert(*enum_flags<TestEnum, uint64_t>{ TestEnum::SixtyThree }.begin() == TestEnum::SixtyThree);
+}
+
+TEST(enum_flags_test, for_each_visits_in_order_and_stops_early)
+{
+  const enum_flags<TestEnum, int64_t> f{ TestEnum::SixtyThree, TestEnum::Nine, TestEnum::Zero };
+  std::vector<TestEnum> seen;
+  f.for_each([&](TestEnum e) { seen.push_back(e); });
+  EXPECT_EQ(seen, (std::vector<TestEnum>{ TestEnum::Zero, TestEnum::Nine, TestEnum::SixtyThree }));
+  EXPECT_TRUE(f.for_each([](TestEnum e) { return e == TestEnum::Nine; }));
+  EXPECT_FALSE(f.for_each([](TestEnum e) { return e == TestEnum::One; }));
+}
+
+TEST(flag_predicates_test, normalize_at_compile_time)
+{
+  using namespace ghassanpl::flag_predicates;
+  using E = TestEnum;
+
+  constexpr auto simple = all_of<E::One, E::Seven> & none_of<E::Nine>;
+  static_assert(simple.mask == flag_bits_v<uint64_t, E::One, E::Seven, E::Nine>);
+  static_assert(simple.expected == flag_bits_v<uint64_t, E::One, E::Seven>);
+  static_assert(simple.any_masks.empty());
+
+  /// Satisfied "any" clauses disappear, single-flag ones become requirements
+  static_assert((all_of<E::One> & any_of<E::One, E::Seven>) == all_of<E::One>);
+  static_assert((none_of<E::One> & any_of<E::One, E::Seven>) == (none_of<E::One> & all_of<E::Seven>));
+  static_assert(any_of<E::Nine> == all_of<E::Nine>);
+
+  /// Contradictions
+  static_assert((all_of<E::One> & none_of<E::One>).never);
+  static_assert((none_of<E::One, E::Seven> & any_of<E::One, E::Seven>).never);
+
+  /// Implied clauses are dropped and the rest are ordered
+  static_assert((any_of<E::One, E::Seven> & any_of<E::One, E::Seven, E::Nine>) == any_of<E::One, E::Seven>);
+  static_assert((any_of<E::One, E::Seven> & any_of<E::Eight, E::Nine>) == (any_of<E::Eight, E::Nine> & any_of<E::One, E::Seven>));
+  static_assert((any_of<E::One, E::Seven> & any_of<E::Eight, E::Nine>).any_masks.size() == 2);
+  static_assert(std::is_same_v<decltype(all_of<E::One> & all_of<E::Seven>), std::remove_const_t<decltype(all_of<E::Seven, E::One>)>>);
+
+  /// Masks must fit the value type
+  static_assert(decltype(all_of<E::Seven>)::fits_in<uint8_t>);
+  static_assert(!decltype(all_of<E::Eight>)::fits_in<uint8_t>);
+}
+
+TEST(flag_predicates_test, evaluates_like_member_functions)
+{
+  using namespace ghassanpl::flag_predicates;
+  using E = TestEnum;
+  using flags = enum_flags<E, uint16_t>;
+
+  constexpr auto predicate = all_of<E::Zero, E::One> & none_of<E::Seven, E::Eight> & any_of<E::Nine, E::Fifteen>;
+  std::vector<flags> values;
+  std::mt19937 rng{ 7 };
+  for (int i = 0; i < 4096; ++i)
+    values.push_back(flags::from_bits(uint16_t(rng())));
+
+  size_t expected_count = 0;
+  std::vector<uint32_t> expected_indices;
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    const auto f = values[i];
+    const bool expected = f.are_all_set(E::Zero, E::One) && !f.are_any_set(E::Seven, E::Eight) && (f.is_set(E::Nine) || f.is_set(E::Fifteen));
+    EXPECT_EQ(predicate(f), expected);
+    EXPECT_EQ(predicate(f.bits), expected);
+    if (expected)
+    {
+      ++expected_count;
+      expected_indices.push_back(uint32_t(i));
+    }
+  }
+
+  const std::span<flags const> span{ values };
+  EXPECT_EQ(predicate.count(span), expected_count);
+
+  std::vector<uint32_t> indices(values.size());
+  indices.resize(predicate.filter(span, std::span{ indices }));
+  EXPECT_EQ(indices, expected_indices);
+
+  auto results = std::make_unique<bool[]>(values.size());
+  predicate.evaluate(span, std::span{ results.get(), values.size() });
+  EXPECT_EQ(size_t(std::count(results.get(), results.get() + values.size(), true)), expected_count);
+
+  static_assert(!(all_of<E::One> & none_of<E::One>)(flags{ E::One }));
+  static_assert((all_of<E::One> & any_of<E::Seven, E::Nine>)(flags{ E::One, E::Nine }));
+}
+
+enum class FiveFlags { A, B, C, D, E };
+enum class TwentyFlags { First, Last = 19 };
+enum class FortyFlags { First, Last = 39 };
+
+template <> struct ghassanpl::enum_flags_traits<FiveFlags> { static constexpr FiveFlags last = FiveFlags::E; };
+template <> struct ghassanpl::enum_flags_traits<TwentyFlags> { static constexpr TwentyFlags last = TwentyFlags::Last; };
+template <> struct ghassanpl::enum_flags_traits<FortyFlags> { static constexpr FortyFlags last = FortyFlags::Last; };
+
+TEST(enum_flags_traits_test, picks_smallest_value_type)
+{
+  static_assert(std::is_same_v<enum_flags_for<FiveFlags>::value_type, uint8_t>);
+  static_assert(std::is_same_v<enum_flags_for<TwentyFlags>::value_type, uint32_t>);
+  static_assert(std::is_same_v<enum_flags_for<FortyFlags>::value_type, uint64_t>);
+  static_assert(sizeof(enum_flags_for<FiveFlags>) == 1);
+  static_assert(declared_flag_count<TwentyFlags> == 20);
+
+  enum_flags_for<FiveFlags> f{ FiveFlags::A, FiveFlags::E };
+  EXPECT_TRUE(f.are_all_set(FiveFlags::A, FiveFlags::E));
+  EXPECT_FALSE(f.is_set(FiveFlags::C));
+}
+
+TEST(enum_flags_traits_test, all_returns_only_valid_bits)
+{
+  EXPECT_EQ(enum_flags_for<FiveFlags>::all().bits, 0x1Fu);
+  EXPECT_EQ((enum_flags<FiveFlags, uint64_t>::all().bits), 0x1Fu);
+  EXPECT_EQ(enum_flags_for<TwentyFlags>::all().bits, 0xFFFFFu);
+  EXPECT_EQ(enum_flags_for<FortyFlags>::all().bits, 0xFFFFFFFFFFull);
+  EXPECT_EQ((enum_flags<TestEnum, uint16_t>::all().bits), 0xFFFFu);
+}
+
+TEST(enum_flags_traits_test, flag_bits_v_rejects_undeclared_enumerators)
+{
+  EXPECT_TRUE((flag_bits_v_overload_exists<uint64_t, FiveFlags::E>));
+  EXPECT_FALSE((flag_bits_v_overload_exists<uint64_t, FiveFlags(5)>));
+  EXPECT_FALSE((flag_bits_v_overload_exists<uint64_t, FiveFlags::A, FiveFlags(6)>));
+  EXPECT_TRUE((flag_bits_v_overload_exists<uint32_t, TwentyFlags::Last>));
+  EXPECT_FALSE((flag_bits_v_overload_exists<uint32_t, TwentyFlags(20)>));
+}
+
+namespace string_test
+{
+  enum class Permission : uint8_t { Read, Write, Exec, Delete = 5, ReadWriteLongName };
+}
+template <> struct ghassanpl::enum_flags_traits<string_test::Permission> { static constexpr auto last = string_test::Permission::ReadWriteLongName; };
+
+TEST(enum_flags_string_test, extracts_enumerator_names)
+{
+  using string_test::Permission;
+  static_assert(flag_name(Permission::Read) == "Read");
+  static_assert(flag_name(Permission::ReadWriteLongName) == "ReadWriteLongName");
+  static_assert(flag_name(Permission(3)).empty());
+  static_assert(flag_name(TestEnum::Nine) == "Nine");
+  static_assert(flag_name(TestEnum(2)).empty());
+}
+
+TEST(enum_flags_string_test, to_chars_writes_names)
+{
+  using string_test::Permission;
+  using flags = enum_flags_for<Permission>;
+  EXPECT_EQ(to_string(flags{ Permission::Read, Permission::Write, Permission::Exec }), "Read|Write|Exec");
+  EXPECT_EQ(to_string(flags{}), "");
+  EXPECT_EQ(to_string(flags::from_bits(0b1001), ','), "Read,3");
+  EXPECT_EQ(to_string(enum_flags<TestEnum>{ TestEnum::One, TestEnum(40), TestEnum::SixtyThree }), "One|40|SixtyThree");
+  EXPECT_EQ(to_string(enum_flags<Permission, uint64_t>::all()), "Read|Write|Exec|3|4|Delete|ReadWriteLongName");
+
+  char buffer[16];
+  auto result = to_chars(std::begin(buffer), std::end(buffer), flags{ Permission::Read, Permission::Write });
+  EXPECT_EQ(result.ec, std::errc{});
+  EXPECT_EQ(std::string_view(buffer, result.ptr), "Read|Write");
+  result = to_chars(std::begin(buffer), std::begin(buffer) + 7, flags{ Permission::Read, Permission::Write });
+  EXPECT_EQ(result.ec, std::errc::value_too_large);
+}
+
+TEST(enum_flags_string_test, from_chars_parses_names_and_indices)
+{
+  using string_test::Permission;
+  using flags = enum_flags_for<Permission>;
+  const auto parse = [](std::string_view text, flags& out, char separator = '|') {
+    return from_chars(text.data(), text.data() + text.size(), out, separator).ec;
+  };
+
+  flags f;
+  EXPECT_EQ(parse("Read|Write|Exec", f), std::errc{});
+  EXPECT_EQ(f, (flags{ Permission::Read, Permission::Write, Permission::Exec }));
+  EXPECT_EQ(parse(" Delete , 3 ,ReadWriteLongName ", f, ','), std::errc{});
+  EXPECT_EQ(f, (flags{ Permission::Delete, Permission(3), Permission::ReadWriteLongName }));
+  EXPECT_EQ(parse("", f), std::errc{});
+  EXPECT_FALSE(f);
+
+  f = flags{ Permission::Exec };
+  EXPECT_EQ(parse("Read|Wrte", f), std::errc::invalid_argument);
+  EXPECT_EQ(parse("Read||Write", f), std::errc::invalid_argument);
+  EXPECT_EQ(parse("8", f), std::errc::invalid_argument);
+  EXPECT_EQ(parse("Rea", f), std::errc::invalid_argument);
+  EXPECT_EQ(f, flags{ Permission::Exec });
+
+  std::mt19937_64 rng{ 9 };
+  for (int i = 0; i < 100; ++i)
+  {
+    const auto original = enum_flags<TestEnum>::from_bits(rng());
+    const auto text = to_string(original);
+    enum_flags<TestEnum> parsed;
+    EXPECT_EQ(from_chars(text.data(), text.data() + text.size(), parsed).ec, std::errc{});
+    EXPECT_EQ(parsed, original);
+  }
+}
+
+TEST(flag_entity_bitmap_test, containers_convert_between_forms)
+{
+  flag_entity_bitmap bitmap;
+  std::vector<flag_entity_id> expected;
+  /// Sparse in the first container, dense in the second, one long run in the third
+  for (flag_entity_id id = 0; id < 65536; id += 97) expected.push_back(id);
+  for (flag_entity_id id = 65536; id < 2 * 65536; id += 3) expected.push_back(id);
+  for (flag_entity_id id = 2 * 65536 + 100; id < 2 * 65536 + 60000; ++id) expected.push_back(id);
+  for (auto id : expected) EXPECT_TRUE(bitmap.add(id));
+  EXPECT_FALSE(bitmap.add(expected[5]));
+  EXPECT_EQ(bitmap.cardinality(), expected.size());
+  EXPECT_EQ(bitmap.to_vector(), expected);
+
+  const auto before = bitmap.memory_usage();
+  bitmap.optimize();
+  EXPECT_LT(bitmap.memory_usage(), before);
+  EXPECT_EQ(bitmap.to_vector(), expected);
+  EXPECT_TRUE(bitmap.contains(2 * 65536 + 100));
+  EXPECT_TRUE(bitmap.contains(2 * 65536 + 59999));
+  EXPECT_FALSE(bitmap.contains(2 * 65536 + 60000));
+  EXPECT_FALSE(bitmap.contains(2 * 65536 + 99));
+
+  /// Modifying a run container works, and removing values from a bitmap container turns it back into an array
+  EXPECT_TRUE(bitmap.remove(2 * 65536 + 200));
+  EXPECT_FALSE(bitmap.contains(2 * 65536 + 200));
+  for (flag_entity_id id = 65536; id < 2 * 65536 - 10000; id += 3) EXPECT_TRUE(bitmap.remove(id));
+  EXPECT_FALSE(bitmap.remove(65537));
+  std::erase_if(expected, [](flag_entity_id id) { return (id >= 65536 && id < 2 * 65536 - 10000) || id == 2 * 65536 + 200; });
+  EXPECT_EQ(bitmap.to_vector(), expected);
+}
+
+TEST(flag_entity_bitmap_test, set_operations_match_std_algorithms)
+{
+  std::mt19937 rng{ 10 };
+  for (auto density : { 50u, 5000u, 50000u })
+  {
+    flag_entity_bitmap a, b;
+    std::vector<flag_entity_id> va, vb;
+    for (unsigned i = 0; i < density * 3; ++i) { a.add(rng() % (3 * 65536)); b.add(rng() % (3 * 65536)); }
+    if (density == 50000u) b.optimize();
+    va = a.to_vector(); vb = b.to_vector();
+
+    std::vector<flag_entity_id> expected;
+    std::set_intersection(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+    EXPECT_EQ((a & b).to_vector(), expected);
+    expected.clear();
+    std::set_union(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+    EXPECT_EQ((a | b).to_vector(), expected);
+    expected.clear();
+    std::set_difference(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(expected));
+    EXPECT_EQ((a - b).to_vector(), expected);
+  }
+}
+
+TEST(enum_flags_index_test, queries_match_scan)
+{
+  using flags = enum_flags<int, uint16_t>;
+  std::mt19937 rng{ 11 };
+  std::vector<flags> entities(200000);
+  for (auto& f : entities) f = flags::from_bits(uint16_t(rng() & rng()));
+  enum_flags_index<int, uint16_t> index{ std::span<flags const>{ entities } };
+
+  const auto check = [&](flags all, flags any, flags none) {
+    std::vector<flag_entity_id> expected;
+    for (size_t i = 0; i < entities.size(); ++i)
+      if (entities[i].are_all_set(all) && entities[i].are_any_set(any) && !(entities[i].bits & none.bits))
+        expected.push_back(flag_entity_id(i));
+    EXPECT_EQ(index.query(all, any, none).to_vector(), expected);
+    EXPECT_EQ(index.count(all, any, none), expected.size());
+  };
+  check({ 1, 3 }, {}, { 2 });
+  check({}, { 4, 5, 6 }, {});
+  check({ 0 }, { 7, 8 }, { 9, 10 });
+  check({}, {}, { 11 });
+  check({}, {}, {});
+
+  /// Incremental updates
+  for (int i = 0; i < 1000; ++i)
+  {
+    const auto id = flag_entity_id(rng() % entities.size());
+    const auto change = flags::from_bits(uint16_t(rng()));
+    switch (i % 4)
+    {
+    case 0: index.set(id, change); entities[id].set(change); break;
+    case 1: index.unset(id, change); entities[id].unset(change); break;
+    case 2: index.toggle(id, change); entities[id].toggle(change); break;
+    case 3: index.update(id, entities[id], change); entities[id] = change; break;
+    }
+    EXPECT_EQ(index.flags_of(id), entities[id]);
+  }
+  check({ 1, 3 }, {}, { 2 });
+  check({ 0 }, { 7, 8 }, { 9, 10 });
+
+  index.erase(5);
+  EXPECT_FALSE(index.contains(5));
+  EXPECT_EQ(index.flags_of(5), flags{});
+  EXPECT_EQ(index.size(), entities.size() - 1);
+}
+
+TEST(enum_flags_index_test, ignores_undeclared_bits)
+{
+  using flags = enum_flags<FiveFlags, uint8_t>;
+  using enum FiveFlags;
+  enum_flags_index<FiveFlags, uint8_t> index;
+  static_assert(decltype(index)::flag_count == 5);
+
+  const auto high = flags::from_bits(0xE0);
+  index.insert(1, high);
+  index.insert(2, flags::from_bits(0xE0 | 0x03));
+  index.set(3, high);
+  index.toggle(2, flags::from_bits(0x80 | 0x01));
+  index.unset(1, high);
+  EXPECT_FALSE(index.contains(3));
+  EXPECT_EQ(index.flags_of(1), flags{});
+  EXPECT_EQ(index.flags_of(2), flags{ B });
+  EXPECT_FALSE(index.is_set(2, FiveFlags(7)));
+  EXPECT_TRUE(index.entities_with(FiveFlags(6)).empty());
+
+  EXPECT_TRUE(index.query(flags::from_bits(0x02 | 0x20)).empty());
+  EXPECT_EQ(index.count(flags{ B }, flags::from_bits(0x40), flags::from_bits(0x80)), 1u);
+  EXPECT_EQ(index.count({}, {}, flags::from_bits(0xE0)), 2u);
+}
+
+template <typename VALUE_TYPE>
+class enum_flags_histogram_test : public ::testing::Test {};
+TYPED_TEST_SUITE(enum_flags_histogram_test, column_value_types);
+
+TYPED_TEST(enum_flags_histogram_test, kernels_match_naive_count)
+{
+  using flags = enum_flags<int, TypeParam>;
+  using U = std::make_unsigned_t<TypeParam>;
+  std::mt19937_64 rng{ 12 };
+  for (size_t size : { size_t(0), size_t(7), size_t(1000), size_t(100000 + 13) })
+  {
+    std::vector<flags> values(size);
+    for (auto& f : values) f = flags::from_bits(static_cast<TypeParam>(rng() & rng()));
+    values.push_back(flags::all());
+
+    detail::bit_counts<U> expected{};
+    for (auto f : values) f.for_each([&](int flag) { ++expected[flag]; });
+    const auto data = detail::column_bits(std::span<flags const>{ values });
+
+    const auto result = count_each_flag(std::span<flags const>{ values });
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), result.counts.begin()));
+    EXPECT_EQ(result, count_each_flag(std::span<flags const>{ values }, 4));
+
+    detail::bit_counts<U> counts{};
+    detail::count_each_flag_scalar(data, values.size(), counts);
+    EXPECT_EQ(counts, expected);
+    if (detail::get_cpu_features().avx2)
+    {
+      counts = {};
+      detail::count_each_flag_avx2(data, values.size(), counts);
+      EXPECT_EQ(counts, expected);
+    }
+  }
+}
+
+TEST(enum_flags_histogram_test, splits_large_inputs_across_threads)
+{
+  using flags = enum_flags_for<string_test::Permission>;
+  std::vector<flags> values(count_each_flag_min_chunk * 3 + 5, flags{ string_test::Permission::Write });
+  values.back().set(string_test::Permission::ReadWriteLongName);
+  const auto result = count_each_flag(std::span<flags const>{ values }, 8);
+  static_assert(result.flag_count == declared_flag_count<string_test::Permission>);
+  EXPECT_EQ(result[string_test::Permission::Write], values.size());
+  EXPECT_EQ(result[string_test::Permission::ReadWriteLongName], 1u);
+  EXPECT_EQ(result[string_test::Permission::Read], 0u);
+  EXPECT_EQ(result, count_each_flag(std::span<flags const>{ values }));
+}
+
+TEST(enum_flags_sliced_column_test, transpose_64x64_swaps_rows_and_columns)
+{
+  std::mt19937_64 rng{ 64 };
+  std::array<uint64_t, 64> rows, transposed;
+  for (auto& row : rows) row = rng();
+  transposed = rows;
+  transpose_bits_64x64(transposed);
+  for (size_t r = 0; r < 64; ++r)
+    for (size_t c = 0; c < 64; ++c)
+      ASSERT_EQ((rows[r] >> c) & 1, (transposed[c] >> r) & 1);
+  transpose_bits_64x64(transposed);
+  EXPECT_EQ(transposed, rows);
+}
+
+template <typename VALUE_TYPE>
+class enum_flags_sliced_column_test : public ::testing::Test {};
+TYPED_TEST_SUITE(enum_flags_sliced_column_test, column_value_types);
+
+TYPED_TEST(enum_flags_sliced_column_test, matches_enum_flags_column)
+{
+  using sliced = enum_flags_sliced_column<int, TypeParam>;
+  using flags = typename sliced::flags_type;
+
+  std::mt19937_64 rng{ 4321 };
+  for (size_t size : { size_t(0), size_t(63), size_t(64), size_t(1000 + 13), size_t(256 * 64 + 100) })
+  {
+    enum_flags_column<int, TypeParam> col;
+    for (size_t i = 0; i < size; ++i)
+      col.push_back(flags::from_bits(static_cast<TypeParam>(rng())));
+
+    const sliced s{ std::span<flags const>{ col } };
+    ASSERT_EQ(s.size(), col.size());
+    std::vector<flags> back(s.size());
+    s.copy_to(back);
+    EXPECT_TRUE(std::equal(back.begin(), back.end(), col.begin()));
+    for (size_t i = 0; i < s.size(); i += 7)
+      EXPECT_EQ(s.get(i), col[i]);
+
+    for (auto [required, forbidden] : { std::pair{ flags{ 1, 3 }, flags{ 2 } }, std::pair{ flags{}, flags{ 0, 5 } }, std::pair{ flags{}, flags{} } })
+    {
+      EXPECT_EQ(s.count(required, forbidden), col.count(required, forbidden));
+      EXPECT_EQ(s.filter(required, forbidden), col.filter(required, forbidden));
+    }
+
+    const uint64_t* required[] = { s.plane(1).data(), s.plane(3).data() };
+    const uint64_t* forbidden[] = { s.plane(2).data() };
+    std::vector<uint32_t> out(s.size());
+    out.resize(detail::sliced_filter_scalar(required, 2, forbidden, 1, s.size(), out.data()));
+    EXPECT_EQ(out, col.filter(flags{ 1, 3 }, flags{ 2 }));
+    EXPECT_EQ(detail::sliced_count_scalar(required, 2, forbidden, 1, s.size()), out.size());
+
+    /// The words past the last element must be clear, or growing would expose them as set flags
+    sliced grown{ std::span<flags const>{ col } };
+    grown.resize(size + 200);
+    EXPECT_EQ(grown.count({}, {}), size + 200);
+    for (int f = 0; f < int(sliced::flag_count); ++f)
+      EXPECT_EQ(grown.count(flags{ f }), col.count(flags{ f }));
+  }
+}
+
+TEST(enum_flags_sliced_column_test, element_updates)
+{
+  using sliced = enum_flags_sliced_column<string_test::Permission, std::uint8_t>;
+  using flags = sliced::flags_type;
+  using enum string_test::Permission;
+  static_assert(sliced::flag_count == declared_flag_count<string_test::Permission>);
+
+  sliced s{ 100, flags{ Read } };
+  EXPECT_EQ(s.count(flags{ Read }), 100u);
+
+  s.set(70, flags{ Write, Delete });
+  s.unset(70, flags{ Read });
+  s.toggle(3, flags{ Exec, Read });
+  EXPECT_EQ(s.get(70), (flags{ Write, Delete }));
+  EXPECT_EQ(s[3], flags{ Exec });
+  EXPECT_TRUE(s.is_set(70, Delete));
+  EXPECT_FALSE(s.is_set(70, Read));
+  EXPECT_EQ(s.filter(flags{ Write }), std::vector<uint32_t>{ 70 });
+  EXPECT_EQ(s.count({}, flags{ Read }), 2u);
+  EXPECT_EQ(s.plane(Delete)[1], uint64_t(1) << 6);
+
+  s.push_back(flags{ ReadWriteLongName });
+  s.set_to(true, 100, flags{ Exec });
+  EXPECT_EQ(s.size(), 101u);
+  EXPECT_EQ(s.get(100), (flags{ Exec, ReadWriteLongName }));
+  s.assign(70, flags{ Read });
+  EXPECT_EQ(s.count(flags{ Read }), 99u);
+
+  s.resize(50);
+  s.resize(120, flags{ Exec });
+  EXPECT_EQ(s.count(flags{ Exec }), 71u);
+  EXPECT_EQ(s.count(flags{ Read }), 49u);
+  EXPECT_EQ(s.count(flags{ Delete }), 0u);
+}
+
+namespace mapping_test
+{
+  enum class Access { Read, Write, Exec, Create, Truncate, Append, Sync, Direct, Temporary };
+  enum class Legacy { Read = 0, Write = 4, Create = 9, Truncate = 15, Append = 22, Sync = 31 };
+  enum class Os { R = 0, W = 1, X = 2, Creat = 6, Trunc = 9, Append = 10, Sync = 20, Direct = 14, Tmp = 22 };
+
+  using contiguous = flag_mapping<Access, Os, flag_pair{ Access::Read, Os::R }, flag_pair{ Access::Write, Os::W }, flag_pair{ Access::Exec, Os::X }>;
+  using ordered = flag_mapping<Legacy, Os, flag_pair{ Legacy::Read, Os::R }, flag_pair{ Legacy::Write, Os::W }, flag_pair{ Legacy::Create, Os::Creat },
+    flag_pair{ Legacy::Truncate, Os::Trunc }, flag_pair{ Legacy::Append, Os::Append }, flag_pair{ Legacy::Sync, Os::Tmp }>;
+  using scrambled = flag_mapping<Access, Os, flag_pair{ Access::Read, Os::R }, flag_pair{ Access::Write, Os::W }, flag_pair{ Access::Create, Os::Creat },
+    flag_pair{ Access::Truncate, Os::Trunc }, flag_pair{ Access::Append, Os::Append }, flag_pair{ Access::Sync, Os::Sync }, flag_pair{ Access::Direct, Os::Direct },
+    flag_pair{ Access::Temporary, Os::Tmp }, flag_pair{ Access::Temporary, Os::Trunc }, flag_pair{ Access::Exec, Os::R }>;
+
+  /// What the mappings replace
+  template <typename FROM>
+  enum_flags<Os, uint32_t> map_with_branches(enum_flags<FROM, uint32_t> in, std::vector<std::pair<FROM, Os>> const& pairs)
+  {
+    enum_flags<Os, uint32_t> out;
+    for (auto [from, to] : pairs)
+      if (in.is_set(from)) out.set(to);
+    return out;
+  }
+}
+
+TEST(flag_mapping_test, picks_strategy_at_compile_time)
+{
+  using namespace mapping_test;
+  static_assert(contiguous::strategy == flag_mapping_strategy::shift);
+  static_assert(ordered::strategy == flag_mapping_strategy::pext_pdep);
+  static_assert(scrambled::strategy == flag_mapping_strategy::byte_table);
+  static_assert(std::is_same_v<contiguous::value_type, uint8_t>);
+  static_assert(std::is_same_v<ordered::value_type, uint32_t>);
+
+  static_assert(contiguous::map(enum_flags<Access, uint16_t>{ Access::Write, Access::Exec, Access::Append }) == enum_flags<Os, uint8_t>{ Os::W, Os::X });
+  static_assert(ordered::map(enum_flags<Legacy, uint32_t>{ Legacy::Create, Legacy::Sync }) == enum_flags<Os, uint32_t>{ Os::Creat, Os::Tmp });
+  static_assert(scrambled::map(enum_flags<Access, uint16_t>{ Access::Temporary, Access::Exec }) == enum_flags<Os, uint32_t>{ Os::Tmp, Os::Trunc, Os::R });
+
+  using permissions = flag_mapping<Access, string_test::Permission, flag_pair{ Access::Read, string_test::Permission::Read }>;
+  static_assert(std::is_same_v<permissions::value_type, flag_value_type_for<string_test::Permission>>);
+}
+
+template <typename MAPPING, typename FROM>
+static void check_mapping(std::vector<std::pair<FROM, mapping_test::Os>> const& pairs)
+{
+  using namespace mapping_test;
+  std::mt19937_64 rng{ 13 };
+  std::vector<enum_flags<FROM, uint32_t>> in(1000);
+  for (auto& f : in) f = enum_flags<FROM, uint32_t>::from_bits(uint32_t(rng()));
+
+  std::vector<enum_flags<Os, uint32_t>> out(in.size());
+  MAPPING::map(std::span<enum_flags<FROM, uint32_t> const>{ in }, std::span<enum_flags<Os, uint32_t>>{ out });
+  for (size_t i = 0; i < in.size(); ++i)
+  {
+    const auto expected = map_with_branches(in[i], pairs);
+    ASSERT_EQ(MAPPING{}.template operator()<uint32_t>(in[i]), expected);
+    ASSERT_EQ(out[i], expected);
+  }
+
+#if defined(GHASSANPL_X86) && (defined(__x86_64__) || defined(_M_X64))
+  if constexpr (MAPPING::strategy == flag_mapping_strategy::pext_pdep)
+  {
+    if (detail::get_cpu_features().bmi2)
+    {
+      std::vector<enum_flags<Os, uint32_t>> pdep_out(in.size());
+      detail::map_flags_bmi2<MAPPING::from_mask, MAPPING::to_mask>(in.data(), pdep_out.data(), in.size());
+      EXPECT_EQ(pdep_out, out);
+    }
+  }
+#endif
+}
+
+TEST(flag_mapping_test, strategies_match_branches)
+{
+  using namespace mapping_test;
+  check_mapping<contiguous, Access>({ { Access::Read, Os::R }, { Access::Write, Os::W }, { Access::Exec, Os::X } });
+  check_mapping<ordered, Legacy>({ { Legacy::Read, Os::R }, { Legacy::Write, Os::W }, { Legacy::Create, Os::Creat }, { Legacy::Truncate, Os::Trunc },
+    { Legacy::Append, Os::Append }, { Legacy::Sync, Os::Tmp } });
+  check_mapping<scrambled, Access>({ { Access::Read, Os::R }, { Access::Write, Os::W }, { Access::Create, Os::Creat }, { Access::Truncate, Os::Trunc },
+    { Access::Append, Os::Append }, { Access::Sync, Os::Sync }, { Access::Direct, Os::Direct }, { Access::Temporary, Os::Tmp },
+    { Access::Temporary, Os::Trunc }, { Access::Exec, Os::R } });
+}
+
+TEST(enum_flags_subsets_test, ranges_are_constexpr)
+{
+  using flags = enum_flags<int, uint8_t>;
+  constexpr auto count = [](auto range) { size_t n = 0; for (auto f : range) { (void)f; ++n; } return n; };
+  static_assert(count(subsets(flags::from_bits(0b1011))) == 8);
+  static_assert(count(subsets(flags{})) == 1);
+  static_assert(count(subsets(flags::all())) == 256);
+  static_assert(count(subsets_of_size(flags::from_bits(0b10110110), 3)) == 10);
+  static_assert(count(subsets_of_size(flags::all(), 8)) == 1);
+  static_assert(count(subsets_of_size(flags::all(), 9)) == 0);
+  static_assert(count(subsets_of_size(flags{}, 0)) == 1);
+  static_assert(count(supersets_within(flags{ 0 }, flags{ 0, 2, 3 })) == 4);
+  static_assert(count(supersets_within(flags{ 1 }, flags{ 0, 2, 3 })) == 0);
+
+  static_assert(std::ranges::view<flag_subsets_view<int, uint8_t>> && std::ranges::borrowed_range<flag_subsets_view<int, uint8_t>>);
+  static_assert(std::ranges::view<flag_combinations_view<int, uint8_t>> && std::ranges::forward_range<flag_combinations_view<int, uint8_t>>);
+
+  auto with_first = subsets(flags{ 0, 1, 3 }) | std::views::filter([](flags f) { return f.is_set(0); });
+  std::vector<flags> found;
+  std::ranges::copy(with_first, std::back_inserter(found));
+  EXPECT_EQ(found, (std::vector<flags>{ flags{ 0 }, flags{ 0, 1 }, flags{ 0, 3 }, flags{ 0, 1, 3 } }));
+}
+
+template <typename VALUE_TYPE>
+class enum_flags_subsets_test : public ::testing::Test {};
+using subset_value_types = ::testing::Types<uint8_t, int16_t, uint64_t>;
+TYPED_TEST_SUITE(enum_flags_subsets_test, subset_value_types);
+
+TYPED_TEST(enum_flags_subsets_test, match_brute_force)
+{
+  using flags = enum_flags<int, TypeParam>;
+  using U = std::make_unsigned_t<TypeParam>;
+  std::mt19937_64 rng{ 99 };
+  for (int round = 0; round < 20; ++round)
+  {
+    /// Up to 10 flags anywhere in the value, so brute force over their sub-masks stays cheap
+    U mask = 0, universe = 0;
+    for (int i = 0; i < 10; ++i) mask |= U(U(1) << (rng() % (CHAR_BIT * sizeof(U))));
+    universe = mask;
+    mask &= U(rng());
+
+    std::vector<flags> all;
+    for (U s = 0;; s = U((s - universe) & universe))
+    {
+      all.push_back(flags::from_bits(TypeParam(s)));
+      if (s == universe) break;
+    }
+    std::ranges::sort(all, {}, [](flags f) { return U(f.bits); });
+
+    auto as_vector = [](auto const& range) { std::vector<flags> result; std::ranges::copy(range, std::back_inserter(result)); return result; };
+    EXPECT_EQ(as_vector(subsets(flags::from_bits(TypeParam(universe)))), all);
+
+    std::vector<flags> expected;
+    std::ranges::copy_if(all, std::back_inserter(expected), [&](flags f) { return (U(f.bits) & U(mask)) == U(mask); });
+    EXPECT_EQ(as_vector(supersets_within(flags::from_bits(TypeParam(mask)), flags::from_bits(TypeParam(universe)))), expected);
+
+    for (size_t k = 0; k <= 11; ++k)
+    {
+      expected.clear();
+      std::ranges::copy_if(all, std::back_inserter(expected), [&](flags f) { return size_t(std::popcount(U(f.bits))) == k; });
+      EXPECT_EQ(as_vector(subsets_of_size(flags::from_bits(TypeParam(universe)), k)), expected);
+    }
+  }
+}
+
+template <typename VALUE_TYPE>
+class enum_flags_algorithms_test : public ::testing::Test {};
+TYPED_TEST_SUITE(enum_flags_algorithms_test, column_value_types);
+
+TYPED_TEST(enum_flags_algorithms_test, match_std_algorithms)
+{
+  using flags = enum_flags<int, TypeParam>;
+  using U = std::make_unsigned_t<TypeParam>;
+  std::mt19937_64 rng{ 15 };
+  const auto mask = flags::from_bits(TypeParam(0b1010'0101));
+  const auto predicate = [mask](flags f) { return (f.bits & mask.bits) == mask.bits; };
+  auto with_bits = [](U bits) { return flags::from_bits(static_cast<TypeParam>(bits)); };
+  for (size_t size : { size_t(0), size_t(7), size_t(1000), flag_algorithms_min_chunk * 3 + 13 })
+  {
+    std::vector<flags> values(size);
+    for (auto& f : values) f = flags::from_bits(static_cast<TypeParam>(rng() | rng()));
+    std::span<flags const> view{ values };
+
+    const auto expected_or = std::accumulate(values.begin(), values.end(), flags{}, [&](flags a, flags b) { return with_bits(U(a.bits | b.bits)); });
+    const auto expected_and = std::accumulate(values.begin(), values.end(), with_bits(U(~U(0))), [&](flags a, flags b) { return with_bits(U(a.bits & b.bits)); });
+    EXPECT_EQ(reduce_or(view), expected_or);
+    EXPECT_EQ(reduce_or(view, 4), expected_or);
+    EXPECT_EQ(reduce_and(view), expected_and);
+    EXPECT_EQ(reduce_and(view, 4), expected_and);
+
+    const auto expected_count = size_t(std::ranges::count_if(values, predicate));
+    EXPECT_EQ(count_if(view, predicate), expected_count);
+    EXPECT_EQ(count_if(view, predicate, 4), expected_count);
+
+    auto updated = values;
+    apply_set(std::span{ updated }, mask, 4);
+    EXPECT_TRUE(std::ranges::equal(updated, values, {}, {}, [&](flags f) { return with_bits(U(f.bits | mask.bits)); }));
+    apply_toggle(std::span{ updated }, mask);
+    EXPECT_TRUE(std::ranges::equal(updated, values, {}, {}, [&](flags f) { return with_bits(U(f.bits & ~mask.bits)); }));
+    updated = values;
+    apply_unset(std::span{ updated }, mask);
+    EXPECT_TRUE(std::ranges::equal(updated, values, {}, {}, [&](flags f) { return with_bits(U(f.bits & ~mask.bits)); }));
+
+    for (unsigned threads : { 1u, 4u })
+    {
+      auto partitioned = values;
+      const auto split = threads == 1 ? partition_by(std::span{ partitioned }, mask) : partition_by(std::span{ partitioned }, mask, threads);
+      EXPECT_EQ(split, expected_count);
+      EXPECT_TRUE(std::all_of(partitioned.begin(), partitioned.begin() + split, predicate));
+      EXPECT_TRUE(std::none_of(partitioned.begin() + split, partitioned.end(), predicate));
+      auto by_bits = [](flags a, flags b) { return U(a.bits) < U(b.bits); };
+      std::ranges::sort(partitioned, by_bits);
+      auto sorted = values;
+      std::ranges::sort(sorted, by_bits);
+      EXPECT_EQ(partitioned, sorted);
+    }
+
+    if (detail::get_cpu_features().avx2 && size > 0)
+    {
+      const auto data = detail::column_bits(view);
+      EXPECT_EQ(detail::reduce_scalar<true>(data, size), detail::reduce_avx2<true>(data, size));
+      EXPECT_EQ(detail::reduce_scalar<false>(data, size), detail::reduce_avx2<false>(data, size));
+    }
+  }
+}
+
+TEST(enum_flags_dictionary_test, hash_spreads_flag_values)
+{
+  using flags = enum_flags<int, uint64_t>;
+  std::unordered_set<flags> set;
+  for (int i = 0; i < 64; ++i) set.insert(flags{ i });
+  EXPECT_EQ(set.size(), 64u);
+  EXPECT_TRUE(set.contains(flags{ 63 }));
+  EXPECT_FALSE(set.contains(flags{}));
+  /// Single-flag values must not collide in the low bits that power-of-two tables use
+  std::set<size_t> buckets;
+  for (auto f : set) buckets.insert(std::hash<flags>{}(f) & 127);
+  EXPECT_GT(buckets.size(), 40u);
+}
+
+TEST(enum_flags_dictionary_test, interns_and_encodes)
+{
+  using flags = enum_flags<int, uint64_t>;
+  enum_flags_dictionary<int, uint64_t> dict;
+  EXPECT_FALSE(dict.find(flags{ 3 }));
+  EXPECT_EQ(dict.intern(flags{ 3 }), 0);
+  EXPECT_EQ(dict.intern(flags{ 1, 60 }), 1);
+  EXPECT_EQ(dict.intern(flags{ 3 }), 0);
+  EXPECT_EQ(dict.find(flags{ 1, 60 }), 1);
+  EXPECT_EQ(dict[1], (flags{ 1, 60 }));
+
+  /// 300 distinct values: the first 256 get 8-bit IDs, then encoding stops
+  std::vector<flags> values;
+  for (uint64_t i = 0; i < 300; ++i) values.push_back(flags::from_bits(i * 0x0101010101010101ull + 7));
+  std::vector<uint8_t> narrow(values.size());
+  EXPECT_EQ(dict.encode(std::span<flags const>{ values }, std::span{ narrow }), 254u);
+  EXPECT_EQ(dict.size(), 256u);
+  EXPECT_EQ(dict.id_bytes(), 1u);
+  std::vector<uint16_t> wide(values.size());
+  EXPECT_EQ(dict.encode(std::span<flags const>{ values }, std::span{ wide }), values.size());
+  EXPECT_EQ(dict.id_bytes(), 2u);
+
+  std::vector<flags> decoded(values.size());
+  dict.decode(std::span<uint16_t const>{ wide }, std::span{ decoded });
+  EXPECT_EQ(decoded, values);
+  for (size_t i = 0; i < values.size(); ++i) EXPECT_EQ(dict.find(values[i]), wide[i]);
+
+  while (!dict.full()) ASSERT_TRUE(dict.intern(flags::from_bits(uint64_t(dict.size()) << 20)));
+  EXPECT_FALSE(dict.intern(flags::from_bits(~uint64_t(0))));
+  EXPECT_EQ(dict.intern(flags{ 3 }), 0);
+}
+
+TEST(enum_flags_dictionary_test, column_matches_plain_column)
+{
+  using flags = enum_flags<int, uint64_t>;
+  std::mt19937_64 rng{ 16 };
+  std::vector<flags> distinct(400);
+  for (auto& f : distinct) f = flags::from_bits(rng() & rng());
+
+  enum_flags_dictionary_column<int, uint64_t> column;
+  std::vector<flags> values;
+  for (size_t round = 0; round < 2; ++round)
+  {
+    /// First only 200 distinct values (8-bit IDs), then all 400
+    std::vector<flags> batch(50000);
+    for (auto& f : batch) f = distinct[rng() % (round == 0 ? 200 : 400)];
+    EXPECT_EQ(column.append(std::span<flags const>{ batch }), batch.size());
+    values.insert(values.end(), batch.begin(), batch.end());
+    EXPECT_EQ(column.wide(), round == 1);
+    EXPECT_EQ(column.size(), values.size());
+
+    std::vector<flags> decoded(column.size());
+    column.copy_to(std::span{ decoded });
+    EXPECT_EQ(decoded, values);
+    EXPECT_EQ(column[values.size() - 1], values.back());
+
+    const auto predicate = [](flags f) { return f.is_set(2) && !f.is_set(5); };
+    const auto selection = column.filter(predicate);
+    std::vector<flag_selection_index> expected;
+    for (size_t i = 0; i < values.size(); ++i) if (predicate(values[i])) expected.push_back(flag_selection_index(i));
+    EXPECT_EQ(selection, expected);
+    EXPECT_EQ(column.count(predicate), expected.size());
+
+    const auto groups = column.group();
+    EXPECT_EQ(groups.group_count(), column.dictionary().size());
+    size_t total = 0;
+    for (size_t id = 0; id < groups.group_count(); ++id)
+    {
+      const auto rows = groups.indices_of(id);
+      total += rows.size();
+      EXPECT_TRUE(std::ranges::is_sorted(rows));
+      EXPECT_TRUE(std::ranges::all_of(rows, [&](auto row) { return values[row] == column.dictionary()[uint16_t(id)]; }));
+    }
+    EXPECT_EQ(total, values.size());
+  }
+  EXPECT_LT(column.storage_bytes(), values.size() * sizeof(flags) / 3);
+}
+
+namespace stream_test
+{
+  /// Frames where a few values change per tick, and every 50th frame changes all of them
+  template <typename FLAGS>
+  std::vector<std::vector<FLAGS>> make_frames(size_t frame_count, size_t entity_count, uint64_t seed)
+  {
+    std::mt19937_64 rng{ seed };
+    std::vector<std::vector<FLAGS>> frames(frame_count, std::vector<FLAGS>(entity_count));
+    for (size_t f = 0; f < frame_count; ++f)
+    {
+      if (f > 0) frames[f] = frames[f - 1];
+      const size_t changes = f % 50 == 0 ? entity_count : rng() % 4;
+      for (size_t c = 0; c < changes; ++c)
+        frames[f][f % 50 == 0 ? c : rng() % entity_count].toggle(int(rng() % (CHAR_BIT * sizeof(typename FLAGS::value_type))));
+    }
+    return frames;
+  }
+
+  template <typename FLAGS>
+  std::string write(std::vector<std::vector<FLAGS>> const& frames, size_t entity_count, size_t frames_per_block)
+  {
+    std::ostringstream out{ std::ios::binary };
+    enum_flags_stream_writer<int, typename FLAGS::value_type> writer{ out, entity_count, frames_per_block };
+    for (auto const& frame : frames) writer.write_frame(std::span<FLAGS const>{ frame });
+    writer.finish();
+    EXPECT_EQ(writer.bytes_written(), out.str().size());
+    return out.str();
+  }
+
+  inline std::span<std::byte const> as_bytes(std::string const& s) { return std::as_bytes(std::span{ s }); }
+
+  /// Accepts `capacity` bytes, then fails every write, like a full disk
+  struct full_buffer : std::streambuf
+  {
+    explicit full_buffer(size_t capacity) : left(capacity) {}
+    size_t left;
+    std::streamsize xsputn(char const*, std::streamsize count) override
+    {
+      const auto accepted = std::min<std::streamsize>(count, std::streamsize(left));
+      left -= size_t(accepted);
+      return accepted;
+    }
+    int_type overflow(int_type ch) override { return xsputn(nullptr, 1) == 1 ? ch : traits_type::eof(); }
+  };
+}
+
+TEST(enum_flags_stream_test, round_trips_and_seeks)
+{
+  using flags = enum_flags<int, uint64_t>;
+  const auto frames = stream_test::make_frames<flags>(300, 1000, 17);
+  const auto stream = stream_test::write(frames, 1000, 64);
+  EXPECT_LT(stream.size(), frames.size() * 1000 * sizeof(flags) / 10);
+
+  const auto reader = enum_flags_stream_reader<int, uint64_t>::open(stream_test::as_bytes(stream));
+  ASSERT_TRUE(reader);
+  EXPECT_EQ(reader->frame_count(), 300u);
+  EXPECT_EQ(reader->entity_count(), 1000u);
+  EXPECT_EQ(reader->block_count(), 5u);
+  EXPECT_EQ(reader->stored_value_bits(), 64u);
+
+  size_t seen = 0;
+  EXPECT_TRUE(reader->for_each_frame([&](size_t index, std::span<flags const> frame) {
+    EXPECT_EQ(index, seen++);
+    EXPECT_TRUE(std::ranges::equal(frame, frames[index]));
+  }));
+  EXPECT_EQ(seen, frames.size());
+
+  std::vector<flags> frame(1000);
+  for (size_t index : { 0, 1, 63, 64, 65, 150, 299 })
+  {
+    ASSERT_TRUE(reader->read_frame(index, std::span{ frame }));
+    EXPECT_EQ(frame, frames[index]);
+  }
+  EXPECT_FALSE(reader->read_frame(300, std::span{ frame }));
+}
+
+TEST(enum_flags_stream_test, checks_width_and_corruption)
+{
+  using narrow = enum_flags<int, uint8_t>;
+  const auto frames = stream_test::make_frames<narrow>(40, 100, 18);
+  auto stream = stream_test::write(frames, 100, 16);
+
+  /// Narrower streams can be read into wider values, but not the other way around
+  const auto wide_reader = enum_flags_stream_reader<int, uint32_t>::open(stream_test::as_bytes(stream));
+  ASSERT_TRUE(wide_reader);
+  EXPECT_EQ(wide_reader->stored_value_bits(), 8u);
+  std::vector<enum_flags<int, uint32_t>> frame(100);
+  ASSERT_TRUE(wide_reader->read_frame(39, std::span{ frame }));
+  for (size_t i = 0; i < frame.size(); ++i) EXPECT_EQ(frame[i].bits, frames[39][i].bits);
+
+  const auto wide_stream = stream_test::write(stream_test::make_frames<enum_flags<int, uint32_t>>(3, 10, 19), 10, 16);
+  EXPECT_FALSE((enum_flags_stream_reader<int, uint8_t>::open(stream_test::as_bytes(wide_stream))));
+  EXPECT_FALSE((enum_flags_stream_reader<int, uint8_t>::open(stream_test::as_bytes(stream).first(stream.size() - 1))));
+
+  /// A frame count so large that rounding it up to whole blocks would wrap around to no blocks at all
+  std::vector<std::byte> huge;
+  huge.insert(huge.end(), detail::stream_magic.begin(), detail::stream_magic.end());
+  detail::store_le<uint16_t>(huge, detail::stream_version);
+  detail::store_le<uint16_t>(huge, 8);
+  detail::store_le<uint32_t>(huge, 1);
+  detail::store_le<uint32_t>(huge, 2);
+  detail::store_le<uint64_t>(huge, detail::stream_header_size);
+  detail::store_le<uint64_t>(huge, ~uint64_t{ 0 });
+  huge.insert(huge.end(), detail::stream_end_magic.begin(), detail::stream_end_magic.end());
+  ASSERT_EQ(huge.size(), 36u);
+  EXPECT_FALSE((enum_flags_stream_reader<int, uint8_t>::open(huge)));
+
+  /// Random damage to the frames must be caught or decode to something, but never read out of bounds
+  std::mt19937_64 rng{ 20 };
+  for (int round = 0; round < 200; ++round)
+  {
+    auto damaged = stream;
+    damaged[16 + rng() % (damaged.size() - 16 - 20 - 24)] = char(rng());
+    const auto reader = enum_flags_stream_reader<int, uint8_t>::open(stream_test::as_bytes(damaged));
+    ASSERT_TRUE(reader);
+    reader->for_each_frame([](size_t, std::span<narrow const>) {});
+  }
+}
+
+TEST(enum_flags_stream_test, reports_write_failures)
+{
+  using flags = enum_flags<int, uint32_t>;
+  const auto frames = stream_test::make_frames<flags>(10, 50, 22);
+
+  {
+    stream_test::full_buffer buffer{ 100 };
+    std::ostream out{ &buffer };
+    enum_flags_stream_writer<int, uint32_t> writer{ out, 50 };
+    bool all_written = true;
+    for (auto const& frame : frames) all_written &= writer.write_frame(std::span<flags const>{ frame });
+    EXPECT_FALSE(all_written);
+    EXPECT_FALSE(writer.good());
+    EXPECT_FALSE(writer.finish());
+  }
+
+  {
+    /// A failure while the destructor finishes the stream must not escape it, even with exceptions enabled
+    const auto complete = stream_test::write(frames, 50, 256);
+    stream_test::full_buffer buffer{ complete.size() - 8 };
+    std::ostream out{ &buffer };
+    out.exceptions(std::ios::badbit | std::ios::failbit);
+    enum_flags_stream_writer<int, uint32_t> writer{ out, 50 };
+    for (auto const& frame : frames) EXPECT_TRUE(writer.write_frame(std::span<flags const>{ frame }));
+  }
+
+  {
+    std::ostringstream out{ std::ios::binary };
+    enum_flags_stream_writer<int, uint32_t> writer{ out, 50 };
+    EXPECT_TRUE(writer.write_frame(std::span<flags const>{ frames[0] }));
+    EXPECT_FALSE(writer.write_frame(std::span<flags const>{ frames[0] }.first(49)));
+    EXPECT_TRUE(writer.finish());
+    EXPECT_FALSE(writer.write_frame(std::span<flags const>{ frames[1] }));
+    EXPECT_TRUE((enum_flags_stream_reader<int, uint32_t>::open(stream_test::as_bytes(out.str()))));
+  }
+
+  if constexpr (sizeof(size_t) > sizeof(uint32_t))
+  {
+    /// Entity counts that don't fit the header are rejected before anything is written
+    std::ostringstream out{ std::ios::binary };
+    enum_flags_stream_writer<int, uint32_t> writer{ out, size_t(enum_flags_stream_writer<int, uint32_t>::max_entity_count) + 1 };
+    EXPECT_FALSE(writer.good());
+    EXPECT_FALSE(writer.write_frame(std::span<flags const>{ frames[0] }));
+    EXPECT_FALSE(writer.finish());
+    EXPECT_TRUE(out.str().empty());
+  }
+}
+
+TEST(enum_flags_stream_test, reads_mapped_files)
+{
+  using flags = enum_flags<int, uint32_t>;
+  const auto frames = stream_test::make_frames<flags>(20, 50, 21);
+  const auto path = std::filesystem::temp_directory_path() / "enum_flags_stream_test.bin";
+  {
+    std::ofstream file{ path, std::ios::binary };
+    file << stream_test::write(frames, 50, 8);
+  }
+  {
+    const auto mapped = enum_flags_mapped_file::open(path);
+    ASSERT_TRUE(mapped);
+    const auto reader = enum_flags_stream_reader<int, uint32_t>::open(mapped->bytes());
+    ASSERT_TRUE(reader);
+    std::vector<flags> frame(50);
+    ASSERT_TRUE(reader->read_frame(19, std::span{ frame }));
+    EXPECT_EQ(frame, frames[19]);
+  }
+  std::filesystem::remove(path);
+  EXPECT_FALSE(enum_flags_mapped_file::open(path));
+}
+
+TEST(tracked_enum_flags_test, reports_net_changes_since_flush)
+{
+  using flags = enum_flags<string_test::Permission, uint8_t>;
+  using enum string_test::Permission;
+  constexpr auto tracked = [] {
+    tracked_enum_flags<string_test::Permission, uint8_t> f{ flags{ Read } };
+    f.set(Write);
+    f += Exec;
+    f.unset(Read);
+    f.toggle(Exec);
+    return f;
+  }();
+  static_assert(tracked.value() == flags{ Write });
+  static_assert(tracked.added() == flags{ Write });
+  static_assert(tracked.removed() == flags{ Read });
+
+  auto f = tracked;
+  f.flush();
+  EXPECT_FALSE(f.changed());
+  f.set_to(true, Read);
+  f.set_to(false, Read);
+  EXPECT_FALSE(f.changed());
+  f = flags{ Exec };
+  EXPECT_EQ(f.added(), flags{ Exec });
+  EXPECT_EQ(f.removed(), flags{ Write });
+  EXPECT_EQ(f.flushed_value(), flags{ Write });
+}
+
+TEST(tracked_enum_flags_test, column_matches_full_diff)
+{
+  using flags = enum_flags<int, uint32_t>;
+  std::mt19937_64 rng{ 18 };
+  tracked_enum_flags_column<int, uint32_t> column(1000);
+  std::vector<flags> previous(1000), current(1000);
+  for (int round = 0; round < 20; ++round)
+  {
+    for (int m = 0; m < 50; ++m)
+    {
+      const auto index = rng() % column.size();
+      const auto mask = flags::from_bits(uint32_t(rng() & rng()));
+      switch (rng() % 5)
+      {
+      case 0: column.set(index, mask); current[index].set(mask); break;
+      case 1: column.unset(index, mask); current[index].unset(mask); break;
+      case 2: column.toggle(index, mask); current[index].toggle(mask); break;
+      case 3: { const bool val = rng() & 1; column.set_to(val, index, mask); current[index].set_to(val, mask); break; }
+      default: column.assign(index, mask); current[index] = mask; break;
+      }
+    }
+    if (round % 5 == 4)
+    {
+      column.push_back(flags{ 3 });
+      current.push_back(flags{ 3 });
+      previous.emplace_back();
+    }
+
+    std::vector<flag_change<flags>> expected;
+    for (size_t i = 0; i < current.size(); ++i)
+    {
+      EXPECT_EQ(column[i], current[i]);
+      if (current[i] != previous[i])
+        expected.push_back({ i, flags::from_bits(current[i].bits & ~previous[i].bits), flags::from_bits(previous[i].bits & ~current[i].bits) });
+    }
+    const auto changes = column.changes();
+    ASSERT_EQ(changes.size(), expected.size());
+    for (size_t c = 0; c < changes.size(); ++c)
+    {
+      EXPECT_EQ(changes[c].index, expected[c].index);
+      EXPECT_EQ(changes[c].added, expected[c].added);
+      EXPECT_EQ(changes[c].removed, expected[c].removed);
+      EXPECT_TRUE(column.is_dirty(changes[c].index));
+    }
+    column.flush();
+    previous = current;
+    EXPECT_TRUE(column.changes().empty());
+  }
+
+  column.resize(10);
+  column.resize(20, flags{ 1 });
+  EXPECT_EQ(column.changes().size(), 10u);
+  EXPECT_FALSE(column.is_dirty(9));
+}
+
+namespace instrumentation_test
+{
+  enum class Counted { Hot, Warm, Cold };
+  enum class Sited { First, Second };
+  enum class Disabled { Only };
+
+  std::optional<flag_instrumentation_entry> entry_for(std::string_view type_name, std::optional<uint_least32_t> line = std::nullopt)
+  {
+    for (auto const& entry : flag_instrumentation_report())
+      if (entry.type_name.ends_with(type_name) && entry.has_site == line.has_value() && (!line || entry.site.line() == *line))
+        return entry;
+    return std::nullopt;
+  }
+}
+template <> struct ghassanpl::enum_flags_traits<instrumentation_test::Counted> { using instrumentation = flag_counting_instrumentation; };
+template <> struct ghassanpl::enum_flags_traits<instrumentation_test::Sited> { using instrumentation = flag_site_counting_instrumentation; };
+template <> struct ghassanpl::enum_flags_traits<instrumentation_test::Disabled> { using instrumentation = void; };
+
+TEST(flag_instrumentation_test, counts_operations_per_flag)
+{
+  using namespace instrumentation_test;
+  static_assert(enum_flags<Counted>{ Counted::Hot }.set(Counted::Cold).is_set(Counted::Cold), "instrumented flags stay constexpr");
+
+  enum_flags<Counted> f;
+  for (int i = 0; i < 10; ++i) (void)f.is_set(Counted::Hot);
+  f.set(Counted::Hot, Counted::Warm);
+  f.unset(Counted::Warm);
+  f.toggle(enum_flags<Counted>{ Counted::Hot, Counted::Cold });
+  f.set_to(false, Counted::Cold);
+  f += Counted::Warm;
+  EXPECT_TRUE(f.are_all_set(Counted::Warm));
+
+  uint32_t bits = 0;
+  set_flags(bits, Counted::Cold);
+  EXPECT_TRUE(is_flag_set(bits, Counted::Cold));
+  unset_flags(bits, Counted::Cold);
+  toggle_flags(bits, Counted::Hot);
+  set_flags(bits, 3); /// integers are never counted
+
+  std::thread{ [] { enum_flags<Counted> other; for (int i = 0; i < 5; ++i) other.toggle(Counted::Hot); } }.join();
+
+  const auto entry = entry_for("Counted");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(entry->counts_of(0)[flag_operation_kind::test], 10u);
+  EXPECT_EQ(entry->counts_of(0)[flag_operation_kind::set], 1u);
+  EXPECT_EQ(entry->counts_of(0)[flag_operation_kind::toggle], 7u);
+  EXPECT_EQ(entry->counts_of(1)[flag_operation_kind::set], 2u);
+  EXPECT_EQ(entry->counts_of(1)[flag_operation_kind::unset], 1u);
+  EXPECT_EQ(entry->counts_of(1)[flag_operation_kind::test], 1u);
+  EXPECT_EQ(entry->counts_of(2)[flag_operation_kind::set], 1u);
+  EXPECT_EQ(entry->counts_of(2)[flag_operation_kind::unset], 2u);
+  EXPECT_EQ(entry->counts_of(2)[flag_operation_kind::test], 1u);
+  EXPECT_EQ(entry->counts_of(2)[flag_operation_kind::toggle], 1u);
+  EXPECT_EQ(entry->counts_of(0).name, "Hot");
+  EXPECT_EQ(entry->total(), 27u);
+
+  enum_flags<Disabled> disabled;
+  disabled.set(Disabled::Only);
+  EXPECT_FALSE(entry_for("Disabled"));
+  static_assert(!detail::has_flag_instrumentation<Disabled> && !detail::has_flag_instrumentation<int>);
+}
+
+TEST(flag_instrumentation_test, attributes_counts_to_sites_and_writes_json)
+{
+  using namespace instrumentation_test;
+  enum_flags<Sited> f;
+  f.set(Sited::First);
+  uint_least32_t outer_line = 0, inner_line = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    flag_instrumentation_site outer; outer_line = outer.location.line();
+    f.toggle(Sited::Second);
+    {
+      flag_instrumentation_site inner; inner_line = inner.location.line();
+      (void)f.is_set(Sited::First);
+    }
+    f.unset(Sited::First);
+  }
+
+  ASSERT_TRUE(entry_for("Sited"));
+  EXPECT_EQ(entry_for("Sited")->counts_of(0)[flag_operation_kind::set], 1u);
+  const auto outer = entry_for("Sited", outer_line);
+  ASSERT_TRUE(outer);
+  EXPECT_EQ(outer->counts_of(1)[flag_operation_kind::toggle], 3u);
+  EXPECT_EQ(outer->counts_of(0)[flag_operation_kind::unset], 3u);
+  EXPECT_EQ(outer->counts_of(0)[flag_operation_kind::test], 0u);
+  EXPECT_TRUE(std::string_view{ outer->site.file_name() }.ends_with("tests.cpp"));
+  const auto inner = entry_for("Sited", inner_line);
+  ASSERT_TRUE(inner);
+  EXPECT_EQ(inner->total(), 3u);
+
+  std::ostringstream json;
+  write_flag_instrumentation_json(json);
+  EXPECT_NE(json.str().find("{\"bit\": 1, \"name\": \"Second\", \"test\": 0, \"set\": 0, \"unset\": 0, \"toggle\": 3}"), std::string::npos);
+  EXPECT_NE(json.str().find("\"line\": " + std::to_string(inner_line)), std::string::npos);
+  EXPECT_NE(json.str().find("\"site\": null"), std::string::npos);
+
+  reset_flag_instrumentation();
+  EXPECT_FALSE(entry_for("Sited"));
+}
+
+TEST(atomic_wide_enum_flags_test, operations_work_across_words)
+{
+  using flags = wide_enum_flags<WideTestEnum, 256>;
+  atomic_wide_enum_flags<WideTestEnum, 256> f{ WideTestEnum::One, WideTestEnum::TwoHundred };
+  static_assert(alignof(decltype(f)) >= 64 && sizeof(f) % 64 == 0);
+  EXPECT_EQ(f.snapshot(), (flags{ WideTestEnum::One, WideTestEnum::TwoHundred }));
+
+  EXPECT_FALSE(f.test_and_set(WideTestEnum::SixtyFour));
+  EXPECT_TRUE(f.test_and_set(WideTestEnum::SixtyFour));
+  EXPECT_TRUE(f.test_and_unset(WideTestEnum::One));
+  EXPECT_FALSE(f.test_and_unset(WideTestEnum::One));
+  EXPECT_FALSE(f.test_and_toggle(WideTestEnum::TwoFiftyFive));
+  EXPECT_TRUE(f.is_set(WideTestEnum::TwoFiftyFive));
+  EXPECT_TRUE(f.are_all_set(WideTestEnum::SixtyFour, WideTestEnum::TwoHundred, WideTestEnum::TwoFiftyFive));
+
+  const auto version = f.version();
+  f.set(WideTestEnum::Zero, WideTestEnum::HundredTwentySeven).unset(WideTestEnum::TwoHundred);
+  f -= flags{ WideTestEnum::SixtyFour, WideTestEnum::TwoFiftyFive };
+  f.toggle(flags{ WideTestEnum::Zero, WideTestEnum::One });
+  EXPECT_EQ(f.version(), version + 4);
+  EXPECT_EQ(f.load(), (flags{ WideTestEnum::One, WideTestEnum::HundredTwentySeven }));
+  EXPECT_FALSE(f.are_any_set(flags{ WideTestEnum::Zero, WideTestEnum::TwoHundred }));
+
+  f.store(flags::all());
+  EXPECT_EQ(f.snapshot().count(), 256u);
+  EXPECT_TRUE(f.try_snapshot());
+}
+
+TEST(atomic_wide_enum_flags_test, snapshots_never_mix_writes)
+{
+  /// Every write keeps Zero == TwoFiftyFive and SixtyFour == TwoHundred, which are all in different words
+  atomic_wide_enum_flags<WideTestEnum, 256> f;
+  std::atomic<bool> done = false;
+  std::atomic<int> torn = 0, snapshots = 0;
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; ++r)
+  {
+    readers.emplace_back([&] {
+      while (!done.load())
+      {
+        const auto s = f.snapshot();
+        if (s.is_set(WideTestEnum::Zero) != s.is_set(WideTestEnum::TwoFiftyFive) || s.is_set(WideTestEnum::SixtyFour) != s.is_set(WideTestEnum::TwoHundred))
+          ++torn;
+        ++snapshots;
+      }
+    });
+  }
+  std::thread other_writer{ [&] {
+    for (int i = 0; i < 20000; ++i) f.toggle(wide_enum_flags<WideTestEnum, 256>{ WideTestEnum::SixtyFour, WideTestEnum::TwoHundred });
+  } };
+  for (int i = 0; i < 20000; ++i)
+  {
+    f.toggle(WideTestEnum::Zero, WideTestEnum::TwoFiftyFive);
+    if (i % 1000 == 0) std::this_thread::yield();
+  }
+  other_writer.join();
+  while (snapshots.load() < 100) std::this_thread::yield();
+  done = true;
+  for (auto& reader : readers) reader.join();
+  EXPECT_EQ(torn.load(), 0);
+  EXPECT_EQ(f.snapshot(), (wide_enum_flags<WideTestEnum, 256>{}));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();